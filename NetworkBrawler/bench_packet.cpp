@@ -0,0 +1,275 @@
+#include "sh_protocol.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+// Microbenchmark of the packet building path: the old build_packet (fresh std::vector + copy into the ENet packet)
+// against the pooled one (recycled buffer used as the ENet packet memory).
+// Allocations are counted on both sides: C++ allocations through operator new and ENet ones through its allocation callbacks.
+// It also measures the wire size of a brawler state, raw f32 against the bit-packed encoding, and the size of the world snapshot sent to joining players.
+
+namespace
+{
+	std::atomic<std::size_t> s_newCount = 0;
+	std::atomic<std::size_t> s_enetMallocCount = 0;
+
+	void* ENET_CALLBACK CountingMalloc(std::size_t size)
+	{
+		s_enetMallocCount++;
+		return std::malloc(size);
+	}
+
+	void ENET_CALLBACK CountingFree(void* memory)
+	{
+		std::free(memory);
+	}
+
+	// Copy of build_packet before the packet pool
+	template<typename T> ENetPacket* build_packet_legacy(const T& packet, enet_uint32 flags)
+	{
+		std::vector<std::uint8_t> byteArray;
+
+		Serialize_u8(byteArray, static_cast<std::uint8_t>(T::opcode));
+		packet.Serialize(byteArray);
+
+		return enet_packet_create(byteArray.data(), byteArray.size(), flags);
+	}
+
+	// Copy of BrawlerStatesPacket::Serialize before the bit-packed encoding
+	void serialize_states_legacy(const BrawlerStatesPacket& packet, std::vector<std::uint8_t>& byteArray)
+	{
+		Serialize_u32(byteArray, packet.snapshotId);
+		Serialize_u32(byteArray, packet.baselineId);
+
+		Serialize_u32(byteArray, packet.brawlers.size());
+		for (const auto& state : packet.brawlers)
+		{
+			Serialize_u32(byteArray, state.brawlerId);
+			Serialize_u8(byteArray, state.changedFields);
+			Serialize_f32(byteArray, state.position.x);
+			Serialize_f32(byteArray, state.position.y);
+			Serialize_f32(byteArray, state.linearVelocity.x);
+			Serialize_f32(byteArray, state.linearVelocity.y);
+		}
+	}
+
+	struct BenchResult
+	{
+		double nsPerPacket;
+		double newPerTick;
+		double enetMallocPerTick;
+	};
+
+	// One tick is what the server builds at each tick once a room is full: one state packet + one reliable event per peer
+	constexpr std::size_t BrawlerCount = 16;
+	constexpr std::size_t CollectibleCount = 25; //< server's collectibleMaxCount
+	constexpr std::size_t PeerCount = 16;
+	constexpr std::size_t PacketsPerTick = 1 + PeerCount;
+	constexpr std::size_t WarmupTicks = 100;
+	constexpr std::size_t MeasuredTicks = 10000;
+
+	BrawlerStatesPacket BuildStatesPacket()
+	{
+		// Moving brawlers (straight and diagonal) spread over the world, plus one dead brawler moved out of it
+		BrawlerStatesPacket statesPacket;
+		for (std::size_t i = 0; i < BrawlerCount; ++i)
+		{
+			auto& state = statesPacket.brawlers.emplace_back();
+			state.brawlerId = static_cast<std::uint32_t>(i * 2);
+			state.position = Sel::Vector2f(-WorldHalfSize + i * 117.3f, WorldHalfSize - i * 101.7f);
+
+			Sel::Vector2f direction((i % 3 == 0) ? 1.f : 0.f, (i % 2 == 0) ? -1.f : 0.f);
+			state.linearVelocity = direction * BrawlerSpeed;
+			if (direction.x != 0.f && direction.y != 0.f)
+				state.linearVelocity = Sel::Vector2f::Normal(direction * BrawlerSpeed) * BrawlerSpeed;
+		}
+
+		statesPacket.brawlers.back().position = Sel::Vector2f(-20000.f, -20000.f);
+		statesPacket.brawlers.back().linearVelocity = Sel::Vector2f(0.f, 0.f);
+
+		return statesPacket;
+	}
+
+	template<typename F>
+	BenchResult RunBench(F&& buildPacket)
+	{
+		BrawlerStatesPacket statesPacket = BuildStatesPacket();
+
+		GoldenEventPacket eventPacket;
+		eventPacket.eventType = GoldenEventPacket::GoldenEventType::Steal;
+		eventPacket.previousOwner = 1;
+		eventPacket.newOwner = 2;
+
+		auto tick = [&]
+		{
+			// ENet destroys the packets once sent, we do it right away
+			enet_packet_destroy(buildPacket(statesPacket, 0));
+			for (std::size_t i = 0; i < PeerCount; ++i)
+				enet_packet_destroy(buildPacket(eventPacket, ENET_PACKET_FLAG_RELIABLE));
+		};
+
+		for (std::size_t i = 0; i < WarmupTicks; ++i)
+			tick();
+
+		std::size_t newCount = s_newCount;
+		std::size_t enetMallocCount = s_enetMallocCount;
+		auto start = std::chrono::steady_clock::now();
+
+		for (std::size_t i = 0; i < MeasuredTicks; ++i)
+			tick();
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		BenchResult result;
+		result.nsPerPacket = std::chrono::duration<double, std::nano>(elapsed).count() / (MeasuredTicks * PacketsPerTick);
+		result.newPerTick = static_cast<double>(s_newCount - newCount) / MeasuredTicks;
+		result.enetMallocPerTick = static_cast<double>(s_enetMallocCount - enetMallocCount) / MeasuredTicks;
+
+		return result;
+	}
+
+	void PrintStateSizes()
+	{
+		BrawlerStatesPacket statesPacket = BuildStatesPacket();
+
+		std::vector<std::uint8_t> legacy;
+		serialize_states_legacy(statesPacket, legacy);
+
+		std::vector<std::uint8_t> packed;
+		statesPacket.Serialize(packed);
+
+		// Header (snapshot ids and count) is the same 12 bytes in both encodings
+		constexpr std::size_t HeaderSize = 3 * sizeof(std::uint32_t);
+
+		std::cout << "bytes per brawler state: legacy " << std::fixed << std::setprecision(2) << static_cast<double>(legacy.size() - HeaderSize) / BrawlerCount
+		          << ", bit-packed " << static_cast<double>(packed.size() - HeaderSize) / BrawlerCount
+		          << " (" << StatePositionBits << " bits per position axis)" << std::endl;
+
+		// Make sure what we measured decodes back to the same states (within the quantization step)
+		std::size_t offset = 0;
+		BrawlerStatesPacket decoded = BrawlerStatesPacket::Deserialize(packed, offset);
+		if (offset != packed.size() || decoded.brawlers.size() != statesPacket.brawlers.size())
+			throw std::runtime_error("bit-packed states don't decode back");
+
+		float maxPositionError = 0.f;
+		for (std::size_t i = 0; i < decoded.brawlers.size(); ++i)
+		{
+			const auto& expected = statesPacket.brawlers[i];
+			const auto& state = decoded.brawlers[i];
+			if (state.brawlerId != expected.brawlerId || state.linearVelocity.x != expected.linearVelocity.x || state.linearVelocity.y != expected.linearVelocity.y)
+				throw std::runtime_error("bit-packed states don't decode back");
+
+			maxPositionError = std::max({ maxPositionError, std::abs(state.position.x - expected.position.x), std::abs(state.position.y - expected.position.y) });
+		}
+
+		std::cout << "max position error: " << std::setprecision(4) << maxPositionError << std::endl;
+	}
+
+	void PrintWorldSnapshotSize()
+	{
+		BrawlerStatesPacket statesPacket = BuildStatesPacket();
+
+		WorldSnapshotPacket worldSnapshot;
+		for (const auto& state : statesPacket.brawlers)
+		{
+			CreateBrawlerPacket& brawler = worldSnapshot.brawlers.emplace_back();
+			brawler.playerId = state.brawlerId / 2;
+			brawler.brawlerId = state.brawlerId;
+			brawler.skinId = static_cast<std::uint8_t>(state.brawlerId % 4);
+			brawler.position = state.position;
+			brawler.linearVelocity = state.linearVelocity;
+			brawler.scale = 1.f;
+		}
+
+		for (std::size_t i = 0; i < CollectibleCount; ++i)
+		{
+			CreateCollectiblePacket& collectible = worldSnapshot.collectibles.emplace_back();
+			collectible.collectibleId = static_cast<std::uint32_t>(BrawlerCount * 2 + i);
+			collectible.position = Sel::Vector2f(-WorldHalfSize + i * 83.1f, -WorldHalfSize + i * 61.9f);
+			collectible.scale = 1.f;
+			collectible.type = (i == 0) ? CollectibleType::GoldenCarrot : CollectibleType::Carrot;
+		}
+
+		// What CreateAllEntities used to send: one packet (opcode included) per entity
+		std::size_t perEntityBytes = 0;
+		for (const auto& brawler : worldSnapshot.brawlers)
+			perEntityBytes += 1 + FieldCodec<CreateBrawlerPacket>::Size(brawler);
+
+		for (const auto& collectible : worldSnapshot.collectibles)
+			perEntityBytes += 1 + FieldCodec<CreateCollectiblePacket>::Size(collectible);
+
+		std::vector<std::uint8_t> snapshotBytes;
+		worldSnapshot.Serialize(snapshotBytes);
+
+		std::size_t offset = 0;
+		WorldSnapshotPacket decoded = WorldSnapshotPacket::Deserialize(snapshotBytes, offset);
+		if (offset != snapshotBytes.size() || decoded.brawlers.size() != BrawlerCount || decoded.collectibles.size() != CollectibleCount)
+			throw std::runtime_error("world snapshot doesn't decode back");
+
+		std::cout << "join: " << BrawlerCount + CollectibleCount << " reliable packets (" << perEntityBytes << " bytes) -> 1 world snapshot ("
+		          << 1 + snapshotBytes.size() << " bytes, " << (decoded.decompressedBytes.empty() ? "raw" : "lz4") << ")" << std::endl;
+	}
+
+	void PrintResult(const char* name, const BenchResult& result)
+	{
+		std::cout << std::left << std::setw(14) << name
+		          << std::right << std::fixed << std::setprecision(1)
+		          << std::setw(12) << result.nsPerPacket
+		          << std::setw(14) << result.newPerTick
+		          << std::setw(18) << result.enetMallocPerTick << std::endl;
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	s_newCount++;
+	if (void* ptr = std::malloc(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+int main()
+{
+	ENetCallbacks callbacks = {};
+	callbacks.malloc = &CountingMalloc;
+	callbacks.free = &CountingFree;
+
+	if (enet_initialize_with_callbacks(ENET_VERSION, &callbacks) != 0)
+	{
+		std::cout << "Failed to initialize ENet" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	PrintStateSizes();
+	PrintWorldSnapshotSize();
+
+	std::cout << BrawlerCount << " brawlers, " << PacketsPerTick << " packets per tick, " << MeasuredTicks << " ticks" << std::endl;
+	std::cout << std::left << std::setw(14) << "builder"
+	          << std::right << std::setw(12) << "ns/packet"
+	          << std::setw(14) << "new/tick"
+	          << std::setw(18) << "enet malloc/tick" << std::endl;
+
+	PrintResult("legacy", RunBench([](const auto& packet, enet_uint32 flags) { return build_packet_legacy(packet, flags); }));
+	PrintResult("pooled", RunBench([](const auto& packet, enet_uint32 flags) { return build_packet(packet, flags); }));
+
+	enet_deinitialize();
+
+	return EXIT_SUCCESS;
+}
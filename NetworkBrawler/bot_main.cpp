@@ -0,0 +1,360 @@
+#include "sh_constants.h"
+#include "sh_messagedispatcher.h"
+#include "sh_protocol.h"
+#include <enet6/enet.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Headless load generator: opens many connections to a server from a single process, without any window.
+// Every bot goes through the same handshake as BrawlerClient (name, brawler request, ready) and streams randomized inputs at the tick rate.
+// Once a second it reports what the bots observe: the rate at which the server sends states (its effective tick rate), the size of the state packets and the round-trip times.
+//
+// usage: BrawlerBot [bot count = 50] [server address = localhost] [duration in seconds = 0, runs until killed]
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Bot
+	{
+		ENetPeer* peer = nullptr;
+		std::size_t index;
+		std::optional<std::uint32_t> brawlerId;
+		GameState gameState = GameState::Lobby;
+		PlayerMode playerMode = PlayerMode::Pending;
+		PlayerInputs inputs;
+		Clock::time_point nextInputChange;
+		std::uint32_t lastSnapshotId = InvalidSnapshotId;
+		PlayerInputsPacket inputsPacket; //< sends the inputs of the last ticks again
+		bool isConnected = false;
+	};
+
+	using BotDispatcher = MessageDispatcher<Bot&>;
+
+	// Time between two reports
+	constexpr std::chrono::seconds ReportInterval(1);
+
+	// Bots keep a direction for a random duration in this range (ms)
+	constexpr int MinInputDuration = 300;
+	constexpr int MaxInputDuration = 2000;
+
+	std::mt19937 s_randomGenerator(std::random_device{}());
+
+	void send_to_server(Bot& bot, ENetPacket* packet)
+	{
+		if (enet_peer_send(bot.peer, 0, packet) < 0)
+			enet_packet_destroy(packet);
+	}
+
+	void send_ready(Bot& bot)
+	{
+		PlayerReadyPacket packet;
+		packet.newReadyValue = true;
+
+		send_to_server(bot, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+	}
+
+	void request_brawler(Bot& bot)
+	{
+		CreateBrawlerResquest packet;
+		send_to_server(bot, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+	}
+
+	void handle_brawler_states(Bot& bot, BrawlerStatesPacket& packet)
+	{
+		// Acknowledged with the next inputs, like the client does (the server then sends deltas against it)
+		if (packet.snapshotId > bot.lastSnapshotId)
+			bot.lastSnapshotId = packet.snapshotId;
+	}
+
+	void handle_update_game_state(Bot& bot, UpdateGameStatePacket& packet)
+	{
+		bot.gameState = static_cast<GameState>(packet.newGameState);
+
+		switch (bot.gameState)
+		{
+			case GameState::Lobby:
+			{
+				// Same as the client: spectators get a brawler for the next game, everyone is ready right away
+				if (bot.playerMode == PlayerMode::Spectating)
+				{
+					request_brawler(bot);
+					bot.playerMode = PlayerMode::Playing;
+				}
+				else
+				{
+					bot.playerMode = PlayerMode::Playing;
+					if (bot.brawlerId)
+						send_ready(bot);
+				}
+				break;
+			}
+
+			case GameState::GameRunning:
+				break;
+
+			case GameState::EndScreen:
+			{
+				// Any ready player brings the room back to the lobby
+				send_ready(bot);
+				break;
+			}
+		}
+	}
+
+	void handle_update_player_mode(Bot& bot, UpdatePlayerModePacket& packet)
+	{
+		PlayerMode previousMode = bot.playerMode;
+		bot.playerMode = static_cast<PlayerMode>(packet.newPlayerMode);
+
+		// First mode received after the name: the bot asks for its brawler if it can play right away
+		if (previousMode == PlayerMode::Pending && bot.playerMode == PlayerMode::Playing)
+			request_brawler(bot);
+	}
+
+	void handle_update_self_brawler_id(Bot& bot, UpdateSelfBrawlerId& packet)
+	{
+		bot.brawlerId = packet.id;
+		bot.playerMode = PlayerMode::Playing;
+
+		if (bot.gameState == GameState::Lobby)
+			send_ready(bot);
+	}
+
+	void register_message_handlers(BotDispatcher& dispatcher)
+	{
+		dispatcher.Register<BrawlerStatesPacket>(&handle_brawler_states);
+		dispatcher.Register<UpdateGameStatePacket>(&handle_update_game_state);
+		dispatcher.Register<UpdatePlayerModePacket>(&handle_update_player_mode);
+		dispatcher.Register<UpdateSelfBrawlerId>(&handle_update_self_brawler_id);
+	}
+
+	void send_inputs(Bot& bot, Clock::time_point now)
+	{
+		if (now >= bot.nextInputChange)
+		{
+			std::uniform_int_distribution<int> axisDistribution(-1, 1);
+			int x = axisDistribution(s_randomGenerator);
+			int y = axisDistribution(s_randomGenerator);
+
+			bot.inputs.moveLeft = (x < 0);
+			bot.inputs.moveRight = (x > 0);
+			bot.inputs.moveUp = (y < 0);
+			bot.inputs.moveDown = (y > 0);
+			bot.inputs.dash = std::bernoulli_distribution(0.1)(s_randomGenerator);
+
+			std::uniform_int_distribution<int> durationDistribution(MinInputDuration, MaxInputDuration);
+			bot.nextInputChange = now + std::chrono::milliseconds(durationDistribution(s_randomGenerator));
+		}
+
+		// Spectators send their inputs too, they're ignored by the server
+		PlayerInputsPacket& packet = bot.inputsPacket;
+		packet.PushInputs(bot.inputs);
+		packet.lastSnapshotId = bot.lastSnapshotId;
+
+		send_to_server(bot, build_packet(packet, 0));
+	}
+
+	// Value under which lie percent % of the sorted values
+	enet_uint32 percentile(const std::vector<enet_uint32>& sortedValues, double percent)
+	{
+		std::size_t index = static_cast<std::size_t>(percent / 100.0 * (sortedValues.size() - 1) + 0.5);
+		return sortedValues[index];
+	}
+
+	void report(std::vector<Bot>& bots, BotDispatcher& dispatcher, std::vector<enet_uint32>& roundTripTimes, double elapsedSeconds, double intervalSeconds)
+	{
+		std::size_t connectedCount = 0;
+		std::size_t playingCount = 0;
+		for (const Bot& bot : bots)
+		{
+			if (!bot.isConnected)
+				continue;
+
+			connectedCount++;
+			if (bot.brawlerId && bot.gameState == GameState::GameRunning && bot.playerMode == PlayerMode::Playing)
+				playingCount++;
+		}
+
+		const BotDispatcher::Counters& states = dispatcher.GetCounters(Opcode::S_BrawlerStates);
+
+		// Every connected bot gets a state packet per server tick
+		double tickRate = (connectedCount > 0) ? states.messageCount / (connectedCount * intervalSeconds) : 0.0;
+		double stateSize = (states.messageCount > 0) ? static_cast<double>(states.totalBytes) / states.messageCount : 0.0;
+		double stateBandwidth = (connectedCount > 0) ? states.totalBytes / (connectedCount * intervalSeconds * 1024.0) : 0.0;
+
+		std::cout << std::fixed << std::setprecision(1)
+		          << std::setw(6) << elapsedSeconds << "s | bots " << connectedCount << "/" << bots.size() << ", " << playingCount << " playing"
+		          << " | server tick rate " << tickRate << " Hz"
+		          << " | states " << stateSize << " B avg, " << stateBandwidth << " kB/s per bot";
+
+		if (!roundTripTimes.empty())
+		{
+			std::sort(roundTripTimes.begin(), roundTripTimes.end());
+			std::cout << " | rtt p50 " << percentile(roundTripTimes, 50.0) << " ms, p90 " << percentile(roundTripTimes, 90.0)
+			          << " ms, p99 " << percentile(roundTripTimes, 99.0) << " ms, max " << roundTripTimes.back() << " ms";
+		}
+
+		std::cout << std::endl;
+
+		dispatcher.ResetCounters();
+		roundTripTimes.clear();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t botCount = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 50;
+	std::string serverAddress = (argc > 2) ? argv[2] : "localhost";
+	unsigned long duration = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 0;
+
+	if (botCount == 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [bot count] [server address] [duration in seconds]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (enet_initialize() != 0)
+	{
+		std::cout << "Failed to initialize ENet" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	ENetAddress address;
+	if (enet_address_set_host(&address, ENET_ADDRESS_TYPE_ANY, serverAddress.data()) != 0)
+	{
+		std::cerr << "Failed to resolve address " << serverAddress << std::endl;
+		return EXIT_FAILURE;
+	}
+	address.port = AppPort;
+
+	// A single host for every bot: one socket, one peer per bot
+	ENetHost* host = enet_host_create(address.type, nullptr, botCount, 0, 0, 0);
+	if (!host)
+	{
+		std::cerr << "Failed to create ENet host" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Bot> bots(botCount);
+	for (std::size_t i = 0; i < botCount; ++i)
+	{
+		Bot& bot = bots[i];
+		bot.index = i;
+		bot.peer = enet_host_connect(host, &address, 0, 0);
+		if (!bot.peer)
+		{
+			std::cerr << "Failed to connect bot #" << i << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		bot.peer->data = &bot;
+	}
+
+	std::cout << "Connecting " << botCount << " bots to " << serverAddress << "..." << std::endl;
+
+	BotDispatcher dispatcher;
+	register_message_handlers(dispatcher);
+
+	std::vector<enet_uint32> roundTripTimes;
+
+	const auto tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(TickDelay));
+	const Clock::time_point startTime = Clock::now();
+	Clock::time_point nextTick = startTime;
+	Clock::time_point lastReport = startTime;
+
+	for (;;)
+	{
+		Clock::time_point now = Clock::now();
+		if (duration > 0 && now - startTime >= std::chrono::seconds(duration))
+			break;
+
+		if (now >= nextTick)
+		{
+			// Every bot in game sends its inputs, ENet's RTT of each connected bot is sampled once per tick
+			for (Bot& bot : bots)
+			{
+				if (!bot.isConnected)
+					continue;
+
+				roundTripTimes.push_back(bot.peer->roundTripTime);
+
+				if (bot.playerMode != PlayerMode::Pending)
+					send_inputs(bot, now);
+			}
+
+			// A late tick isn't caught up, bots just skip it
+			nextTick += tickDuration;
+			if (nextTick <= now)
+				nextTick = now + tickDuration;
+		}
+
+		if (now - lastReport >= ReportInterval)
+		{
+			report(bots, dispatcher, roundTripTimes, std::chrono::duration<double>(now - startTime).count(), std::chrono::duration<double>(now - lastReport).count());
+			lastReport = now;
+		}
+
+		auto waitTime = std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - Clock::now());
+
+		ENetEvent event;
+		if (enet_host_service(host, &event, static_cast<enet_uint32>(std::max<std::chrono::milliseconds::rep>(waitTime.count(), 0))) > 0)
+		{
+			do
+			{
+				Bot& bot = *static_cast<Bot*>(event.peer->data);
+
+				switch (event.type)
+				{
+					case ENET_EVENT_TYPE_CONNECT:
+					{
+						bot.isConnected = true;
+
+						PlayerNamePacket namePacket;
+						namePacket.name = "Bot" + std::to_string(bot.index);
+
+						send_to_server(bot, build_packet(namePacket, ENET_PACKET_FLAG_RELIABLE));
+						break;
+					}
+
+					case ENET_EVENT_TYPE_DISCONNECT:
+					case ENET_EVENT_TYPE_DISCONNECT_TIMEOUT:
+					{
+						std::cout << "Bot #" << bot.index << " disconnected" << std::endl;
+
+						bot.isConnected = false;
+						break;
+					}
+
+					case ENET_EVENT_TYPE_RECEIVE:
+					{
+						dispatcher.Dispatch(ByteSpan(event.packet->data, event.packet->dataLength), bot);
+						enet_packet_destroy(event.packet);
+						break;
+					}
+
+					case ENET_EVENT_TYPE_NONE:
+						break;
+				}
+			} while (enet_host_check_events(host, &event) > 0);
+		}
+	}
+
+	for (Bot& bot : bots)
+	{
+		if (bot.isConnected)
+			enet_peer_disconnect_now(bot.peer, 0);
+	}
+
+	enet_host_destroy(host);
+	enet_deinitialize();
+
+	return EXIT_SUCCESS;
+}
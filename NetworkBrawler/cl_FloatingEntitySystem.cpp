@@ -19,6 +19,15 @@ void FloatingEntitySystem::AddFloatingEntity(entt::entity anchor, entt::entity f
 	m_floatingEntities.push_back(floatingEntity);
 }
 
+void FloatingEntitySystem::SetOffset(entt::entity floating, Sel::Vector2f offset)
+{
+	for (auto& floatingEntity : m_floatingEntities)
+	{
+		if (floatingEntity.floating == floating)
+			floatingEntity.offset = offset;
+	}
+}
+
 void FloatingEntitySystem::Update()
 {
     std::vector<size_t> entitiesToRemove;
@@ -11,6 +11,7 @@ public:
 	~FloatingEntitySystem();
 
 	void AddFloatingEntity(entt::entity anchor, entt::entity floating, Sel::Vector2f offset);
+	void SetOffset(entt::entity floating, Sel::Vector2f offset);
 
 	void Update();
 
@@ -36,6 +36,8 @@
 #include <imgui.h>
 #include "sh_inputs.h"
 #include "sh_brawler.h"
+#include "sh_messagedispatcher.h"
+#include "sh_snapshot.h"
 #include "cl_brawler.h"
 #include "sv_networkedcomponent.h"
 #include "cl_FloatingEntitySystem.h"
@@ -50,6 +52,27 @@ struct PlayerData
 	bool isDead = true;
 };
 
+enum class LeaderboardLineColor
+{
+	Safe,   //< white
+	Danger, //< orange, the next one is dead (or it's the last line)
+	Dead    //< red
+};
+
+struct LeaderboardEntry
+{
+	std::uint32_t playerId;
+	std::string name;
+	std::uint32_t score = 0;
+	bool isDead = false;
+
+	// What the line displays, its text is only rendered again when it changes
+	entt::entity lineEntity = entt::null;
+	std::string lineText;
+	LeaderboardLineColor lineColor = LeaderboardLineColor::Safe;
+	std::size_t lineRank = 0;
+};
+
 struct ClientNetworkId
 {
 	std::uint32_t networkId;
@@ -79,6 +102,7 @@ struct GameData
 	PlayerMode playerMode;
 	std::size_t spectateIndex = 0;
 	std::size_t previousSpectateIndex = 1;
+	std::optional<std::uint32_t> spectatedBrawlerId; //< last spectate target sent to the server, it only replicates what's around it
 	std::uint8_t playerScore; 
 
 	float nextKillTimer = KILL_INTERVAL;
@@ -92,6 +116,7 @@ struct GameData
 	std::string name;
 	std::map<std::uint32_t, PlayerData> players;
 	std::map<std::uint32_t, PlayerData> spectatablePlayers;
+	std::vector<LeaderboardEntry> leaderboard; //< first is the best ranked
 	ENetPeer* serverPeer; //< Le serveur
 	entt::registry* registryBG;
 	entt::registry* registry;
@@ -108,11 +133,19 @@ struct GameData
 
 	GoldenData& goldenData;
 
-	float interpolationFactor = 0.f;
-	std::vector<BrawlerStatesPacket> snapshots;
+	std::uint32_t lastSnapshotId = InvalidSnapshotId; //< last snapshot applied, sent back to the server as our delta baseline
+	PlayerInputsPacket inputsPacket; //< kept from one tick to the next, it sends the inputs of the last ticks again
+	SnapshotHistory snapshots;
+	SnapshotStates snapshotStates; //< states rebuilt from the last received packet
+	SnapshotStates previousSnapshotStates; //< states rebuilt from the packet before it
+
+	MessageDispatcher<GameData&> messageDispatcher;
+
+	Sel::Stopwatch joinClock; //< restarted when we send our name, measures how long a late joiner waits before seeing the world
+	bool isWaitingFirstFrame = false; //< the world snapshot was applied but not rendered yet
 };
 
-void handle_message(const std::vector<std::uint8_t>& message, GameData& gameData);
+void register_message_handlers(MessageDispatcher<GameData&>& dispatcher);
 bool run_network(ENetHost* host, GameData& gameData);
 void tick(GameData& gameData);
 
@@ -125,6 +158,8 @@ Sel::Sprite BuildBGSprite(float size);
 Sel::Sprite BuildIndicatorSprite(float size);
 
 void NewAnnouncement(GameData& gameData, std::string text, Sel::Color color, int fontSize);
+void ClearLeaderboard(GameData& gameData);
+void RefreshLeaderboardLines(GameData& gameData);
 void AnnouncementSystem(GameData& gameData, entt::entity camera, float deltaTime);
 
 int main()
@@ -265,9 +300,18 @@ int main()
 	gameData.gameState = GameState::Lobby;
 	gameData.playerMode = PlayerMode::Pending;
 
+	register_message_handlers(gameData.messageDispatcher);
+
 	Sel::ComponentRegistry componentRegistry;
 
 	inputManager.BindKeyPressed(SDL_KeyCode::SDLK_F1, "OpenEditor");
+	inputManager.BindKeyPressed(SDL_KeyCode::SDLK_F2, "DumpMessageCounters");
+
+	inputManager.BindAction("DumpMessageCounters", [&](bool active)
+		{
+			if (active)
+				gameData.messageDispatcher.DumpCounters(std::cout);
+		});
 
 	std::optional<Sel::WorldEditor> worldEditor;
 	inputManager.BindAction("OpenEditor", [&](bool active)
@@ -289,6 +333,7 @@ int main()
 		enet_peer_send(gameData.serverPeer, 0, build_packet(namePacket, ENET_PACKET_FLAG_RELIABLE));
 
 		gameData.name = name;
+		gameData.joinClock.Restart();
 	}
 
 	//Inputs
@@ -387,6 +432,7 @@ int main()
 
 					PlayerStealPacketRequest packet;
 					packet.brawlerId = gameData.ownBrawlerNetworkIndex.value();
+					packet.viewSnapshotId = gameData.lastSnapshotId;
 
 					enet_peer_send(gameData.serverPeer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
 				}
@@ -771,6 +817,16 @@ int main()
 					// If the player has an ownBrawlerId, find the corresponding entity
 					if (playerData.ownBrawlerId.has_value())
 					{
+						// The server only sends what's around the spectated brawler, it has to know which one it is (it may not exist here yet)
+						if (gameData.spectatedBrawlerId != playerData.ownBrawlerId)
+						{
+							gameData.spectatedBrawlerId = playerData.ownBrawlerId;
+
+							SpectateTargetPacket spectateTarget;
+							spectateTarget.brawlerId = playerData.ownBrawlerId.value();
+							enet_peer_send(gameData.serverPeer, 0, build_packet(spectateTarget, ENET_PACKET_FLAG_RELIABLE));
+						}
+
 						auto entityIt = gameData.networkToEntities.find(playerData.ownBrawlerId.value());
 						if (entityIt != gameData.networkToEntities.end())
 						{
@@ -798,6 +854,14 @@ int main()
 
 		renderer.Present();
 
+		if (gameData.isWaitingFirstFrame)
+		{
+			const auto& snapshotCounters = gameData.messageDispatcher.GetCounters(Opcode::S_WorldSnapshot);
+			std::cout << "time to first frame: " << gameData.joinClock.GetElapsedTime() * 1000.f << "ms (world snapshot: " << snapshotCounters.totalBytes << " bytes)" << std::endl;
+
+			gameData.isWaitingFirstFrame = false;
+		}
+
 		// On vrifie si assez de temps s'est coul pour faire avancer la logique du jeu
 		if (now >= gameData.nextTick)
 		{
@@ -958,442 +1022,481 @@ void OneShotAnimationSystem(GameData& gameData, float deltaTime)
 	}
 }
 
-void handle_message(const std::vector<std::uint8_t>& message, GameData& gameData)
+void handle_player_list(GameData& gameData, PlayerListPacket& packet)
 {
-	// On dcode l'opcode pour savoir  quel type de message on a affaire
-	std::size_t offset = 0;
-	Opcode opcode = static_cast<Opcode>(Deserialize_u8(message, offset));
-	switch (opcode)
+	// Create a temporary map for the new player list from the packet
+	std::map<std::uint32_t, PlayerData> newPlayers;
+
+	for (const auto& packetPlayer : packet.players)
+	{
+		PlayerData player;
+		player.name = packetPlayer.name;
+		player.isDead = packetPlayer.isDead;
+		if (packetPlayer.hasBrawler)
+			player.ownBrawlerId = packetPlayer.brawlerId;
+
+		newPlayers[packetPlayer.id] = player;
+	}
+
+	// Compare and track disconnected players
+	for (const auto& [playerId, playerData] : gameData.players)
 	{
-		case Opcode::S_PlayerList:
+		if (newPlayers.find(playerId) == newPlayers.end())
 		{
-			PlayerListPacket packet = PlayerListPacket::Deserialize(message, offset);
+			// Player is not in the new list (disconnected), remove from spectatablePlayers
+			gameData.spectatablePlayers.erase(playerId);
+			gameData.previousSpectateIndex = 50; // random number above player limits to trigger UI change
+		}
+		else
+		{
+			newPlayers[playerId].skinId = playerData.skinId;
+		}
+	}
 
-			// Create a temporary map for the new player list from the packet
-			std::map<std::uint32_t, PlayerData> newPlayers;
+	gameData.players = std::move(newPlayers);
+}
 
-			for (const auto& packetPlayer : packet.players)
-			{
-				PlayerData player;
-				player.name = packetPlayer.name;
-				player.isDead = packetPlayer.isDead;
-				if (packetPlayer.hasBrawler)
-					player.ownBrawlerId = packetPlayer.brawlerId;
+void handle_create_brawler(GameData& gameData, CreateBrawlerPacket& packet)
+{
+	Sel::Vector2f position = packet.position;
+	Sel::Vector2f linearVelocity = packet.linearVelocity;
+	float scale = packet.scale;
 
-				newPlayers[packetPlayer.id] = player;
-			}
+	std::string brawlerName;
+	auto playerDataIt = gameData.players.find(packet.playerId);
+	if (playerDataIt != gameData.players.end())
+	{
+		playerDataIt->second.ownBrawlerId = packet.brawlerId;
+		playerDataIt->second.skinId = packet.skinId;
+		brawlerName = playerDataIt->second.name;
+	}
 
-			// Compare and track disconnected players
-			for (const auto& [playerId, playerData] : gameData.players)
-			{
-				if (newPlayers.find(playerId) == newPlayers.end())
-				{
-					// Player is not in the new list (disconnected), remove from spectatablePlayers
-					gameData.spectatablePlayers.erase(playerId);
-					gameData.previousSpectateIndex = 50; // random number above player limits to trigger UI change
-				}
-				else
-				{
-					newPlayers[playerId].skinId = playerData.skinId;
-				}
-			}
+	if (brawlerName.empty())
+		brawlerName = "Default Name";
 
-			gameData.players = std::move(newPlayers);
+	
 
-			break;
-		}
+	BrawlerClient brawler(*(gameData.registry), position, 0.f, scale, linearVelocity, packet.skinId);
+	auto brawlerNameEntity = CreateDisplayText(gameData, *(gameData.renderer), brawlerName, 26, Sel::Color::White, "assets/fonts/Hey Comic.otf", {0.5f, 0.5f}, false);
 
-		case Opcode::S_CreateBrawler:
-		{
-			CreateBrawlerPacket packet = CreateBrawlerPacket::Deserialize(message, offset);
-			Sel::Vector2f position = packet.position;
-			Sel::Vector2f linearVelocity = packet.linearVelocity;
-			float scale = packet.scale;
-
-			std::string brawlerName;
-			auto playerDataIt = gameData.players.find(packet.playerId);
-			if (playerDataIt != gameData.players.end())
-			{
-				playerDataIt->second.ownBrawlerId = packet.brawlerId;
-				playerDataIt->second.skinId = packet.skinId;
-				brawlerName = playerDataIt->second.name;
-			}
+	gameData.floatingEntitySystem->AddFloatingEntity(brawler.GetHandle().entity(), brawlerNameEntity.entity(), { 0.f, -40.f });
 
-			if (brawlerName.empty())
-				brawlerName = "Default Name";
+	gameData.networkToEntities[packet.brawlerId] = brawler.GetHandle();
 
-			
 
-			BrawlerClient brawler(*(gameData.registry), position, 0.f, scale, linearVelocity, packet.skinId);
-			auto brawlerNameEntity = CreateDisplayText(gameData, *(gameData.renderer), brawlerName, 26, Sel::Color::White, "assets/fonts/Hey Comic.otf", {0.5f, 0.5f}, false);
+	/*std::cout << "new Brawler" << std::endl;*/
+}
+
+void handle_create_collectible(GameData& gameData, CreateCollectiblePacket& packet)
+{
+	SpawnCollectible(gameData, packet);
 
-			gameData.floatingEntitySystem->AddFloatingEntity(brawler.GetHandle().entity(), brawlerNameEntity.entity(), { 0.f, -40.f });
+	/*if(packet.type == CollectibleType::GoldenCarrot)
+		std::cout << "new GoldenCarrot" << std::endl;
+	else
+		std::cout << "new Collectible" << std::endl;*/
+}
 
-			gameData.networkToEntities[packet.brawlerId] = brawler.GetHandle();
+void handle_world_snapshot(GameData& gameData, WorldSnapshotPacket& packet)
+{
+	for (CreateBrawlerPacket& brawler : packet.brawlers)
+		handle_create_brawler(gameData, brawler);
 
+	for (CreateCollectiblePacket& collectible : packet.collectibles)
+		handle_create_collectible(gameData, collectible);
 
-			/*std::cout << "new Brawler" << std::endl;*/
+	std::cout << "world snapshot applied (" << packet.brawlers.size() << " brawlers, " << packet.collectibles.size() << " collectibles) after " << gameData.joinClock.GetElapsedTime() * 1000.f << "ms" << std::endl;
+	gameData.isWaitingFirstFrame = true;
+}
 
-			break;
-		}
-		
-		case Opcode::S_CreateCollectible:
-		{
-			CreateCollectiblePacket packet = CreateCollectiblePacket::Deserialize(message, offset);
+void handle_delete_brawler(GameData& gameData, DeleteEntityPacket& packet)
+{
+	auto it = gameData.networkToEntities.find(packet.brawlerId);
+	if (it == gameData.networkToEntities.end())
+		return;
 
-			SpawnCollectible(gameData, packet);
+	gameData.registry->destroy(it->second);
 
-			/*if(packet.type == CollectibleType::GoldenCarrot)
-				std::cout << "new GoldenCarrot" << std::endl;
-			else
-				std::cout << "new Collectible" << std::endl;*/
+	gameData.networkToEntities.erase(it);
 
+	if (gameData.ownBrawlerNetworkIndex && packet.brawlerId == gameData.ownBrawlerNetworkIndex)
+		gameData.ownBrawlerNetworkIndex.reset();
+}
 
-			break;
-		}
+void handle_brawler_states(GameData& gameData, BrawlerStatesPacket& packet)
+{
+	// Unreliable packets can arrive out of order, an older snapshot is useless
+	if (packet.snapshotId <= gameData.lastSnapshotId)
+		return;
 
-		case Opcode::S_DeleteBrawler:
+	const SnapshotStates* baseline = nullptr;
+	if (packet.baselineId != InvalidSnapshotId)
+	{
+		baseline = gameData.snapshots.Find(packet.baselineId);
+		if (!baseline)
 		{
-			DeleteEntityPacket packet = DeleteEntityPacket::Deserialize(message, offset);
+			// Shouldn't happen since the server only uses snapshots we acknowledged, wait for the next one
+			std::cout << "missing baseline " << packet.baselineId << " for snapshot " << packet.snapshotId << std::endl;
+			return;
+		}
+	}
 
-			auto it = gameData.networkToEntities.find(packet.brawlerId);
-			if (it == gameData.networkToEntities.end())
-				break;
+	// Rebuild into a scratch array first, the baseline may live in the slot we're about to overwrite
+	std::swap(gameData.previousSnapshotStates, gameData.snapshotStates);
+	ApplySnapshotDelta(baseline, packet, gameData.snapshotStates);
+	gameData.snapshots.Store(packet.snapshotId) = gameData.snapshotStates;
+	gameData.lastSnapshotId = packet.snapshotId;
 
-			gameData.registry->destroy(it->second);
+	// Only what changed since the previous snapshot is applied: a state the server deferred (over its budget) is left as is and keeps being extrapolated
+	auto previousIt = gameData.previousSnapshotStates.cbegin();
+	for (const auto& state : gameData.snapshotStates)
+	{
+		while (previousIt != gameData.previousSnapshotStates.cend() && previousIt->brawlerId < state.brawlerId)
+			++previousIt;
 
-			gameData.networkToEntities.erase(it);
+		if (previousIt != gameData.previousSnapshotStates.cend() && previousIt->brawlerId == state.brawlerId && !HasStateChanged(*previousIt, state))
+			continue;
 
-			if (gameData.ownBrawlerNetworkIndex && packet.brawlerId == gameData.ownBrawlerNetworkIndex)
-				gameData.ownBrawlerNetworkIndex.reset();
-			
-			break;
-		}
+		auto it = gameData.networkToEntities.find(state.brawlerId);
+		if (it == gameData.networkToEntities.end())
+			continue;
 
-		case Opcode::S_BrawlerStates:
-		{
-			BrawlerStatesPacket packet = BrawlerStatesPacket::Deserialize(message, offset);
+		entt::handle brawlerEntity = it->second;
+
+		auto& transform = brawlerEntity.get<Sel::Transform>();
+		transform.SetPosition(state.position);
+		
+		auto velocity = brawlerEntity.try_get<Sel::VelocityComponent>();
+		if(velocity)
+			velocity->linearVel = state.linearVelocity;
+	}
+}
+
+void handle_update_self_brawler_id(GameData& gameData, UpdateSelfBrawlerId& packet)
+{
+	gameData.ownBrawlerNetworkIndex = packet.id;
+
+	gameData.playerMode = PlayerMode::Playing;
+}
 
+void handle_collectible_collected(GameData& /*gameData*/, CollectibleCollectedPacket& /*packet*/)
+{
+	std::cout << "Collectible Recupere" << std::endl;
+}
 
-			for (const auto& state : packet.brawlers)
+void handle_update_game_state(GameData& gameData, UpdateGameStatePacket& packet)
+{
+	switch (static_cast<GameState>(packet.newGameState))
+	{
+		case GameState::Lobby:
+		{
+			gameData.isReady = false;
+			// j'tais spectateur, je peux mtnt jouer je cre mon brawler
+			if (gameData.playerMode == PlayerMode::Spectating)
 			{
-				auto it = gameData.networkToEntities.find(state.brawlerId);
-				if (it == gameData.networkToEntities.end())
-					continue;
-
-				entt::handle brawlerEntity = it->second;
-
-				auto& transform = brawlerEntity.get<Sel::Transform>();
-				transform.SetPosition(state.position);
-				
-				auto velocity = brawlerEntity.try_get<Sel::VelocityComponent>();
-				if(velocity)
-					velocity->linearVel = state.linearVelocity;
+				CreateBrawlerResquest packet;
+				enet_peer_send(gameData.serverPeer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+				gameData.playerMode = PlayerMode::Playing;
+			}
+			else if (gameData.playerMode == PlayerMode::Dead)
+			{
+				gameData.playerMode = PlayerMode::Playing;
+			}
+			else
+			{
+				gameData.playerScore = 0;
 			}
 
-			gameData.snapshots.push_back(std::move(packet));
+			// Reset Golden Data
+			gameData.goldenData.isSpawned = false;
+			gameData.goldenData.ownerId.reset();
+
+			// Clear UI
+			if (gameData.playerMode != PlayerMode::Pending)
+			{
+				ClearLeaderboard(gameData);
+			}
 
 			break;
 		}
-
-		case Opcode::S_UpdateSelfBrawlerId:
+		case GameState::GameRunning:
 		{
-			UpdateSelfBrawlerId packet = UpdateSelfBrawlerId::Deserialize(message, offset);
-			
-			gameData.ownBrawlerNetworkIndex = packet.id;
+			if (gameData.playerMode == PlayerMode::Playing)
+			{
+				gameData.spectatablePlayers.clear();
 
-			gameData.playerMode = PlayerMode::Playing;
+				// La game se lance, je met tous les joueurs prsents  vivant
+				for (auto& player : gameData.players)
+					player.second.isDead = false;
 
-			break;
-		}
+				// je les ajoute  la liste des spectables
+				gameData.spectatablePlayers = gameData.players;
 
-		case Opcode::S_CollectibleCollected:
-		{
-			std::cout << "Collectible Recupere" << std::endl;
+				break;
+			}
 
 			break;
 		}
+	}
 
-		case Opcode::S_UpdateGameState:
-		{
-			UpdateGameStatePacket packet = UpdateGameStatePacket::Deserialize(message, offset);
+	std::cout << "GameState: " << (int)(gameData.gameState) << " -> " << (int)(packet.newGameState) << std::endl;
 
-			switch (static_cast<GameState>(packet.newGameState))
-			{
-				case GameState::Lobby:
-				{
-					gameData.isReady = false;
-					// j'tais spectateur, je peux mtnt jouer je cre mon brawler
-					if (gameData.playerMode == PlayerMode::Spectating)
-					{
-						CreateBrawlerResquest packet;
-						enet_peer_send(gameData.serverPeer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-						gameData.playerMode = PlayerMode::Playing;
-					}
-					else if (gameData.playerMode == PlayerMode::Dead)
-					{
-						gameData.playerMode = PlayerMode::Playing;
-					}
-					else
-					{
-						gameData.playerScore = 0;
-					}
+	gameData.gameState = static_cast<GameState>(packet.newGameState);
+}
 
-					// Reset Golden Data
-					gameData.goldenData.isSpawned = false;
-					gameData.goldenData.ownerId.reset();
+void handle_update_player_mode(GameData& gameData, UpdatePlayerModePacket& packet)
+{
+	gameData.playerMode = static_cast<PlayerMode>(packet.newPlayerMode);
 
-					// Clear UI
-					if (gameData.playerMode != PlayerMode::Pending)
-					{
-						// Delete all entities with LeaderBoardLine
-						auto leaderboardLineView = gameData.registryUI->view<LeaderBoardLine>();
-						for (auto entity : leaderboardLineView) {
-							gameData.registryUI->destroy(entity); // Delete entities with LeaderBoardLine flag
-						}
-					}
+	if (gameData.playerMode == PlayerMode::Spectating || gameData.playerMode == PlayerMode::Dead)
+	{
+		for (auto& player : gameData.players)
+		{
+			if (!player.second.ownBrawlerId.has_value())
+				player.second.isDead = true;
 
-					break;
-				}
-				case GameState::GameRunning:
-				{
-					if (gameData.playerMode == PlayerMode::Playing)
-					{
-						gameData.spectatablePlayers.clear();
+			if (!player.second.isDead && player.second.ownBrawlerId.has_value()) // Je recupre donc les joueurs pas morts et qui ont un brawler
+				gameData.spectatablePlayers[player.first] = player.second;
+		}
+		return;
+	}
+}
 
-						// La game se lance, je met tous les joueurs prsents  vivant
-						for (auto& player : gameData.players)
-							player.second.isDead = false;
+void handle_update_leaderboard(GameData& gameData, UpdateLeaderboardPacket& packet)
+{
+	// Lines of the players still there are kept (and only rendered again if their text changed)
+	std::vector<LeaderboardEntry> leaderboard;
+	for (auto& onePlayer : packet.leaderboard)
+	{
+		LeaderboardEntry& entry = leaderboard.emplace_back();
 
-						// je les ajoute  la liste des spectables
-						gameData.spectatablePlayers = gameData.players;
+		auto it = std::find_if(gameData.leaderboard.begin(), gameData.leaderboard.end(), [&](const LeaderboardEntry& previous) { return previous.playerId == onePlayer.playerId; });
+		if (it != gameData.leaderboard.end())
+		{
+			entry = std::move(*it);
+			it->lineEntity = entt::null;
+		}
 
-						break;
-					}
+		entry.playerId = onePlayer.playerId;
+		entry.name = onePlayer.playerName;
+		entry.score = onePlayer.playerScore;
+		entry.isDead = onePlayer.isDead;
+	}
 
-					break;
-				}
-			}
+	std::swap(gameData.leaderboard, leaderboard);
 
-			std::cout << "GameState: " << (int)(gameData.gameState) << " -> " << (int)(packet.newGameState) << std::endl;
+	// Lines left are those of the players who aren't in the leaderboard anymore
+	for (const LeaderboardEntry& entry : leaderboard)
+	{
+		if (gameData.registryUI->valid(entry.lineEntity))
+			gameData.registryUI->destroy(entry.lineEntity);
+	}
 
-			gameData.gameState = static_cast<GameState>(packet.newGameState);
-			break;
-		}
+	RefreshLeaderboardLines(gameData);
+}
 
-		case Opcode::S_UpdatePlayerMode:
-		{
-			UpdatePlayerModePacket packet = UpdatePlayerModePacket::Deserialize(message, offset);
+void handle_leaderboard_delta(GameData& gameData, LeaderboardDeltaPacket& packet)
+{
+	auto findEntry = [&](std::uint32_t playerId)
+	{
+		return std::find_if(gameData.leaderboard.begin(), gameData.leaderboard.end(), [&](const LeaderboardEntry& entry) { return entry.playerId == playerId; });
+	};
 
-			gameData.playerMode = static_cast<PlayerMode>(packet.newPlayerMode);
+	for (std::uint16_t playerId : packet.removedPlayers)
+	{
+		auto it = findEntry(playerId);
+		if (it == gameData.leaderboard.end())
+			continue;
 
-			if (gameData.playerMode == PlayerMode::Spectating || gameData.playerMode == PlayerMode::Dead)
-			{
-				for (auto& player : gameData.players)
-				{
-					if (!player.second.ownBrawlerId.has_value())
-						player.second.isDead = true;
+		if (gameData.registryUI->valid(it->lineEntity))
+			gameData.registryUI->destroy(it->lineEntity);
 
-					if (!player.second.isDead && player.second.ownBrawlerId.has_value()) // Je recupre donc les joueurs pas morts et qui ont un brawler
-						gameData.spectatablePlayers[player.first] = player.second;
-				}
-				break;
-			}
+		gameData.leaderboard.erase(it);
+	}
 
-			break;
-		}
+	// Take the changed entries out, the others already are in the right order
+	std::vector<LeaderboardEntry> changedEntries;
+	for (const auto& changed : packet.entries)
+	{
+		LeaderboardEntry& entry = changedEntries.emplace_back();
 
-		case Opcode::S_UpdateLeaderboard:
+		auto it = findEntry(changed.playerId);
+		if (it != gameData.leaderboard.end())
 		{
-			// get camera
-			auto view = gameData.registryUI->view<Sel::CameraComponent, Sel::Transform>();
-			entt::entity cameraEntityUI;
-			if (view.begin() != view.end())
-				cameraEntityUI = view.front();
-			else
-				break; // no camera to anchor the leaderboard
+			entry = std::move(*it);
+			gameData.leaderboard.erase(it);
+		}
 
-			// Delete all entities with LeaderBoardLine
-			auto leaderboardLineView = gameData.registryUI->view<LeaderBoardLine>();
-			for (auto entity : leaderboardLineView) {
-				gameData.registryUI->destroy(entity); // Delete entities with LeaderBoardLine flag
-			}
+		entry.playerId = changed.playerId;
+		entry.isDead = (changed.flags & LeaderboardDeltaPacket::IsDead) != 0;
 
-			int fontSize = 24;
-			UpdateLeaderboardPacket packet = UpdateLeaderboardPacket::Deserialize(message, offset);
+		if (changed.flags & LeaderboardDeltaPacket::Score)
+			entry.score = changed.playerScore;
 
-			float displayOffset = 0.f;
-			float interlineOffset = 5.f;
-			int index = 0;
-			for (auto& onePlayer : packet.leaderboard)
-			{
-				std::string textToDisplay = onePlayer.playerName + " | " + std::to_string(onePlayer.playerScore);
-				Sel::Color textColor = onePlayer.isDead ? Sel::Color::Red : Sel::Color::White;
-				if (!onePlayer.isDead)
-				{
-					if (index < packet.leaderboard.size() - 1)
-						textColor = packet.leaderboard[index + 1].isDead ? Sel::Color::FromRGBA8(255, 165, 0, 255) : Sel::Color::White; // Je suis pas mort mais en danger si le suivant est mort | safe si le suivant est vivant
-					else
-						textColor = Sel::Color::FromRGBA8(255, 165, 0, 255); // Je suis le dernier du leaderboard et je suis encore en vie = danger
-				}
+		if (changed.flags & LeaderboardDeltaPacket::Name)
+			entry.name = changed.playerName;
+	}
 
-				auto textEntityHandle = CreateDisplayText(gameData, *(gameData.renderer), textToDisplay, fontSize, textColor, "assets/fonts/Happy Selfie.otf", {0.f, 0.f}, true);
-				gameData.registryUI->emplace<LeaderBoardLine>(textEntityHandle);
+	// Entries are sorted by rank, inserting them in that order puts each one at its rank
+	for (std::size_t i = 0; i < changedEntries.size(); ++i)
+	{
+		std::size_t rank = std::min<std::size_t>(packet.entries[i].rank, gameData.leaderboard.size());
+		gameData.leaderboard.insert(gameData.leaderboard.begin() + rank, std::move(changedEntries[i]));
+	}
 
-				gameData.floatingEntitySystemUI->AddFloatingEntity(cameraEntityUI, textEntityHandle, { 0.f + SCREEN_MARGIN, displayOffset + SCREEN_MARGIN });
+	RefreshLeaderboardLines(gameData);
+}
 
-				displayOffset += (float)fontSize + interlineOffset;
-				index++;
-			}
+void handle_brawler_death(GameData& gameData, BrawlerDeathPacket& packet)
+{
+	// Mark the player as dead in gameData.players
+	auto it = gameData.players.find(packet.playerId);
+	if (it != gameData.players.end())
+		it->second.isDead = true;
 
-			break;
-		}
+	NewAnnouncement(gameData, it->second.name + " died... poor " + it->second.name, Sel::Color::Red, 30);
 
-		case Opcode::S_BrawlerDeath:
-		{
-			BrawlerDeathPacket packet = BrawlerDeathPacket::Deserialize(message, offset);
+	if (packet.brawlerId == gameData.ownBrawlerNetworkIndex)
+	{
+		std::cout << "Im Dead" << std::endl;
+		gameData.playerMode = PlayerMode::Dead;
+		gameData.beforeSpectateClock.Restart();
+	}
 
-			// Mark the player as dead in gameData.players
-			auto it = gameData.players.find(packet.playerId);
-			if (it != gameData.players.end())
-				it->second.isDead = true;
+	bool bFlip = true;
+	auto brawlerIt = gameData.networkToEntities.find(packet.brawlerId);
+	if (brawlerIt != gameData.networkToEntities.end())
+	{
+		bFlip = brawlerIt->second.try_get<Sel::Transform>()->GetScale().x > 0 ? false : true;
+	}
 
-			NewAnnouncement(gameData, it->second.name + " died... poor " + it->second.name, Sel::Color::Red, 30);
+	int skinId = it->second.skinId.has_value() ? it->second.skinId.value() : 0;
+	// Spawn temp entity for death anim
+	BrawlerClient::BuildTemp(*(gameData.registry), packet.deathPosition, bFlip, skinId);
 
-			if (packet.brawlerId == gameData.ownBrawlerNetworkIndex)
-			{
-				std::cout << "Im Dead" << std::endl;
-				gameData.playerMode = PlayerMode::Dead;
-				gameData.beforeSpectateClock.Restart();
-			}
+	
 
-			bool bFlip = true;
-			auto brawlerIt = gameData.networkToEntities.find(packet.brawlerId);
-			if (brawlerIt != gameData.networkToEntities.end())
-			{
-				bFlip = brawlerIt->second.try_get<Sel::Transform>()->GetScale().x > 0 ? false : true;
-			}
+	// Remove the player from gameData.spectablePlayers if it exists
+	auto spectableIt = gameData.spectatablePlayers.find(packet.playerId);
+	if (spectableIt != gameData.spectatablePlayers.end())
+		gameData.spectatablePlayers.erase(spectableIt);
+}
 
-			int skinId = it->second.skinId.has_value() ? it->second.skinId.value() : 0;
-			// Spawn temp entity for death anim
-			BrawlerClient::BuildTemp(*(gameData.registry), packet.deathPosition, bFlip, skinId);
+void handle_player_steal(GameData& gameData, PlayerStealPacket& packet)
+{
+	auto it = gameData.networkToEntities.find(packet.brawlerId); 
+	if (it != gameData.networkToEntities.end())
+	{
+		it->second.emplace_or_replace<OneShotAnimation>(false, "steal", 0.3f);
+	}
+}
 
-			
+void handle_winner(GameData& gameData, WinnerPacket& packet)
+{
+	if (!gameData.ownBrawlerNetworkIndex)
+		return;
 
-			// Remove the player from gameData.spectablePlayers if it exists
-			auto spectableIt = gameData.spectatablePlayers.find(packet.playerId);
-			if (spectableIt != gameData.spectatablePlayers.end())
-				gameData.spectatablePlayers.erase(spectableIt);
+	if (gameData.ownBrawlerNetworkIndex == packet.brawlerNetworkId)
+	{
+		std::cout << "I am the winner" << std::endl;
+	}
+}
 
-			break;
-		}
-		
-		case Opcode::S_PlayerSteal:
+void handle_golden_event(GameData& gameData, GoldenEventPacket& packet)
+{
+	std::string text = "";
+
+	switch (packet.eventType)
+	{
+		case GoldenEventPacket::GoldenEventType::Spawn:
 		{
-			PlayerStealPacket packet = PlayerStealPacket::Deserialize(message, offset);
+			text = "The golden berry has spawn in the middle!";
+			NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
 
-			auto it = gameData.networkToEntities.find(packet.brawlerId); 
-			if (it != gameData.networkToEntities.end())
-			{
-				it->second.emplace_or_replace<OneShotAnimation>(false, "steal", 0.3f);
-			}
+			gameData.goldenData.isSpawned = true;
 
 			break;
 		}
 
-		case Opcode::S_Winner:
+		case GoldenEventPacket::GoldenEventType::Gathered:
 		{
-			WinnerPacket packet = WinnerPacket::Deserialize(message, offset);
+			text = "Someone got the golden berry... Steal it!";
 
-			if (!gameData.ownBrawlerNetworkIndex)
-				break;
+			auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
+				[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
+					return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.newOwner;
+				});
+			if (it != gameData.players.end())
+				text = it->second.name + " got the golden berry.. Steal it!";
 
-			if (gameData.ownBrawlerNetworkIndex == packet.brawlerNetworkId)
-			{
-				std::cout << "I am the winner" << std::endl;
-			}
+			gameData.goldenData.ownerId = packet.newOwner;
 
+			NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
 			break;
 		}
 
-		case Opcode::S_GoldenEvent:
+		case GoldenEventPacket::GoldenEventType::Released:
 		{
-			GoldenEventPacket packet = GoldenEventPacket::Deserialize(message, offset);
-			std::string text = "";
-
-			switch (packet.eventType)
-			{
-				case GoldenEventPacket::GoldenEventType::Spawn:
-				{
-					text = "The golden berry has spawn in the middle!";
-					NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
-
-					gameData.goldenData.isSpawned = true;
-
-					break;
-				}
-
-				case GoldenEventPacket::GoldenEventType::Gathered:
-				{
-					text = "Someone got the golden berry... Steal it!";
-
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
-						[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
-							return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.newOwner;
-						});
-					if (it != gameData.players.end())
-						text = it->second.name + " got the golden berry.. Steal it!";
+			text = "The gold berry has been lost. That's your chance!";
 
-					gameData.goldenData.ownerId = packet.newOwner;
-
-					NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
-					break;
-				}
-
-				case GoldenEventPacket::GoldenEventType::Released:
-				{
-					text = "The gold berry has been lost. That's your chance!";
-
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
-						[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
-							return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.previousOwner;
-						});
-					if (it != gameData.players.end())
-						text = it->second.name + " lost the golden berry... That's your chance!";
+			auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
+				[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
+					return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.previousOwner;
+				});
+			if (it != gameData.players.end())
+				text = it->second.name + " lost the golden berry... That's your chance!";
 
-					gameData.goldenData.ownerId.reset();
+			gameData.goldenData.ownerId.reset();
 
-					NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
-					break;
-				}
+			NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
+			break;
+		}
 
-				case GoldenEventPacket::GoldenEventType::Steal:
-				{
-					text = "The gold berry has been stolen!";
+		case GoldenEventPacket::GoldenEventType::Steal:
+		{
+			text = "The gold berry has been stolen!";
 
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
-						[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
-							return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.previousOwner;
-						});
+			auto it = std::find_if(gameData.players.begin(), gameData.players.end(),
+				[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
+					return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.previousOwner;
+				});
 
-					auto it2 = std::find_if(gameData.players.begin(), gameData.players.end(),
-						[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
-							return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.newOwner;
-						});
+			auto it2 = std::find_if(gameData.players.begin(), gameData.players.end(),
+				[&packet](const std::pair<const std::uint32_t, PlayerData>& pair) {
+					return pair.second.ownBrawlerId.has_value() && pair.second.ownBrawlerId.value() == packet.newOwner;
+				});
 
-					if (it != gameData.players.end() && it2 != gameData.players.end())
-						text = it2->second.name + " stole the golden berry to " + it->second.name + "!";
+			if (it != gameData.players.end() && it2 != gameData.players.end())
+				text = it2->second.name + " stole the golden berry to " + it->second.name + "!";
 
-					gameData.goldenData.ownerId = packet.newOwner;
+			gameData.goldenData.ownerId = packet.newOwner;
 
-					NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
-					break;
-				}
-			}
+			NewAnnouncement(gameData, text, Sel::Color::FromRGBA8(255, 223, 128), 30);
+			break;
 		}
 	}
 }
 
+void register_message_handlers(MessageDispatcher<GameData&>& dispatcher)
+{
+	dispatcher.Register<PlayerListPacket>(&handle_player_list);
+	dispatcher.Register<CreateBrawlerPacket>(&handle_create_brawler);
+	dispatcher.Register<CreateCollectiblePacket>(&handle_create_collectible);
+	dispatcher.Register<DeleteEntityPacket>(&handle_delete_brawler);
+	dispatcher.Register<BrawlerStatesPacket>(&handle_brawler_states);
+	dispatcher.Register<UpdateSelfBrawlerId>(&handle_update_self_brawler_id);
+	dispatcher.Register<CollectibleCollectedPacket>(&handle_collectible_collected);
+	dispatcher.Register<UpdateGameStatePacket>(&handle_update_game_state);
+	dispatcher.Register<UpdatePlayerModePacket>(&handle_update_player_mode);
+	dispatcher.Register<UpdateLeaderboardPacket>(&handle_update_leaderboard);
+	dispatcher.Register<LeaderboardDeltaPacket>(&handle_leaderboard_delta);
+	dispatcher.Register<BrawlerDeathPacket>(&handle_brawler_death);
+	dispatcher.Register<PlayerStealPacket>(&handle_player_steal);
+	dispatcher.Register<WinnerPacket>(&handle_winner);
+	dispatcher.Register<GoldenEventPacket>(&handle_golden_event);
+	dispatcher.Register<WorldSnapshotPacket>(&handle_world_snapshot);
+}
+
 bool run_network(ENetHost* host, GameData& gameData)
 {
 	ENetEvent event;
@@ -1414,11 +1517,9 @@ bool run_network(ENetHost* host, GameData& gameData)
 			case ENET_EVENT_TYPE_RECEIVE:
 			{
 				// On a reu un message ! Traitons-le
-				std::vector<std::uint8_t> content(event.packet->dataLength); //< On copie son contenu dans un std::vector pour plus de facilit de gestion
-				std::memcpy(content.data(), event.packet->data, event.packet->dataLength);
-
-				// On gre le message qu'on a reu
-				handle_message(content, gameData);
+				// It is decoded in place from the ENet packet, which stays alive until we destroy it below
+				if (!gameData.messageDispatcher.Dispatch(ByteSpan(event.packet->data, event.packet->dataLength), gameData))
+					std::cout << "Unhandled message from server" << std::endl;
 
 				// On n'oublie pas de librer le packet
 				enet_packet_destroy(event.packet);
@@ -1471,12 +1572,90 @@ void AnnouncementSystem(GameData& gameData, entt::entity camera, float deltaTime
 	}
 }
 
+void ClearLeaderboard(GameData& gameData)
+{
+	for (const LeaderboardEntry& entry : gameData.leaderboard)
+	{
+		if (gameData.registryUI->valid(entry.lineEntity))
+			gameData.registryUI->destroy(entry.lineEntity);
+	}
+
+	gameData.leaderboard.clear();
+}
+
+void RefreshLeaderboardLines(GameData& gameData)
+{
+	// get camera
+	auto view = gameData.registryUI->view<Sel::CameraComponent, Sel::Transform>();
+	if (view.begin() == view.end())
+		return; // no camera to anchor the leaderboard
+
+	entt::entity cameraEntityUI = view.front();
+
+	int fontSize = 24;
+	float interlineOffset = 5.f;
+
+	for (std::size_t rank = 0; rank < gameData.leaderboard.size(); ++rank)
+	{
+		LeaderboardEntry& entry = gameData.leaderboard[rank];
+
+		std::string text = entry.name + " | " + std::to_string(entry.score);
+
+		// Je suis pas mort mais en danger si le suivant est mort (ou si je suis le dernier) | safe si le suivant est vivant
+		LeaderboardLineColor color = LeaderboardLineColor::Safe;
+		if (entry.isDead)
+			color = LeaderboardLineColor::Dead;
+		else if (rank + 1 == gameData.leaderboard.size() || gameData.leaderboard[rank + 1].isDead)
+			color = LeaderboardLineColor::Danger;
+
+		Sel::Color textColor;
+		switch (color)
+		{
+			case LeaderboardLineColor::Safe:   textColor = Sel::Color::White; break;
+			case LeaderboardLineColor::Danger: textColor = Sel::Color::FromRGBA8(255, 165, 0, 255); break;
+			case LeaderboardLineColor::Dead:   textColor = Sel::Color::Red; break;
+		}
+
+		Sel::Vector2f offset = { 0.f + SCREEN_MARGIN, rank * ((float)fontSize + interlineOffset) + SCREEN_MARGIN };
+
+		bool hasLine = gameData.registryUI->valid(entry.lineEntity);
+		if (!hasLine || entry.lineText != text)
+		{
+			// Only a new text has to be rendered
+			if (hasLine)
+				gameData.registryUI->destroy(entry.lineEntity);
+
+			auto textEntityHandle = CreateDisplayText(gameData, *(gameData.renderer), text, fontSize, textColor, "assets/fonts/Happy Selfie.otf", {0.f, 0.f}, true);
+			textEntityHandle.emplace<LeaderBoardLine>();
+
+			gameData.floatingEntitySystemUI->AddFloatingEntity(cameraEntityUI, textEntityHandle, offset);
+
+			entry.lineEntity = textEntityHandle.entity();
+			entry.lineText = std::move(text);
+		}
+		else
+		{
+			if (entry.lineColor != color)
+			{
+				auto& graphics = gameData.registryUI->get<Sel::GraphicsComponent>(entry.lineEntity);
+				std::static_pointer_cast<Sel::Sprite>(graphics.renderable)->SetColor(textColor);
+			}
+
+			if (entry.lineRank != rank)
+				gameData.floatingEntitySystemUI->SetOffset(entry.lineEntity, offset);
+		}
+
+		entry.lineColor = color;
+		entry.lineRank = rank;
+	}
+}
 
 void tick(GameData& gameData)
 {
-	PlayerInputsPacket playerInputs;
-	playerInputs.brawlerId = *(gameData.ownBrawlerNetworkIndex);
-	playerInputs.inputs = gameData.inputs;
+	// Spectators send their inputs too, they're ignored by the server
+	PlayerInputsPacket& playerInputs = gameData.inputsPacket;
+	playerInputs.PushInputs(gameData.inputs);
+	playerInputs.lastSnapshotId = gameData.lastSnapshotId;
 
 	enet_peer_send(gameData.serverPeer, 0, build_packet(playerInputs, 0));
 }
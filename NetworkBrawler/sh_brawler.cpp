@@ -17,7 +17,7 @@ Brawler::Brawler(entt::registry& registry) :
 Brawler::Brawler(entt::registry& registry, const Sel::Vector2f& position, float rotation, float scale, const Sel::Vector2f& linearVelocity) :
     m_position(position),
     m_linearVelocity(linearVelocity),
-    m_speed(200.f)
+    m_speed(BrawlerSpeed)
 {
     entt::entity brawler = registry.create();
 
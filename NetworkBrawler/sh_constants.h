@@ -17,10 +17,8 @@ const float SCREEN_MARGIN = 10.f;
 
 const float KILL_INTERVAL = 30.f;
 
-const float WORLD_MIN_X = -940.f;
-const float WORLD_MAX_X = 1060.f;
-const float WORLD_MIN_Y = -1100.f;
-const float WORLD_MAX_Y = 900.f;
+// The server keeps brawlers inside [-WorldHalfSize, WorldHalfSize] on both axes, BrawlerStatesPacket quantizes positions over the same bounds
+constexpr float WorldHalfSize = 1000.f;
 
 enum class CollectibleType : std::uint8_t
 {
@@ -72,4 +70,13 @@ constexpr float StealAnimationDuration = 0.5f;
 constexpr float TickDelay = 1.f / 30.f;
 
 // Taille maximale du nom d'un joueur
-constexpr std::size_t MaxPlayerNameLength = 16;
\ No newline at end of file
+constexpr std::size_t MaxPlayerNameLength = 16;
+
+// Brawler movement speed, the velocities it produces are encoded as a direction in BrawlerStatesPacket
+constexpr float BrawlerSpeed = 200.f;
+
+// Number of bits per axis of the quantized positions in BrawlerStatesPacket (16 bits over the 2000 units of the world is ~0.03 unit of precision)
+constexpr unsigned int StatePositionBits = 16;
+
+// Maximum number of players connected at once to a server (ENet handles up to 4095 peers)
+constexpr std::size_t MaxPlayers = 256;
\ No newline at end of file
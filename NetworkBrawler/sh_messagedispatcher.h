@@ -0,0 +1,153 @@
+#pragma once
+
+#include "sh_protocol.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+
+// Dispatches the received messages to the handler registered for their opcode.
+// Every opcode keeps counters (messages, bytes, time spent in the handler) so we can see which messages cost the most under load.
+// Args are the context given to every handler (server: the sending player, the game data...)
+template<typename... Args>
+class MessageDispatcher
+{
+public:
+	struct Counters
+	{
+		std::uint64_t messageCount = 0;
+		std::uint64_t totalBytes = 0; //< opcode included
+		std::chrono::nanoseconds totalTime = std::chrono::nanoseconds::zero();
+	};
+
+	MessageDispatcher() = default;
+	MessageDispatcher(const MessageDispatcher&) = delete;
+	MessageDispatcher(MessageDispatcher&&) = delete;
+	~MessageDispatcher() = default;
+
+	// Decodes the opcode and calls its handler, returns false if the message is empty, if no handler handles its opcode or if it's malformed (not handled either)
+	bool Dispatch(ByteSpan message, Args... args)
+	{
+		if (message.size == 0)
+		{
+			m_unhandledCount++;
+			return false;
+		}
+
+		std::size_t offset = 0;
+		std::uint8_t opcode = Deserialize_u8(message, offset);
+		if (opcode >= OpcodeCount || !m_entries[opcode].handler)
+		{
+			m_unhandledCount++;
+			return false;
+		}
+
+		Entry& entry = m_entries[opcode];
+
+		auto start = std::chrono::steady_clock::now();
+		bool isHandled = entry.handler(message, offset, args...);
+		entry.counters.totalTime += std::chrono::steady_clock::now() - start;
+
+		if (!isHandled)
+		{
+			m_unhandledCount++;
+			return false;
+		}
+
+		entry.counters.messageCount++;
+		entry.counters.totalBytes += message.size;
+
+		return true;
+	}
+
+	// Writes the counters of every opcode which received something, most expensive handlers first
+	void DumpCounters(std::ostream& out) const
+	{
+		std::array<std::size_t, OpcodeCount> order;
+		for (std::size_t i = 0; i < OpcodeCount; ++i)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) { return m_entries[lhs].counters.totalTime > m_entries[rhs].counters.totalTime; });
+
+		out << std::left << std::setw(26) << "opcode"
+		    << std::right << std::setw(10) << "count"
+		    << std::setw(12) << "bytes"
+		    << std::setw(10) << "avg B"
+		    << std::setw(12) << "total ms"
+		    << std::setw(10) << "avg us" << '\n';
+
+		for (std::size_t opcode : order)
+		{
+			const Counters& counters = m_entries[opcode].counters;
+			if (counters.messageCount == 0)
+				continue;
+
+			double totalMs = std::chrono::duration<double, std::milli>(counters.totalTime).count();
+
+			out << std::left << std::setw(26) << GetOpcodeName(static_cast<Opcode>(opcode))
+			    << std::right << std::setw(10) << counters.messageCount
+			    << std::setw(12) << counters.totalBytes
+			    << std::fixed << std::setprecision(1)
+			    << std::setw(10) << static_cast<double>(counters.totalBytes) / counters.messageCount
+			    << std::setw(12) << totalMs
+			    << std::setw(10) << totalMs * 1000.0 / counters.messageCount << '\n';
+		}
+
+		out << "unhandled messages: " << m_unhandledCount << std::endl;
+	}
+
+	const Counters& GetCounters(Opcode opcode) const
+	{
+		assert(static_cast<std::size_t>(opcode) < OpcodeCount);
+		return m_entries[static_cast<std::size_t>(opcode)].counters;
+	}
+
+	std::uint64_t GetUnhandledCount() const
+	{
+		return m_unhandledCount;
+	}
+
+	// T is the packet type, handler is called as handler(args..., T& packet) once the packet is decoded (and not if it's malformed)
+	template<typename T, typename F>
+	void Register(F&& handler)
+	{
+		Entry& entry = m_entries[static_cast<std::size_t>(T::opcode)];
+		assert(!entry.handler); //< one handler per opcode
+
+		entry.handler = [handler = std::forward<F>(handler)](ByteSpan message, std::size_t& offset, Args... args)
+		{
+			T packet = T::Deserialize(message, offset);
+			if (IsMalformed(message, offset))
+				return false;
+
+			handler(args..., packet);
+			return true;
+		};
+	}
+
+	void ResetCounters()
+	{
+		for (Entry& entry : m_entries)
+			entry.counters = Counters{};
+
+		m_unhandledCount = 0;
+	}
+
+	MessageDispatcher& operator=(const MessageDispatcher&) = delete;
+	MessageDispatcher& operator=(MessageDispatcher&&) = delete;
+
+private:
+	struct Entry
+	{
+		std::function<bool(ByteSpan message, std::size_t& offset, Args... args)> handler;
+		Counters counters;
+	};
+
+	std::array<Entry, OpcodeCount> m_entries;
+	std::uint64_t m_unhandledCount = 0;
+};
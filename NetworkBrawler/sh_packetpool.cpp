@@ -0,0 +1,83 @@
+#include "sh_packetpool.h"
+#include <cassert>
+
+PacketPool::PacketPool()
+{
+	m_freeBuffers.reserve(MaxFreeBuffers);
+}
+
+std::unique_ptr<PacketPool::Buffer> PacketPool::Acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_freeBuffers.empty())
+		{
+			std::unique_ptr<Buffer> buffer = std::move(m_freeBuffers.back());
+			m_freeBuffers.pop_back();
+
+			return buffer;
+		}
+
+		m_allocatedBufferCount++;
+	}
+
+	// Pool is cold (or every buffer is in flight), allocate a new one
+	return std::make_unique<Buffer>();
+}
+
+ENetPacket* PacketPool::CreatePacket(std::unique_ptr<Buffer> buffer, enet_uint32 flags)
+{
+	// ENet doesn't copy the data with this flag, the buffer has to outlive the packet (it's given back in OnPacketFree)
+	ENetPacket* packet = enet_packet_create(buffer->bytes.data(), buffer->bytes.size(), flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+	if (!packet)
+	{
+		Release(std::move(buffer));
+		return nullptr;
+	}
+
+	packet->freeCallback = &PacketPool::OnPacketFree;
+	packet->userData = buffer.release();
+
+	return packet;
+}
+
+std::size_t PacketPool::GetAllocatedBufferCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_allocatedBufferCount;
+}
+
+std::size_t PacketPool::GetFreeBufferCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_freeBuffers.size();
+}
+
+PacketPool& PacketPool::Instance()
+{
+	static PacketPool pool;
+	return pool;
+}
+
+void PacketPool::Release(std::unique_ptr<Buffer> buffer)
+{
+	// clear() keeps the capacity, that's the whole point
+	buffer->bytes.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_freeBuffers.size() >= MaxFreeBuffers)
+	{
+		m_allocatedBufferCount--;
+		return; //< buffer is freed when going out of scope
+	}
+
+	m_freeBuffers.push_back(std::move(buffer));
+}
+
+void PacketPool::OnPacketFree(ENetPacket* packet)
+{
+	assert(packet->userData);
+
+	Instance().Release(std::unique_ptr<Buffer>(static_cast<Buffer*>(packet->userData)));
+	packet->userData = nullptr;
+}
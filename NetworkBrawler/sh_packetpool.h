@@ -0,0 +1,50 @@
+#pragma once
+
+#include <enet6/enet.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycles the buffers our outgoing packets are serialized into.
+// A buffer is used as the ENet packet memory (ENET_PACKET_FLAG_NO_ALLOCATE) and goes back to the pool when ENet destroys the packet,
+// so once the pool is warm building a packet doesn't allocate anything on our side.
+class PacketPool
+{
+public:
+	struct Buffer
+	{
+		std::vector<std::uint8_t> bytes;
+	};
+
+	PacketPool(const PacketPool&) = delete;
+	PacketPool(PacketPool&&) = delete;
+	~PacketPool() = default;
+
+	std::unique_ptr<Buffer> Acquire();
+	ENetPacket* CreatePacket(std::unique_ptr<Buffer> buffer, enet_uint32 flags);
+
+	std::size_t GetAllocatedBufferCount() const;
+	std::size_t GetFreeBufferCount() const;
+
+	PacketPool& operator=(const PacketPool&) = delete;
+	PacketPool& operator=(PacketPool&&) = delete;
+
+	static PacketPool& Instance();
+
+	// Past this count, released buffers are freed instead of kept (so a traffic spike doesn't pin its memory forever)
+	static constexpr std::size_t MaxFreeBuffers = 256;
+
+private:
+	PacketPool();
+
+	void Release(std::unique_ptr<Buffer> buffer);
+
+	static void OnPacketFree(ENetPacket* packet);
+
+	// Packets may be destroyed by another thread than the one which built them
+	mutable std::mutex m_mutex;
+	std::vector<std::unique_ptr<Buffer>> m_freeBuffers;
+	std::size_t m_allocatedBufferCount = 0;
+};
@@ -1,116 +1,457 @@
 #include "sh_protocol.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
+#include <lz4.h>
 
 void BrawlerData::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
 }
 
-BrawlerData BrawlerData::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+BrawlerData BrawlerData::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
 	return BrawlerData();
 }
 
-void PlayerNamePacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+namespace
 {
-	Serialize_str(byteArray, name);
+	// Marks the message malformed if size bytes can't be read at offset
+	bool CanRead(ByteSpan byteArray, std::size_t& offset, std::size_t size)
+	{
+		if (offset <= byteArray.size && size <= byteArray.size - offset)
+			return true;
+
+		MarkMalformed(byteArray, offset);
+		return false;
+	}
+
+	constexpr unsigned int ChangedFieldsBits = 2;
+
+	// Brawlers are sorted by id, the gap between two consecutive ids usually fits in a few bits
+	constexpr unsigned int SmallIdGapBits = 6;
+
+	// Brawler::ApplyInputs only produces -speed, 0 or +speed on each axis (normalized when moving diagonally)
+	enum VelocityDirection : std::uint8_t
+	{
+		None = 0,
+		Negative = 1,
+		Positive = 2
+	};
+
+	constexpr unsigned int VelocityDirectionBits = 2;
+
+	std::uint32_t AxisToDirection(float value)
+	{
+		if (value < 0.f)
+			return Negative;
+		else if (value > 0.f)
+			return Positive;
+		else
+			return None;
+	}
+
+	float DirectionToAxis(std::uint32_t direction)
+	{
+		switch (direction)
+		{
+			case Negative: return -BrawlerSpeed;
+			case Positive: return BrawlerSpeed;
+			default: return 0.f;
+		}
+	}
+
+	Sel::Vector2f DirectionToVelocity(std::uint32_t directionX, std::uint32_t directionY)
+	{
+		Sel::Vector2f velocity(DirectionToAxis(directionX), DirectionToAxis(directionY));
+
+		// Same computation as Brawler::ApplyInputs so the result is exactly the same
+		if (velocity.x != 0.f && velocity.y != 0.f)
+			velocity = Sel::Vector2f::Normal(velocity) * BrawlerSpeed;
+
+		return velocity;
+	}
+
+	bool IsInWorld(const Sel::Vector2f& position)
+	{
+		return position.x >= -WorldHalfSize && position.x <= WorldHalfSize && position.y >= -WorldHalfSize && position.y <= WorldHalfSize;
+	}
+
+	bool IsDirectionVelocity(const Sel::Vector2f& velocity)
+	{
+		Sel::Vector2f directionVelocity = DirectionToVelocity(AxisToDirection(velocity.x), AxisToDirection(velocity.y));
+		return directionVelocity.x == velocity.x && directionVelocity.y == velocity.y;
+	}
+
+	void WritePosition(BitWriter& writer, const Sel::Vector2f& position)
+	{
+		// Dead brawlers are moved far away from the world, such positions are sent as is
+		bool inWorld = IsInWorld(position);
+		writer.WriteBool(inWorld);
+
+		if (inWorld)
+		{
+			writer.Write(Quantize_f32(position.x, -WorldHalfSize, WorldHalfSize, StatePositionBits), StatePositionBits);
+			writer.Write(Quantize_f32(position.y, -WorldHalfSize, WorldHalfSize, StatePositionBits), StatePositionBits);
+		}
+		else
+		{
+			writer.WriteFloat(position.x);
+			writer.WriteFloat(position.y);
+		}
+	}
+
+	Sel::Vector2f ReadPosition(BitReader& reader)
+	{
+		if (reader.ReadBool())
+		{
+			float x = Dequantize_f32(reader.Read(StatePositionBits), -WorldHalfSize, WorldHalfSize, StatePositionBits);
+			float y = Dequantize_f32(reader.Read(StatePositionBits), -WorldHalfSize, WorldHalfSize, StatePositionBits);
+			return Sel::Vector2f(x, y);
+		}
+		else
+		{
+			float x = reader.ReadFloat();
+			float y = reader.ReadFloat();
+			return Sel::Vector2f(x, y);
+		}
+	}
+
+	void WriteVelocity(BitWriter& writer, const Sel::Vector2f& velocity)
+	{
+		std::uint32_t directionX = AxisToDirection(velocity.x);
+		std::uint32_t directionY = AxisToDirection(velocity.y);
+
+		// Any other velocity (knockback, initial velocity...) is sent as is
+		bool isDirection = IsDirectionVelocity(velocity);
+		writer.WriteBool(isDirection);
+
+		if (isDirection)
+		{
+			writer.Write(directionX, VelocityDirectionBits);
+			writer.Write(directionY, VelocityDirectionBits);
+		}
+		else
+		{
+			writer.WriteFloat(velocity.x);
+			writer.WriteFloat(velocity.y);
+		}
+	}
+
+	Sel::Vector2f ReadVelocity(BitReader& reader)
+	{
+		if (reader.ReadBool())
+		{
+			std::uint32_t directionX = reader.Read(VelocityDirectionBits);
+			std::uint32_t directionY = reader.Read(VelocityDirectionBits);
+			return DirectionToVelocity(directionX, directionY);
+		}
+		else
+		{
+			float x = reader.ReadFloat();
+			float y = reader.ReadFloat();
+			return Sel::Vector2f(x, y);
+		}
+	}
 }
 
-PlayerNamePacket PlayerNamePacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+void BrawlerStatesPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
-	PlayerNamePacket packet;
+	Serialize_u32(byteArray, snapshotId);
+	Serialize_u32(byteArray, baselineId);
 
-	packet.name = Deserialize_str(byteArray, offset);
+	Serialize_u32(byteArray, brawlers.size());
 
-	return packet;
+	// States are bit-packed: id gap, changed fields, quantized position and velocity direction
+	BitWriter writer(byteArray);
+
+	std::uint32_t previousId = 0;
+	for (const States& state : brawlers)
+	{
+		assert(state.brawlerId >= previousId); //< brawlers must be sorted by id
+
+		std::uint32_t idGap = state.brawlerId - previousId;
+		previousId = state.brawlerId;
+
+		bool isSmallGap = idGap < (1u << SmallIdGapBits);
+		writer.WriteBool(isSmallGap);
+		writer.Write(idGap, (isSmallGap) ? SmallIdGapBits : 32);
+
+		writer.Write(state.changedFields, ChangedFieldsBits);
+
+		if (state.changedFields & Position)
+			WritePosition(writer, state.position);
+
+		if (state.changedFields & LinearVelocity)
+			WriteVelocity(writer, state.linearVelocity);
+	}
+
+	writer.Flush();
 }
 
-void CreateBrawlerPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+std::size_t BrawlerStatesPacket::GetStateBitCount(const States& state, std::uint32_t previousId)
 {
-	Serialize_u32(byteArray, playerId);
-	Serialize_u32(byteArray, brawlerId);
-	Serialize_u8(byteArray, skinId);
-	Serialize_f32(byteArray, position.x);
-	Serialize_f32(byteArray, position.y);
-	Serialize_f32(byteArray, linearVelocity.x);
-	Serialize_f32(byteArray, linearVelocity.y);
-	Serialize_f32(byteArray, scale);
-	Serialize_str(byteArray, brawlerName);
+	// Same layout as Serialize
+	assert(state.brawlerId >= previousId);
+	bool isSmallGap = state.brawlerId - previousId < (1u << SmallIdGapBits);
+
+	std::size_t bitCount = 1 + ((isSmallGap) ? SmallIdGapBits : 32) + ChangedFieldsBits;
+	if (state.changedFields & Position)
+		bitCount += 1 + ((IsInWorld(state.position)) ? 2 * StatePositionBits : 2 * 32);
+
+	if (state.changedFields & LinearVelocity)
+		bitCount += 1 + ((IsDirectionVelocity(state.linearVelocity)) ? 2 * VelocityDirectionBits : 2 * 32);
+
+	return bitCount;
 }
 
-CreateBrawlerPacket CreateBrawlerPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+BrawlerStatesPacket BrawlerStatesPacket::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
-	CreateBrawlerPacket packet;
+	BrawlerStatesPacket packet;
 
-	packet.playerId = Deserialize_u32(byteArray, offset);
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
-	packet.skinId = Deserialize_u8(byteArray, offset);
-	float posX = Deserialize_f32(byteArray, offset);
-	float posY = Deserialize_f32(byteArray, offset);
-	packet.position = Sel::Vector2(posX, posY);
+	packet.snapshotId = Deserialize_u32(byteArray, offset);
+	packet.baselineId = Deserialize_u32(byteArray, offset);
 
-	float velX = Deserialize_f32(byteArray, offset);
-	float velY = Deserialize_f32(byteArray, offset);
-	packet.linearVelocity = Sel::Vector2f(velX, velY);
+	// Every state takes at least a bit
+	std::uint32_t stateCount = Deserialize_u32(byteArray, offset);
+	if (IsMalformed(byteArray, offset) || stateCount > (byteArray.size - offset) * 8)
+	{
+		MarkMalformed(byteArray, offset);
+		return packet;
+	}
 
-	packet.scale = Deserialize_f32(byteArray, offset);
+	packet.brawlers.resize(stateCount);
 
-	packet.brawlerName = Deserialize_str(byteArray, offset);
+	BitReader reader(byteArray, offset);
+
+	std::uint32_t previousId = 0;
+	for (auto& state : packet.brawlers)
+	{
+		bool isSmallGap = reader.ReadBool();
+		state.brawlerId = previousId + reader.Read((isSmallGap) ? SmallIdGapBits : 32);
+		previousId = state.brawlerId;
+
+		state.changedFields = static_cast<std::uint8_t>(reader.Read(ChangedFieldsBits));
+
+		if (state.changedFields & Position)
+			state.position = ReadPosition(reader);
+
+		if (state.changedFields & LinearVelocity)
+			state.linearVelocity = ReadVelocity(reader);
+	}
 
 	return packet;
 }
 
-void BrawlerStatesPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+void WorldSnapshotPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
-	Serialize_u32(byteArray, brawlers.size());
-	for (const States& state : brawlers)
+	using BrawlersCodec = FieldCodec<std::vector<CreateBrawlerPacket>>;
+	using CollectiblesCodec = FieldCodec<std::vector<CreateCollectiblePacket>>;
+
+	std::vector<std::uint8_t> body(BrawlersCodec::Size(brawlers) + CollectiblesCodec::Size(collectibles));
+
+	std::size_t bodyOffset = 0;
+	BrawlersCodec::Write(body, bodyOffset, brawlers);
+	CollectiblesCodec::Write(body, bodyOffset, collectibles);
+	assert(bodyOffset == body.size());
+
+	// Layout: compressed flag (u8), body size (u32), then the compressed size (u32) and the LZ4 block, or the body as is
+	std::size_t headerOffset = byteArray.size();
+	if (body.size() >= CompressionThreshold)
 	{
-		Serialize_u32(byteArray, state.brawlerId);
+		Serialize_u8(byteArray, 1);
+		Serialize_u32(byteArray, static_cast<std::uint32_t>(body.size()));
+		Serialize_u32(byteArray, 0); //< compressed size, written once known
 
-		Serialize_f32(byteArray, state.position.x);
-		Serialize_f32(byteArray, state.position.y);
+		std::size_t dataOffset = byteArray.size();
+		int maxCompressedSize = LZ4_compressBound(static_cast<int>(body.size()));
+		byteArray.resize(dataOffset + maxCompressedSize);
 
-		Serialize_f32(byteArray, state.linearVelocity.x);
-		Serialize_f32(byteArray, state.linearVelocity.y);
+		int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(body.data()), reinterpret_cast<char*>(&byteArray[dataOffset]), static_cast<int>(body.size()), maxCompressedSize);
+		if (compressedSize > 0 && static_cast<std::size_t>(compressedSize) < body.size())
+		{
+			byteArray.resize(dataOffset + compressedSize);
+			Serialize_u32(byteArray, headerOffset + 1 + sizeof(std::uint32_t), static_cast<std::uint32_t>(compressedSize));
+			return;
+		}
+
+		// Not worth it (or failed), send the body as is
+		byteArray.resize(headerOffset);
 	}
+
+	Serialize_u8(byteArray, 0);
+	Serialize_u32(byteArray, static_cast<std::uint32_t>(body.size()));
+	byteArray.insert(byteArray.end(), body.begin(), body.end());
 }
 
-BrawlerStatesPacket BrawlerStatesPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+WorldSnapshotPacket WorldSnapshotPacket::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
-	BrawlerStatesPacket packet;
+	WorldSnapshotPacket packet;
 
-	packet.brawlers.resize(Deserialize_u32(byteArray, offset));
+	// Oversized, truncated or undecompressable snapshots come from the network: they're dropped as malformed, never thrown
+	bool isCompressed = Deserialize_u8(byteArray, offset) != 0;
+	std::uint32_t bodySize = Deserialize_u32(byteArray, offset);
+	if (IsMalformed(byteArray, offset) || bodySize > MaxBodySize)
+	{
+		MarkMalformed(byteArray, offset);
+		return packet;
+	}
 
-	for (auto& state : packet.brawlers)
+	ByteSpan body;
+	if (isCompressed)
 	{
-		state.brawlerId = Deserialize_u32(byteArray, offset);
+		std::uint32_t compressedSize = Deserialize_u32(byteArray, offset);
+		if (IsMalformed(byteArray, offset) || compressedSize > byteArray.size - offset)
+		{
+			MarkMalformed(byteArray, offset);
+			return packet;
+		}
 
-		float posX = Deserialize_f32(byteArray, offset);
-		float posY = Deserialize_f32(byteArray, offset);
-		state.position = Sel::Vector2(posX, posY);
+		packet.decompressedBytes.resize(bodySize);
+		int decompressedSize = LZ4_decompress_safe(reinterpret_cast<const char*>(&byteArray[offset]), reinterpret_cast<char*>(packet.decompressedBytes.data()), static_cast<int>(compressedSize), static_cast<int>(bodySize));
+		if (decompressedSize < 0 || static_cast<std::uint32_t>(decompressedSize) != bodySize)
+		{
+			packet.decompressedBytes.clear();
+			MarkMalformed(byteArray, offset);
+			return packet;
+		}
+
+		offset += compressedSize;
+		body = ByteSpan(packet.decompressedBytes);
+	}
+	else
+	{
+		if (bodySize > byteArray.size - offset)
+		{
+			MarkMalformed(byteArray, offset);
+			return packet;
+		}
 
-		float velX = Deserialize_f32(byteArray, offset);
-		float velY = Deserialize_f32(byteArray, offset);
-		state.linearVelocity = Sel::Vector2f(velX, velY);
+		body = ByteSpan(byteArray.data + offset, bodySize);
+		offset += bodySize;
 	}
 
+	std::size_t bodyOffset = 0;
+	FieldCodec<std::vector<CreateBrawlerPacket>>::Read(body, bodyOffset, packet.brawlers);
+	FieldCodec<std::vector<CreateCollectiblePacket>>::Read(body, bodyOffset, packet.collectibles);
+	if (bodyOffset != body.size)
+		MarkMalformed(byteArray, offset);
+
 	return packet;
 }
 
-void DeleteEntityPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+BitWriter::BitWriter(std::vector<std::uint8_t>& byteArray) :
+	m_byteArray(byteArray),
+	m_scratch(0),
+	m_scratchBits(0)
 {
-	Serialize_u32(byteArray, brawlerId);
 }
 
-DeleteEntityPacket DeleteEntityPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+void BitWriter::Flush()
 {
-	DeleteEntityPacket packet;
+	if (m_scratchBits == 0)
+		return;
 
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
+	m_byteArray.push_back(static_cast<std::uint8_t>(m_scratch << (8 - m_scratchBits)));
+	m_scratch = 0;
+	m_scratchBits = 0;
+}
 
-	return packet;
+void BitWriter::Write(std::uint32_t value, unsigned int bitCount)
+{
+	assert(bitCount > 0 && bitCount <= 32);
+	assert(bitCount == 32 || value < (1ull << bitCount));
+
+	m_scratch = (m_scratch << bitCount) | value;
+	m_scratchBits += bitCount;
+
+	while (m_scratchBits >= 8)
+	{
+		m_scratchBits -= 8;
+		m_byteArray.push_back(static_cast<std::uint8_t>(m_scratch >> m_scratchBits));
+	}
+
+	m_scratch &= (1ull << m_scratchBits) - 1;
+}
+
+void BitWriter::WriteBool(bool value)
+{
+	Write((value) ? 1 : 0, 1);
+}
+
+void BitWriter::WriteFloat(float value)
+{
+	std::uint32_t v;
+	std::memcpy(&v, &value, sizeof(v));
+
+	Write(v, 32);
 }
 
+BitReader::BitReader(ByteSpan byteArray, std::size_t& offset) :
+	m_byteArray(byteArray),
+	m_offset(offset),
+	m_scratch(0),
+	m_scratchBits(0)
+{
+}
+
+std::uint32_t BitReader::Read(unsigned int bitCount)
+{
+	assert(bitCount > 0 && bitCount <= 32);
+
+	while (m_scratchBits < bitCount)
+	{
+		if (m_offset >= m_byteArray.size)
+		{
+			MarkMalformed(m_byteArray, m_offset);
+			return 0;
+		}
+
+		m_scratch = (m_scratch << 8) | m_byteArray[m_offset++];
+		m_scratchBits += 8;
+	}
+
+	m_scratchBits -= bitCount;
+	std::uint32_t value = static_cast<std::uint32_t>((m_scratch >> m_scratchBits) & ((1ull << bitCount) - 1));
+	m_scratch &= (1ull << m_scratchBits) - 1;
+
+	return value;
+}
+
+bool BitReader::ReadBool()
+{
+	return Read(1) != 0;
+}
+
+float BitReader::ReadFloat()
+{
+	std::uint32_t v = Read(32);
+
+	float value;
+	std::memcpy(&value, &v, sizeof(value));
+
+	return value;
+}
+
+std::uint32_t Quantize_f32(float value, float min, float max, unsigned int bitCount)
+{
+	assert(bitCount > 0 && bitCount <= 32);
+	assert(max > min);
+
+	double maxValue = static_cast<double>((1ull << bitCount) - 1);
+	double normalized = std::clamp((static_cast<double>(value) - min) / (static_cast<double>(max) - min), 0.0, 1.0);
+
+	return static_cast<std::uint32_t>(normalized * maxValue + 0.5);
+}
+
+float Dequantize_f32(std::uint32_t value, float min, float max, unsigned int bitCount)
+{
+	assert(bitCount > 0 && bitCount <= 32);
+
+	double maxValue = static_cast<double>((1ull << bitCount) - 1);
+
+	return static_cast<float>(min + (value / maxValue) * (static_cast<double>(max) - min));
+}
 
 void Serialize_color(std::vector<std::uint8_t>& byteArray, const Sel::Color& value)
 {
@@ -212,14 +553,14 @@ void Serialize_u32(std::vector<std::uint8_t>& byteArray, std::size_t offset, std
 	std::memcpy(&byteArray[offset], &value, sizeof(value));
 }
 
-void Serialize_str(std::vector<std::uint8_t>& byteArray, const std::string& value)
+void Serialize_str(std::vector<std::uint8_t>& byteArray, std::string_view value)
 {
 	std::size_t offset = byteArray.size();
 	byteArray.resize(offset + sizeof(std::uint32_t) + value.size());
 	return Serialize_str(byteArray, offset, value);
 }
 
-void Serialize_str(std::vector<std::uint8_t>& byteArray, std::size_t offset, const std::string& value)
+void Serialize_str(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::string_view value)
 {
 	Serialize_u32(byteArray, offset, static_cast<std::uint32_t>(value.size()));
 	offset += sizeof(std::uint32_t);
@@ -229,7 +570,7 @@ void Serialize_str(std::vector<std::uint8_t>& byteArray, std::size_t offset, con
 }
 
 
-Sel::Color Deserialize_color(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+Sel::Color Deserialize_color(ByteSpan byteArray, std::size_t& offset)
 {
 	Sel::Color value;
 	value.r = Deserialize_f32(byteArray, offset);
@@ -240,9 +581,12 @@ Sel::Color Deserialize_color(const std::vector<std::uint8_t>& byteArray, std::si
 	return value;
 }
 
-float Deserialize_f32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+float Deserialize_f32(ByteSpan byteArray, std::size_t& offset)
 {
 	std::uint32_t value;
+	if (!CanRead(byteArray, offset, sizeof(value)))
+		return 0.f;
+
 	std::memcpy(&value, &byteArray[offset], sizeof(value));
 
 	float v = ntohf(value);
@@ -252,32 +596,38 @@ float Deserialize_f32(const std::vector<std::uint8_t>& byteArray, std::size_t& o
 	return v;
 }
 
-std::int8_t Deserialize_i8(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::int8_t Deserialize_i8(ByteSpan byteArray, std::size_t& offset)
 {
 	return static_cast<std::int8_t>(Deserialize_u8(byteArray, offset));
 }
 
-std::int16_t Deserialize_i16(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::int16_t Deserialize_i16(ByteSpan byteArray, std::size_t& offset)
 {
 	return static_cast<std::int16_t>(Deserialize_u16(byteArray, offset));
 }
 
-std::int32_t Deserialize_i32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::int32_t Deserialize_i32(ByteSpan byteArray, std::size_t& offset)
 {
 	return static_cast<std::int32_t>(Deserialize_u32(byteArray, offset));
 }
 
-std::uint8_t Deserialize_u8(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::uint8_t Deserialize_u8(ByteSpan byteArray, std::size_t& offset)
 {
+	if (!CanRead(byteArray, offset, sizeof(std::uint8_t)))
+		return 0;
+
 	std::uint8_t value = byteArray[offset];
 	offset += sizeof(value);
 
 	return value;
 }
 
-std::uint16_t Deserialize_u16(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::uint16_t Deserialize_u16(ByteSpan byteArray, std::size_t& offset)
 {
 	std::uint16_t value;
+	if (!CanRead(byteArray, offset, sizeof(value)))
+		return 0;
+
 	std::memcpy(&value, &byteArray[offset], sizeof(value));
 	value = ntohs(value);
 
@@ -286,9 +636,12 @@ std::uint16_t Deserialize_u16(const std::vector<std::uint8_t>& byteArray, std::s
 	return value;
 }
 
-std::uint32_t Deserialize_u32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::uint32_t Deserialize_u32(ByteSpan byteArray, std::size_t& offset)
 {
 	std::uint32_t value;
+	if (!CanRead(byteArray, offset, sizeof(value)))
+		return 0;
+
 	std::memcpy(&value, &byteArray[offset], sizeof(value));
 	value = ntohl(value);
 
@@ -297,325 +650,183 @@ std::uint32_t Deserialize_u32(const std::vector<std::uint8_t>& byteArray, std::s
 	return value;
 }
 
-std::string Deserialize_str(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	std::uint32_t length = Deserialize_u32(byteArray, offset);
-	std::string str(length, ' ');
-	std::memcpy(&str[0], &byteArray[offset], length);
-
-	offset += length;
-
-	return str;
-}
-
-void PlayerListPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u16(byteArray, players.size());
-
-	for (const auto& player : players)
-	{
-		Serialize_u32(byteArray, player.id);
-		Serialize_str(byteArray, player.name);
-		Serialize_u8(byteArray, player.isDead);
-		Serialize_u8(byteArray, player.hasBrawler);
-		if (player.hasBrawler)
-			Serialize_u32(byteArray, player.brawlerId.value());
-	}
-}
-
-PlayerListPacket PlayerListPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	PlayerListPacket packet;
-	packet.players.resize(Deserialize_u16(byteArray, offset));
-
-	for (auto& player : packet.players)
-	{
-		player.id = Deserialize_u32(byteArray, offset);
-		player.name = Deserialize_str(byteArray, offset);
-		player.isDead = Deserialize_u8(byteArray, offset);
-		player.hasBrawler = Deserialize_u8(byteArray, offset);
-		if (player.hasBrawler)
-			player.brawlerId = Deserialize_u32(byteArray, offset);
-	}
-
-	return packet;
-}
-
-void CreateBrawlerResquest::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-}
-
-CreateBrawlerResquest CreateBrawlerResquest::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	return CreateBrawlerResquest();
-}
-
-void UpdateSelfBrawlerId::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u32(byteArray, id);
-}
-
-UpdateSelfBrawlerId UpdateSelfBrawlerId::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+std::string Deserialize_str(ByteSpan byteArray, std::size_t& offset)
 {
-	UpdateSelfBrawlerId packet;
-
-	packet.id = Deserialize_u32(byteArray, offset);
-
-	return packet;
+	return std::string(Deserialize_strview(byteArray, offset));
 }
 
-void PlayerInputsPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+std::string_view Deserialize_strview(ByteSpan byteArray, std::size_t& offset)
 {
-	Serialize_u32(byteArray, brawlerId);
-	Serialize_u8(byteArray, inputs.moveLeft);
-	Serialize_u8(byteArray, inputs.moveRight);
-	Serialize_u8(byteArray, inputs.moveUp);
-	Serialize_u8(byteArray, inputs.moveDown);
-}
+	std::uint32_t length = Deserialize_u32(byteArray, offset);
+	if (!CanRead(byteArray, offset, length))
+		return {};
 
-PlayerInputsPacket PlayerInputsPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	PlayerInputsPacket packet;
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
+	std::string_view str(reinterpret_cast<const char*>(byteArray.data + offset), length);
 
-	packet.inputs.moveLeft = Deserialize_u8(byteArray, offset);
-	packet.inputs.moveRight = Deserialize_u8(byteArray, offset);
-	packet.inputs.moveUp = Deserialize_u8(byteArray, offset);
-	packet.inputs.moveDown = Deserialize_u8(byteArray, offset);
+	offset += length;
 
-	return packet;
+	return str;
 }
 
-void CreateCollectiblePacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+bool IsMalformed(ByteSpan byteArray, std::size_t offset)
 {
-	Serialize_u32(byteArray, collectibleId);
-	Serialize_f32(byteArray, position.x);
-	Serialize_f32(byteArray, position.y);
-	Serialize_f32(byteArray, scale);
-	Serialize_u8(byteArray, static_cast<std::uint8_t>(type));
+	return offset > byteArray.size;
 }
 
-CreateCollectiblePacket CreateCollectiblePacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+void MarkMalformed(ByteSpan byteArray, std::size_t& offset)
 {
-	CreateCollectiblePacket packet;
-
-	packet.collectibleId = Deserialize_u32(byteArray, offset);
-
-	float posX = Deserialize_f32(byteArray, offset);
-	float posY = Deserialize_f32(byteArray, offset);
-	packet.position = Sel::Vector2f(posX, posY);
-
-	packet.scale = Deserialize_f32(byteArray, offset);
-	packet.type = static_cast<CollectibleType>(Deserialize_u8(byteArray, offset));
-
-	return packet;
+	offset = byteArray.size + 1;
 }
 
-void CollectibleCollectedPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+const char* GetOpcodeName(Opcode opcode)
 {
-}
+	switch (opcode)
+	{
+		case Opcode::C_PlayerName: return "C_PlayerName";
+		case Opcode::C_CreateBrawlerRequest: return "C_CreateBrawlerRequest";
+		case Opcode::C_PlayerInputs: return "C_PlayerInputs";
+		case Opcode::C_PlayerStealRequest: return "C_PlayerStealRequest";
+		case Opcode::C_PlayerReady: return "C_PlayerReady";
+		case Opcode::C_SpectateTarget: return "C_SpectateTarget";
+		case Opcode::S_PlayerSteal: return "S_PlayerSteal";
+		case Opcode::S_PlayerList: return "S_PlayerList";
+		case Opcode::S_CreateBrawler: return "S_CreateBrawler";
+		case Opcode::S_CreateCollectible: return "S_CreateCollectible";
+		case Opcode::S_BrawlerStates: return "S_BrawlerStates";
+		case Opcode::S_DeleteBrawler: return "S_DeleteBrawler";
+		case Opcode::S_UpdateSelfBrawlerId: return "S_UpdateSelfBrawlerId";
+		case Opcode::S_UpdateGameState: return "S_UpdateGameState";
+		case Opcode::S_UpdatePlayerMode: return "S_UpdatePlayerMode";
+		case Opcode::S_CollectibleCollected: return "S_CollectibleCollected";
+		case Opcode::S_UpdateLeaderboard: return "S_UpdateLeaderboard";
+		case Opcode::S_BrawlerDeath: return "S_BrawlerDeath";
+		case Opcode::S_Winner: return "S_Winner";
+		case Opcode::S_GoldenEvent: return "S_GoldenEvent";
+		case Opcode::S_WorldSnapshot: return "S_WorldSnapshot";
+		case Opcode::S_LeaderboardDelta: return "S_LeaderboardDelta";
+	}
 
-CollectibleCollectedPacket CollectibleCollectedPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	return CollectibleCollectedPacket();
+	return "<unknown>";
 }
 
-void UpdateGameStatePacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+void PlayerInputsPacket::PushInputs(const PlayerInputs& newInputs)
 {
-	Serialize_u8(byteArray, newGameState);
-}
+	inputTick = (inputCount > 0) ? inputTick + 1 : 0;
 
-UpdateGameStatePacket UpdateGameStatePacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	UpdateGameStatePacket packet;
-	
-	packet.newGameState = Deserialize_u8(byteArray, offset);
+	std::copy_backward(inputs.begin(), inputs.end() - 1, inputs.end());
+	inputs[0] = newInputs;
 
-	return packet;
+	inputCount = static_cast<std::uint8_t>(std::min<std::size_t>(inputCount + 1, RedundantInputCount));
 }
 
-
-void PlayerReadyPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
+void PlayerInputsPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
-	Serialize_u8(byteArray, newReadyValue);
-}
+	assert(inputCount > 0 && inputCount <= RedundantInputCount);
 
-PlayerReadyPacket PlayerReadyPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	PlayerReadyPacket packet;
-	
-	packet.newReadyValue = Deserialize_u8(byteArray, offset);
+	Serialize_u32(byteArray, inputTick);
+	Serialize_u32(byteArray, lastSnapshotId);
+	Serialize_u8(byteArray, inputCount);
 
-	return packet;
+	std::size_t offset = byteArray.size();
+	byteArray.resize(offset + inputCount * FieldCodec<PlayerInputs>::FixedSize);
+	for (std::size_t i = 0; i < inputCount; ++i)
+		FieldCodec<PlayerInputs>::Write(byteArray, offset, inputs[i]);
 }
 
-void PlayerStealPacketRequest::Serialize(std::vector<std::uint8_t>& byteArray) const
+PlayerInputsPacket PlayerInputsPacket::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
-	Serialize_u32(byteArray, brawlerId);
-}
+	PlayerInputsPacket packet;
+	packet.inputTick = Deserialize_u32(byteArray, offset);
+	packet.lastSnapshotId = Deserialize_u32(byteArray, offset);
 
-PlayerStealPacketRequest PlayerStealPacketRequest::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	PlayerStealPacketRequest packet;
+	// Comes from the client: an invalid count drops the message (see MessageDispatcher)
+	packet.inputCount = Deserialize_u8(byteArray, offset);
+	if (packet.inputCount == 0 || packet.inputCount > RedundantInputCount)
+	{
+		packet.inputCount = 0;
+		MarkMalformed(byteArray, offset);
+		return packet;
+	}
 
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
+	for (std::size_t i = 0; i < packet.inputCount; ++i)
+		FieldCodec<PlayerInputs>::Read(byteArray, offset, packet.inputs[i]);
 
 	return packet;
 }
 
-void WinnerPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u32(byteArray, brawlerNetworkId);
-}
-
-WinnerPacket WinnerPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+void PlayerListPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
-	WinnerPacket packet;
-
-	packet.brawlerNetworkId = Deserialize_u32(byteArray, offset);
-
-	return packet;
-}
+	Serialize_u16(byteArray, players.size());
 
-void UpdateLeaderboardPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u32(byteArray, leaderboard.size());
-	for (auto& data : leaderboard)
+	for (const auto& player : players)
 	{
-		Serialize_u32(byteArray, data.playerId);
-		Serialize_str(byteArray, data.playerName);
-		Serialize_u32(byteArray, data.playerScore);
-		Serialize_u8(byteArray, data.isDead);
+		Serialize_u32(byteArray, player.id);
+		Serialize_str(byteArray, player.name);
+		Serialize_u8(byteArray, player.isDead);
+		Serialize_u8(byteArray, player.hasBrawler);
+		if (player.hasBrawler)
+			Serialize_u32(byteArray, player.brawlerId.value());
 	}
 }
 
-UpdateLeaderboardPacket UpdateLeaderboardPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+PlayerListPacket PlayerListPacket::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
-	UpdateLeaderboardPacket packet;
-
-	packet.leaderboard.resize(Deserialize_u32(byteArray, offset));
+	PlayerListPacket packet;
+	packet.players.resize(Deserialize_u16(byteArray, offset));
 
-	for (auto& data : packet.leaderboard)
+	for (auto& player : packet.players)
 	{
-		data.playerId = Deserialize_u32(byteArray, offset);
-		data.playerName = Deserialize_str(byteArray, offset);
-		data.playerScore = Deserialize_u32(byteArray, offset);
-		data.isDead =Deserialize_u8(byteArray, offset);
+		player.id = Deserialize_u32(byteArray, offset);
+		player.name = Deserialize_strview(byteArray, offset);
+		player.isDead = Deserialize_u8(byteArray, offset);
+		player.hasBrawler = Deserialize_u8(byteArray, offset);
+		if (player.hasBrawler)
+			player.brawlerId = Deserialize_u32(byteArray, offset);
 	}
 
 	return packet;
 }
 
-void UpdatePlayerModePacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u8(byteArray, newPlayerMode);
-}
-
-UpdatePlayerModePacket UpdatePlayerModePacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	UpdatePlayerModePacket packet;
-
-	packet.newPlayerMode = Deserialize_u8(byteArray, offset);
-
-	return packet;
-}
-
-void BrawlerDeathPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u32(byteArray, playerId);
-	Serialize_u32(byteArray, brawlerId);
-	Serialize_f32(byteArray, deathPosition.x);
-	Serialize_f32(byteArray, deathPosition.y);
-	Serialize_i8(byteArray, deathScaleX);
-}
-
-BrawlerDeathPacket BrawlerDeathPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
-{
-	BrawlerDeathPacket packet;
-
-	packet.playerId = Deserialize_u32(byteArray, offset);
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
-
-	float deathX = Deserialize_f32(byteArray, offset);
-	float deathY = Deserialize_f32(byteArray, offset);
-	packet.deathPosition = { deathX, deathY };
-
-	packet.deathScaleX = Deserialize_i8(byteArray, offset);
-
-	return packet;
-}
-
-void PlayerStealPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u32(byteArray, brawlerId);
-}
-
-PlayerStealPacket PlayerStealPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+void LeaderboardDeltaPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
 {
-	PlayerStealPacket packet;
-
-	packet.brawlerId = Deserialize_u32(byteArray, offset);
+	assert(removedPlayers.size() <= std::numeric_limits<std::uint16_t>::max() && entries.size() <= std::numeric_limits<std::uint16_t>::max());
 
-	return packet;
-}
+	Serialize_u16(byteArray, static_cast<std::uint16_t>(removedPlayers.size()));
+	for (std::uint16_t playerId : removedPlayers)
+		Serialize_u16(byteArray, playerId);
 
-void GoldenEventPacket::Serialize(std::vector<std::uint8_t>& byteArray) const
-{
-	Serialize_u8(byteArray, static_cast<std::uint8_t>(eventType));
-
-	switch (eventType)
+	Serialize_u16(byteArray, static_cast<std::uint16_t>(entries.size()));
+	for (const Entry& entry : entries)
 	{
-		case GoldenEventType::Spawn:
-		{
-			break;
-		}
-		case GoldenEventType::Gathered:
-		{
-			Serialize_u32(byteArray, newOwner);
-			break;
-		}
-		case GoldenEventType::Released:
-		{
-			Serialize_u32(byteArray, previousOwner);
-			break;
-		}
-		case GoldenEventType::Steal:
-		{
-			Serialize_u32(byteArray, previousOwner); 
-			Serialize_u32(byteArray, newOwner);
-			break;
-		}
+		Serialize_u16(byteArray, entry.playerId);
+		Serialize_u16(byteArray, entry.rank);
+		Serialize_u8(byteArray, entry.flags);
+		if (entry.flags & Score)
+			Serialize_u32(byteArray, entry.playerScore);
+
+		if (entry.flags & Name)
+			Serialize_str(byteArray, entry.playerName);
 	}
 }
 
-GoldenEventPacket GoldenEventPacket::Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset)
+LeaderboardDeltaPacket LeaderboardDeltaPacket::Deserialize(ByteSpan byteArray, std::size_t& offset)
 {
-	GoldenEventPacket packet;
+	LeaderboardDeltaPacket packet;
+	packet.removedPlayers.resize(Deserialize_u16(byteArray, offset));
+	for (std::uint16_t& playerId : packet.removedPlayers)
+		playerId = Deserialize_u16(byteArray, offset);
 
-	packet.eventType = static_cast<GoldenEventType>(Deserialize_u8(byteArray, offset));
-
-	switch (packet.eventType)
-	{
-	case GoldenEventType::Spawn:
+	packet.entries.resize(Deserialize_u16(byteArray, offset));
+	for (Entry& entry : packet.entries)
 	{
-		break;
-	}
-	case GoldenEventType::Gathered:
-	{
-		packet.newOwner = Deserialize_u32(byteArray, offset);
-		break;
-	}
-	case GoldenEventType::Released:
-	{
-		packet.previousOwner = Deserialize_u32(byteArray, offset);
-		break;
-	}
-	case GoldenEventType::Steal:
-	{
-		packet.previousOwner = Deserialize_u32(byteArray, offset);
-		packet.newOwner = Deserialize_u32(byteArray, offset);
-		break;
-	}
+		entry.playerId = Deserialize_u16(byteArray, offset);
+		entry.rank = Deserialize_u16(byteArray, offset);
+		entry.flags = Deserialize_u8(byteArray, offset);
+		if (entry.flags & Score)
+			entry.playerScore = Deserialize_u32(byteArray, offset);
+
+		if (entry.flags & Name)
+			entry.playerName = Deserialize_strview(byteArray, offset);
 	}
 
 	return packet;
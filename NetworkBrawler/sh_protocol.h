@@ -4,14 +4,351 @@
 #include <Sel/Vector2.hpp>
 #include <enet6/enet.h>
 #include "sh_constants.h"
+#include "sh_packetpool.h"
+#include <array>
+#include <cassert>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include "sh_inputs.h"
 
 // Ce fichier contient tout ce qui va tre li au protocole du jeu,  la faon dont le client et le serveur vont communiquer
 
+// Non-owning view over received bytes (typically event.packet->data): messages are decoded in place from it, without any copy
+struct ByteSpan
+{
+	ByteSpan() = default;
+	ByteSpan(const std::uint8_t* bytes, std::size_t length) : data(bytes), size(length) {}
+	ByteSpan(const std::vector<std::uint8_t>& byteArray) : data(byteArray.data()), size(byteArray.size()) {}
+
+	const std::uint8_t& operator[](std::size_t index) const { return data[index]; }
+
+	const std::uint8_t* data = nullptr;
+	std::size_t size = 0;
+};
+
+void Serialize_color(std::vector<std::uint8_t>& byteArray, const Sel::Color& value);
+void Serialize_f32(std::vector<std::uint8_t>& byteArray, float value);
+void Serialize_f32(std::vector<std::uint8_t>& byteArray, std::size_t offset, float value);
+void Serialize_i8(std::vector<std::uint8_t>& byteArray, std::int8_t value);
+void Serialize_i8(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int8_t value);
+void Serialize_i16(std::vector<std::uint8_t>& byteArray, std::int16_t value);
+void Serialize_i16(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int16_t value);
+void Serialize_i32(std::vector<std::uint8_t>& byteArray, std::int32_t value);
+void Serialize_i32(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int32_t value);
+void Serialize_u8(std::vector<std::uint8_t>& byteArray, std::uint8_t value);
+void Serialize_u8(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint8_t value);
+void Serialize_u16(std::vector<std::uint8_t>& byteArray, std::uint16_t value);
+void Serialize_u16(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint16_t value);
+void Serialize_u32(std::vector<std::uint8_t>& byteArray, std::uint32_t value);
+void Serialize_u32(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint32_t value);
+void Serialize_str(std::vector<std::uint8_t>& byteArray, std::string_view value);
+void Serialize_str(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::string_view value);
+
+Sel::Color Deserialize_color(ByteSpan byteArray, std::size_t& offset);
+float Deserialize_f32(ByteSpan byteArray, std::size_t& offset);
+std::int8_t Deserialize_i8(ByteSpan byteArray, std::size_t& offset);
+std::int16_t Deserialize_i16(ByteSpan byteArray, std::size_t& offset);
+std::int32_t Deserialize_i32(ByteSpan byteArray, std::size_t& offset);
+std::uint8_t Deserialize_u8(ByteSpan byteArray, std::size_t& offset);
+std::uint16_t Deserialize_u16(ByteSpan byteArray, std::size_t& offset);
+std::uint32_t Deserialize_u32(ByteSpan byteArray, std::size_t& offset);
+std::string Deserialize_str(ByteSpan byteArray, std::size_t& offset);
+std::string_view Deserialize_strview(ByteSpan byteArray, std::size_t& offset); //< the view points into byteArray and lives as long as it
+
+// Received bytes can't be trusted: a read which doesn't fit in byteArray returns 0 (or an empty string) without touching it and moves offset past the end,
+// the next reads fail the same way. A message is checked once decoded (the dispatcher drops it), a packet can also mark itself malformed (invalid count...)
+bool IsMalformed(ByteSpan byteArray, std::size_t offset);
+void MarkMalformed(ByteSpan byteArray, std::size_t& offset);
+
+// Packet schemas: a packet deriving from PacketSchema lists its fields once in a constexpr Fields() function,
+// Serialize/Deserialize are generated from that list (fields are encoded in order, without any padding).
+// When every field has a fixed size, the wire size of the packet is known at compile time (see PacketWireSize).
+
+// Encoding of one field type (a missing specialization means the type can't be used in a schema)
+template<typename T, typename = void>
+struct FieldCodec;
+
+template<typename M>
+struct MemberPointerTraits;
+
+template<typename C, typename T>
+struct MemberPointerTraits<T C::*>
+{
+	using Type = T;
+};
+
+template<typename T, typename = void>
+struct HasFields : std::false_type {};
+
+template<typename T>
+struct HasFields<T, std::void_t<decltype(T::Fields())>> : std::true_type {};
+
+// Encodes all the fields listed by T::Fields()
+template<typename T>
+struct FieldsCodec
+{
+	static constexpr auto fields = T::Fields();
+
+	static constexpr bool IsFixedSize = std::apply([](auto... members) { return (FieldCodec<typename MemberPointerTraits<decltype(members)>::Type>::IsFixedSize && ... && true); }, fields);
+	static constexpr std::size_t FixedSize = std::apply([](auto... members) { return (std::size_t(0) + ... + FieldCodec<typename MemberPointerTraits<decltype(members)>::Type>::FixedSize); }, fields);
+
+	static std::size_t Size(const T& value)
+	{
+		if constexpr (IsFixedSize)
+			return FixedSize;
+		else
+			return std::apply([&](auto... members) { return (std::size_t(0) + ... + FieldCodec<typename MemberPointerTraits<decltype(members)>::Type>::Size(value.*members)); }, fields);
+	}
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, const T& value)
+	{
+		std::apply([&](auto... members) { (FieldCodec<typename MemberPointerTraits<decltype(members)>::Type>::Write(byteArray, offset, value.*members), ...); }, fields);
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, T& value)
+	{
+		std::apply([&](auto... members) { (FieldCodec<typename MemberPointerTraits<decltype(members)>::Type>::Read(byteArray, offset, value.*members), ...); }, fields);
+	}
+};
+
+template<typename T, std::size_t ByteCount, void(*WriteFunc)(std::vector<std::uint8_t>&, std::size_t, T), T(*ReadFunc)(ByteSpan, std::size_t&)>
+struct FixedFieldCodec
+{
+	static constexpr bool IsFixedSize = true;
+	static constexpr std::size_t FixedSize = ByteCount;
+
+	static std::size_t Size(T /*value*/) { return FixedSize; }
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, T value)
+	{
+		WriteFunc(byteArray, offset, value);
+		offset += FixedSize;
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, T& value)
+	{
+		value = ReadFunc(byteArray, offset);
+	}
+};
+
+template<> struct FieldCodec<std::uint8_t> : FixedFieldCodec<std::uint8_t, 1, &Serialize_u8, &Deserialize_u8> {};
+template<> struct FieldCodec<std::uint16_t> : FixedFieldCodec<std::uint16_t, 2, &Serialize_u16, &Deserialize_u16> {};
+template<> struct FieldCodec<std::uint32_t> : FixedFieldCodec<std::uint32_t, 4, &Serialize_u32, &Deserialize_u32> {};
+template<> struct FieldCodec<std::int8_t> : FixedFieldCodec<std::int8_t, 1, &Serialize_i8, &Deserialize_i8> {};
+template<> struct FieldCodec<std::int16_t> : FixedFieldCodec<std::int16_t, 2, &Serialize_i16, &Deserialize_i16> {};
+template<> struct FieldCodec<std::int32_t> : FixedFieldCodec<std::int32_t, 4, &Serialize_i32, &Deserialize_i32> {};
+template<> struct FieldCodec<float> : FixedFieldCodec<float, 4, &Serialize_f32, &Deserialize_f32> {};
+
+template<>
+struct FieldCodec<bool>
+{
+	static constexpr bool IsFixedSize = true;
+	static constexpr std::size_t FixedSize = 1;
+
+	static std::size_t Size(bool /*value*/) { return FixedSize; }
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, bool value) { FieldCodec<std::uint8_t>::Write(byteArray, offset, (value) ? 1 : 0); }
+	static void Read(ByteSpan byteArray, std::size_t& offset, bool& value) { value = Deserialize_u8(byteArray, offset) != 0; }
+};
+
+// Enums are sent as their underlying type
+template<typename T>
+struct FieldCodec<T, std::enable_if_t<std::is_enum_v<T>>>
+{
+	using Underlying = std::underlying_type_t<T>;
+
+	static constexpr bool IsFixedSize = true;
+	static constexpr std::size_t FixedSize = FieldCodec<Underlying>::FixedSize;
+
+	static std::size_t Size(T /*value*/) { return FixedSize; }
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, T value) { FieldCodec<Underlying>::Write(byteArray, offset, static_cast<Underlying>(value)); }
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, T& value)
+	{
+		Underlying v;
+		FieldCodec<Underlying>::Read(byteArray, offset, v);
+		value = static_cast<T>(v);
+	}
+};
+
+template<>
+struct FieldCodec<Sel::Vector2f>
+{
+	static constexpr bool IsFixedSize = true;
+	static constexpr std::size_t FixedSize = 2 * FieldCodec<float>::FixedSize;
+
+	static std::size_t Size(const Sel::Vector2f& /*value*/) { return FixedSize; }
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, const Sel::Vector2f& value)
+	{
+		FieldCodec<float>::Write(byteArray, offset, value.x);
+		FieldCodec<float>::Write(byteArray, offset, value.y);
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, Sel::Vector2f& value)
+	{
+		FieldCodec<float>::Read(byteArray, offset, value.x);
+		FieldCodec<float>::Read(byteArray, offset, value.y);
+	}
+};
+
+// Inputs are bit-packed into a single byte
+template<>
+struct FieldCodec<PlayerInputs>
+{
+	enum Bits : std::uint8_t
+	{
+		MoveLeft = 1 << 0,
+		MoveRight = 1 << 1,
+		MoveUp = 1 << 2,
+		MoveDown = 1 << 3,
+		Dash = 1 << 4
+	};
+
+	static constexpr bool IsFixedSize = true;
+	static constexpr std::size_t FixedSize = FieldCodec<std::uint8_t>::FixedSize;
+
+	static std::size_t Size(const PlayerInputs& /*value*/) { return FixedSize; }
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, const PlayerInputs& value)
+	{
+		std::uint8_t bits = 0;
+		if (value.moveLeft)  bits |= MoveLeft;
+		if (value.moveRight) bits |= MoveRight;
+		if (value.moveUp)    bits |= MoveUp;
+		if (value.moveDown)  bits |= MoveDown;
+		if (value.dash)      bits |= Dash;
+
+		FieldCodec<std::uint8_t>::Write(byteArray, offset, bits);
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, PlayerInputs& value)
+	{
+		std::uint8_t bits;
+		FieldCodec<std::uint8_t>::Read(byteArray, offset, bits);
+
+		value.moveLeft = (bits & MoveLeft) != 0;
+		value.moveRight = (bits & MoveRight) != 0;
+		value.moveUp = (bits & MoveUp) != 0;
+		value.moveDown = (bits & MoveDown) != 0;
+		value.dash = (bits & Dash) != 0;
+	}
+};
+
+// Strings are sent as a u32 length followed by the characters (a std::string_view points into the received packet)
+template<typename T>
+struct FieldCodec<T, std::enable_if_t<std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>>>
+{
+	static constexpr bool IsFixedSize = false;
+	static constexpr std::size_t FixedSize = 0;
+
+	static std::size_t Size(std::string_view value) { return sizeof(std::uint32_t) + value.size(); }
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, std::string_view value)
+	{
+		Serialize_str(byteArray, offset, value);
+		offset += Size(value);
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, T& value)
+	{
+		value = T(Deserialize_strview(byteArray, offset));
+	}
+};
+
+// Arrays are sent as a u32 count followed by the elements
+template<typename T>
+struct FieldCodec<std::vector<T>>
+{
+	static constexpr bool IsFixedSize = false;
+	static constexpr std::size_t FixedSize = 0;
+
+	static std::size_t Size(const std::vector<T>& value)
+	{
+		if constexpr (FieldCodec<T>::IsFixedSize)
+			return sizeof(std::uint32_t) + value.size() * FieldCodec<T>::FixedSize;
+		else
+		{
+			std::size_t size = sizeof(std::uint32_t);
+			for (const T& element : value)
+				size += FieldCodec<T>::Size(element);
+
+			return size;
+		}
+	}
+
+	static void Write(std::vector<std::uint8_t>& byteArray, std::size_t& offset, const std::vector<T>& value)
+	{
+		FieldCodec<std::uint32_t>::Write(byteArray, offset, static_cast<std::uint32_t>(value.size()));
+		for (const T& element : value)
+			FieldCodec<T>::Write(byteArray, offset, element);
+	}
+
+	static void Read(ByteSpan byteArray, std::size_t& offset, std::vector<T>& value)
+	{
+		// Every element takes at least a byte, a larger count can only be garbage (and mustn't make us allocate)
+		std::uint32_t count = Deserialize_u32(byteArray, offset);
+		if (IsMalformed(byteArray, offset) || count > byteArray.size - offset)
+		{
+			MarkMalformed(byteArray, offset);
+			return;
+		}
+
+		value.resize(count);
+		for (T& element : value)
+			FieldCodec<T>::Read(byteArray, offset, element);
+	}
+};
+
+// Structures with their own Fields() can be nested
+template<typename T>
+struct FieldCodec<T, std::enable_if_t<HasFields<T>::value>> : FieldsCodec<T> {};
+
+// Wire size of a fixed-size schema (opcode excluded)
+template<typename T>
+constexpr std::size_t PacketWireSize()
+{
+	static_assert(FieldsCodec<T>::IsFixedSize, "packet has variable-size fields");
+	return FieldsCodec<T>::FixedSize;
+}
+
+template<typename T>
+struct PacketSchema
+{
+	void Serialize(std::vector<std::uint8_t>& byteArray) const
+	{
+		const T& packet = static_cast<const T&>(*this);
+
+		// A single resize (the exact size is a constant for fixed-size packets), the fields are then written in place
+		std::size_t offset = byteArray.size();
+		byteArray.resize(offset + FieldsCodec<T>::Size(packet));
+
+		FieldsCodec<T>::Write(byteArray, offset, packet);
+		assert(offset == byteArray.size());
+	}
+
+	static T Deserialize(ByteSpan byteArray, std::size_t& offset)
+	{
+		T packet;
+		if constexpr (FieldsCodec<T>::IsFixedSize)
+		{
+			if (offset > byteArray.size || byteArray.size - offset < FieldsCodec<T>::FixedSize)
+			{
+				MarkMalformed(byteArray, offset);
+				return packet;
+			}
+		}
+
+		FieldsCodec<T>::Read(byteArray, offset, packet);
+
+		return packet;
+	}
+};
+
 enum class Opcode : std::uint8_t
 {
 	C_PlayerName,
@@ -25,6 +362,7 @@ enum class Opcode : std::uint8_t
 	C_PlayerInputs,
 	C_PlayerStealRequest,
 	C_PlayerReady,
+	C_SpectateTarget,
 	S_PlayerSteal,
 	S_PlayerList,
 	S_CreateBrawler,
@@ -40,8 +378,17 @@ enum class Opcode : std::uint8_t
 	S_Winner,
 
 	S_GoldenEvent,
+	S_WorldSnapshot,
+	S_LeaderboardDelta,
 };
 
+constexpr std::size_t OpcodeCount = static_cast<std::size_t>(Opcode::S_LeaderboardDelta) + 1;
+
+const char* GetOpcodeName(Opcode opcode);
+
+// Snapshot ids start at 1, 0 means "no snapshot" (full snapshot, nothing received yet...)
+constexpr std::uint32_t InvalidSnapshotId = 0;
+
 struct BrawlerFlag
 {
 	std::uint32_t playerId;
@@ -55,6 +402,9 @@ struct CollectibleFlag
 
 struct GoldenCarrotFlag {};
 
+// Server: a collectible waiting in the CollectiblePool, parked out of the world
+struct InactiveFlag {};
+
 struct DeadFlag
 {
 
@@ -80,73 +430,78 @@ struct BrawlerData
 	Sel::Vector2f linearVelocity;
 
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static BrawlerData Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static BrawlerData Deserialize(ByteSpan byteArray, std::size_t& offset);
 };
 
 
 // Un joueur souhaite crer un Brawler
-struct CreateBrawlerResquest
+struct CreateBrawlerResquest : PacketSchema<CreateBrawlerResquest>
 {
 	static constexpr Opcode opcode = Opcode::C_CreateBrawlerRequest;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static CreateBrawlerResquest Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(); }
 };
 
 // Un joueur souhaite renseigner son nom
-struct PlayerNamePacket
+struct PlayerNamePacket : PacketSchema<PlayerNamePacket>
 {
 	static constexpr Opcode opcode = Opcode::C_PlayerName;
 
 	std::string name;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerNamePacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&PlayerNamePacket::name); }
 };
 
-struct PlayerReadyPacket
+struct PlayerReadyPacket : PacketSchema<PlayerReadyPacket>
 {
 	static constexpr Opcode opcode = Opcode::C_PlayerReady;
 
 	bool newReadyValue;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerReadyPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&PlayerReadyPacket::newReadyValue); }
 };
 
-struct PlayerStealPacketRequest
+struct PlayerStealPacketRequest : PacketSchema<PlayerStealPacketRequest>
 {
 	static constexpr Opcode opcode = Opcode::C_PlayerStealRequest;
 
 	std::uint32_t brawlerId;
+	std::uint32_t viewSnapshotId; //< last snapshot the client applied, what it saw when stealing
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerStealPacketRequest Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&PlayerStealPacketRequest::brawlerId, &PlayerStealPacketRequest::viewSnapshotId); }
 };
 
-struct UpdateGameStatePacket
+// A player who isn't playing tells which brawler its camera follows: the server replicates what's around it
+struct SpectateTargetPacket : PacketSchema<SpectateTargetPacket>
+{
+	static constexpr Opcode opcode = Opcode::C_SpectateTarget;
+
+	std::uint32_t brawlerId;
+
+	static constexpr auto Fields() { return std::make_tuple(&SpectateTargetPacket::brawlerId); }
+};
+
+struct UpdateGameStatePacket : PacketSchema<UpdateGameStatePacket>
 {
 	static constexpr Opcode opcode = Opcode::S_UpdateGameState;
 
 	std::uint8_t newGameState;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static UpdateGameStatePacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&UpdateGameStatePacket::newGameState); }
 };
 
 // Le serveur indique un changement de mode de jeu au client (playing, dead, spectating)
-struct UpdatePlayerModePacket
+struct UpdatePlayerModePacket : PacketSchema<UpdatePlayerModePacket>
 {
 	static constexpr Opcode opcode = Opcode::S_UpdatePlayerMode;
 
 	std::uint8_t newPlayerMode;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static UpdatePlayerModePacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&UpdatePlayerModePacket::newPlayerMode); }
 };
 
 // Le serveur indique la mort d'un brawler
-struct BrawlerDeathPacket
+struct BrawlerDeathPacket : PacketSchema<BrawlerDeathPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_BrawlerDeath;
 
@@ -155,12 +510,11 @@ struct BrawlerDeathPacket
 	Sel::Vector2f deathPosition;
 	std::int8_t deathScaleX;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static BrawlerDeathPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&BrawlerDeathPacket::playerId, &BrawlerDeathPacket::brawlerId, &BrawlerDeathPacket::deathPosition, &BrawlerDeathPacket::deathScaleX); }
 };
 
 // Le serveur indique la cration d'un brawler
-struct CreateBrawlerPacket
+struct CreateBrawlerPacket : PacketSchema<CreateBrawlerPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_CreateBrawler;
 	
@@ -170,25 +524,23 @@ struct CreateBrawlerPacket
 	Sel::Vector2f position;
 	Sel::Vector2f linearVelocity;
 	float scale;
-	std::string brawlerName;
+	std::string_view brawlerName;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static CreateBrawlerPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&CreateBrawlerPacket::playerId, &CreateBrawlerPacket::brawlerId, &CreateBrawlerPacket::skinId, &CreateBrawlerPacket::position, &CreateBrawlerPacket::linearVelocity, &CreateBrawlerPacket::scale, &CreateBrawlerPacket::brawlerName); }
 };
 
 // Le serveur notifie d'un winner
-struct WinnerPacket
+struct WinnerPacket : PacketSchema<WinnerPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_Winner;
 
 	std::uint32_t brawlerNetworkId;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static WinnerPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&WinnerPacket::brawlerNetworkId); }
 };
 
 // Le serveur indique la cration d'un collectible
-struct CreateCollectiblePacket
+struct CreateCollectiblePacket : PacketSchema<CreateCollectiblePacket>
 {
 	static constexpr Opcode opcode = Opcode::S_CreateCollectible;
 
@@ -198,21 +550,48 @@ struct CreateCollectiblePacket
 	float scale;
 	CollectibleType type;
 
+	static constexpr auto Fields() { return std::make_tuple(&CreateCollectiblePacket::collectibleId, &CreateCollectiblePacket::position, &CreateCollectiblePacket::scale, &CreateCollectiblePacket::type); }
+};
+
+// Every entity of the world sent at once to a player who just joined, instead of one reliable packet per entity
+// The body is LZ4-compressed when it's big enough for it to be worth it
+struct WorldSnapshotPacket
+{
+	static constexpr Opcode opcode = Opcode::S_WorldSnapshot;
+
+	static constexpr std::size_t CompressionThreshold = 256; //< smaller bodies are sent as is
+	static constexpr std::size_t MaxBodySize = 1024 * 1024; //< a received body bigger than this is rejected
+
+	std::vector<CreateBrawlerPacket> brawlers;
+	std::vector<CreateCollectiblePacket> collectibles;
+
+	// Decompressed body once received, the brawler names point into it
+	std::vector<std::uint8_t> decompressedBytes;
+
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static CreateCollectiblePacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static WorldSnapshotPacket Deserialize(ByteSpan byteArray, std::size_t& offset);
 };
 
 
 // Un joueur envois ses inputs au serveur
+// Sent every client tick with the inputs of the last ticks, newest first: each input is sent RedundantInputCount times,
+// so the server gets it back from a later packet when one is lost (the server knows whose inputs they are from the peer)
 struct PlayerInputsPacket
 {
 	static constexpr Opcode opcode = Opcode::C_PlayerInputs;
 
-	std::uint32_t brawlerId;
-	PlayerInputs inputs;
+	static constexpr std::size_t RedundantInputCount = 4; //< 3 packets in a row can be lost at 30Hz
+
+	std::uint32_t inputTick = 0; //< client tick inputs[0] was sampled at (one per client tick), inputs[i] is from inputTick - i
+	std::uint32_t lastSnapshotId = InvalidSnapshotId; //< acknowledges the last BrawlerStatesPacket the client applied
+	std::array<PlayerInputs, RedundantInputCount> inputs;
+	std::uint8_t inputCount = 0;
+
+	// Adds the inputs of the next tick, the oldest ones are dropped (the sender keeps the packet from one tick to the next)
+	void PushInputs(const PlayerInputs& newInputs);
 
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerInputsPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static PlayerInputsPacket Deserialize(ByteSpan byteArray, std::size_t& offset);
 };
 
 // Le serveur envoie  un client la liste de tous les joueurs connects
@@ -223,7 +602,7 @@ struct PlayerListPacket
 	struct Player
 	{
 		std::uint32_t id;
-		std::string name;
+		std::string_view name;
 		bool isDead;
 		bool hasBrawler;
 		std::optional<std::uint32_t> brawlerId;
@@ -232,56 +611,85 @@ struct PlayerListPacket
 	std::vector<Player> players;
 
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerListPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static PlayerListPacket Deserialize(ByteSpan byteArray, std::size_t& offset);
 };
 
 // Le serveur notifie le player du networkId de son propre brawler
-struct UpdateSelfBrawlerId
+struct UpdateSelfBrawlerId : PacketSchema<UpdateSelfBrawlerId>
 {
 	static constexpr Opcode opcode = Opcode::S_UpdateSelfBrawlerId;
 
 	std::uint32_t id;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static UpdateSelfBrawlerId Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&UpdateSelfBrawlerId::id); }
 };
 
 // Le serveur indique au joueur qu'il a recup un collectible
-struct CollectibleCollectedPacket
+struct CollectibleCollectedPacket : PacketSchema<CollectibleCollectedPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_CollectibleCollected;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static CollectibleCollectedPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(); }
 };
 
-struct PlayerStealPacket
+struct PlayerStealPacket : PacketSchema<PlayerStealPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_PlayerSteal;
 
 	std::uint32_t brawlerId;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static PlayerStealPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&PlayerStealPacket::brawlerId); }
 };
 
 // Le serveur indique aux joueurs un changement de leaderboard
-struct UpdateLeaderboardPacket
+struct UpdateLeaderboardPacket : PacketSchema<UpdateLeaderboardPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_UpdateLeaderboard;
 
 	struct Data
 	{
 		std::uint32_t playerId;
-		std::string playerName;
+		std::string_view playerName;
 		std::uint32_t playerScore;
 		bool isDead;
+
+		static constexpr auto Fields() { return std::make_tuple(&Data::playerId, &Data::playerName, &Data::playerScore, &Data::isDead); }
 	};
 
 	std::vector<Data> leaderboard; // first to last
 
+	static constexpr auto Fields() { return std::make_tuple(&UpdateLeaderboardPacket::leaderboard); }
+};
+
+// What changed in the leaderboard since the previous update (full or delta), sent at most once per tick.
+// To apply it, the removed players and the listed ones are taken out, then the listed ones are inserted at their rank, by increasing rank:
+// the players which aren't listed kept their relative order.
+struct LeaderboardDeltaPacket
+{
+	static constexpr Opcode opcode = Opcode::S_LeaderboardDelta;
+
+	enum Flags : std::uint8_t
+	{
+		Score = 1 << 0, //< playerScore is sent
+		Name = 1 << 1,  //< playerName is sent (new line or renamed player)
+		IsDead = 1 << 2
+	};
+
+	struct Entry
+	{
+		std::uint16_t playerId;
+		std::uint16_t rank; //< 0 is the first
+		std::uint8_t flags = 0;
+		std::uint32_t playerScore = 0;
+		std::string_view playerName;
+	};
+
+	// Player ids (slot indices), ranks and counts are 16 bits: a room has at most MaxPlayers players
+	std::vector<std::uint16_t> removedPlayers;
+	std::vector<Entry> entries; //< by increasing rank
+
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static UpdateLeaderboardPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static LeaderboardDeltaPacket Deserialize(ByteSpan byteArray, std::size_t& offset);
 };
 
 // Le serveur envoie les donnes sur tous les brawlers
@@ -289,31 +697,47 @@ struct BrawlerStatesPacket
 {
 	static constexpr Opcode opcode = Opcode::S_BrawlerStates;
 
+	enum ChangedFields : std::uint8_t
+	{
+		Removed = 0, //< in a delta: the entity was in the baseline but isn't anymore (an unchanged state isn't sent at all)
+		Position = 1 << 0,
+		LinearVelocity = 1 << 1,
+
+		AllFields = Position | LinearVelocity
+	};
+
 	struct States
 	{
 		std::uint32_t brawlerId;
+		std::uint8_t changedFields = AllFields; //< only these fields are sent, the others are unchanged since the baseline
 		Sel::Vector2f position;
 		Sel::Vector2f linearVelocity;
 	};
 
+	// When baselineId is set, brawlers only contains what changed since that snapshot (a missing brawler didn't change at all, a Removed one is gone)
+	std::uint32_t snapshotId = InvalidSnapshotId;
+	std::uint32_t baselineId = InvalidSnapshotId;
 	std::vector<States> brawlers;
 
 	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static BrawlerStatesPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static BrawlerStatesPacket Deserialize(ByteSpan byteArray, std::size_t& offset);
+
+	// Encoded size of a state following the state of previousId, and of the packet without its states (opcode included)
+	static std::size_t GetStateBitCount(const States& state, std::uint32_t previousId);
+	static constexpr std::size_t HeaderSize = 1 + 3 * sizeof(std::uint32_t);
 };
 
 // Le serveur annonce qu'un brawler cesse d'exister
-struct DeleteEntityPacket
+struct DeleteEntityPacket : PacketSchema<DeleteEntityPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_DeleteBrawler;
 
 	std::uint32_t brawlerId;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static DeleteEntityPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&DeleteEntityPacket::brawlerId); }
 };
 
-struct GoldenEventPacket
+struct GoldenEventPacket : PacketSchema<GoldenEventPacket>
 {
 	static constexpr Opcode opcode = Opcode::S_GoldenEvent;
 
@@ -326,52 +750,78 @@ struct GoldenEventPacket
 		Steal,
 	};
 
+	// Both owners are always sent (0 when the event doesn't use them), the packet has a fixed layout
 	GoldenEventType eventType = GoldenEventType::None;
 	std::uint32_t previousOwner = 0;
 	std::uint32_t newOwner = 0;
 
-	void Serialize(std::vector<std::uint8_t>& byteArray) const;
-	static GoldenEventPacket Deserialize(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+	static constexpr auto Fields() { return std::make_tuple(&GoldenEventPacket::eventType, &GoldenEventPacket::previousOwner, &GoldenEventPacket::newOwner); }
 };
 
+static_assert(PacketWireSize<GoldenEventPacket>() == 9);
 
-void Serialize_color(std::vector<std::uint8_t>& byteArray, const Sel::Color& value);
-void Serialize_f32(std::vector<std::uint8_t>& byteArray, float value);
-void Serialize_f32(std::vector<std::uint8_t>& byteArray, std::size_t offset, float value);
-void Serialize_i8(std::vector<std::uint8_t>& byteArray, std::int8_t value);
-void Serialize_i8(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int8_t value);
-void Serialize_i16(std::vector<std::uint8_t>& byteArray, std::int16_t value);
-void Serialize_i16(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int16_t value);
-void Serialize_i32(std::vector<std::uint8_t>& byteArray, std::int32_t value);
-void Serialize_i32(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::int32_t value);
-void Serialize_u8(std::vector<std::uint8_t>& byteArray, std::uint8_t value);
-void Serialize_u8(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint8_t value);
-void Serialize_u16(std::vector<std::uint8_t>& byteArray, std::uint16_t value);
-void Serialize_u16(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint16_t value);
-void Serialize_u32(std::vector<std::uint8_t>& byteArray, std::uint32_t value);
-void Serialize_u32(std::vector<std::uint8_t>& byteArray, std::size_t offset, std::uint32_t value);
-void Serialize_str(std::vector<std::uint8_t>& byteArray, const std::string& value);
-void Serialize_str(std::vector<std::uint8_t>& byteArray, std::size_t offset, const std::string& value);
-
-Sel::Color Deserialize_color(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-float Deserialize_f32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::int8_t Deserialize_i8(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::int16_t Deserialize_i16(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::int32_t Deserialize_i32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::uint8_t Deserialize_u8(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::uint16_t Deserialize_u16(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::uint32_t Deserialize_u32(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
-std::string Deserialize_str(const std::vector<std::uint8_t>& byteArray, std::size_t& offset);
+
+// Writes values bit by bit at the end of byteArray (most significant bit first), Flush() pads the last byte and must be called once done
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<std::uint8_t>& byteArray);
+	BitWriter(const BitWriter&) = delete;
+	BitWriter(BitWriter&&) = delete;
+	~BitWriter() = default;
+
+	void Flush();
+
+	void Write(std::uint32_t value, unsigned int bitCount);
+	void WriteBool(bool value);
+	void WriteFloat(float value);
+
+	BitWriter& operator=(const BitWriter&) = delete;
+	BitWriter& operator=(BitWriter&&) = delete;
+
+private:
+	std::vector<std::uint8_t>& m_byteArray;
+	std::uint64_t m_scratch;
+	unsigned int m_scratchBits;
+};
+
+// Reads what a BitWriter wrote, offset is moved past every byte consumed (including the padding of the last one)
+class BitReader
+{
+public:
+	BitReader(ByteSpan byteArray, std::size_t& offset);
+	BitReader(const BitReader&) = delete;
+	BitReader(BitReader&&) = delete;
+	~BitReader() = default;
+
+	std::uint32_t Read(unsigned int bitCount);
+	bool ReadBool();
+	float ReadFloat();
+
+	BitReader& operator=(const BitReader&) = delete;
+	BitReader& operator=(BitReader&&) = delete;
+
+private:
+	ByteSpan m_byteArray;
+	std::size_t& m_offset;
+	std::uint64_t m_scratch;
+	unsigned int m_scratchBits;
+};
+
+// Maps value from [min, max] to an integer on bitCount bits (value is clamped) and back
+std::uint32_t Quantize_f32(float value, float min, float max, unsigned int bitCount);
+float Dequantize_f32(std::uint32_t value, float min, float max, unsigned int bitCount);
 
 // Petite fonction d'aide pour construire un packet ENet  partir d'une de nos structures de packet, insre automatiquement l'opcode au dbut des donnes
 template<typename T> ENetPacket* build_packet(const T& packet, enet_uint32 flags)
 {
-	// On srialise l'opcode puis le contenu du packet dans un std::vector<std::uint8_t>
-	std::vector<std::uint8_t> byteArray;
+	// Opcode and packet content are serialized into a recycled buffer (its capacity survives from one packet to the next)
+	PacketPool& pool = PacketPool::Instance();
+	std::unique_ptr<PacketPool::Buffer> buffer = pool.Acquire();
 
-	Serialize_u8(byteArray, static_cast<std::uint8_t>(T::opcode));
-	packet.Serialize(byteArray);
+	Serialize_u8(buffer->bytes, static_cast<std::uint8_t>(T::opcode));
+	packet.Serialize(buffer->bytes);
 
-	// On copie le contenu de ce vector dans un packet enet, et on l'envoie au peer
-	return enet_packet_create(byteArray.data(), byteArray.size(), flags);
+	// The buffer becomes the ENet packet memory as is (no copy), it goes back to the pool when the packet is destroyed
+	return pool.CreatePacket(std::move(buffer), flags);
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "sh_snapshot.h"
+#include <cassert>
+
+namespace
+{
+	bool HasChanged(const Sel::Vector2f& previous, const Sel::Vector2f& current)
+	{
+		return previous.x != current.x || previous.y != current.y;
+	}
+}
+
+void SnapshotHistory::Clear()
+{
+	for (Entry& entry : m_entries)
+	{
+		entry.snapshotId = InvalidSnapshotId;
+		entry.states.clear();
+	}
+}
+
+const SnapshotStates* SnapshotHistory::Find(std::uint32_t snapshotId) const
+{
+	if (snapshotId == InvalidSnapshotId)
+		return nullptr;
+
+	const Entry& entry = m_entries[snapshotId % Capacity];
+	if (entry.snapshotId != snapshotId)
+		return nullptr; //< overwritten by a more recent snapshot
+
+	return &entry.states;
+}
+
+SnapshotStates& SnapshotHistory::Store(std::uint32_t snapshotId)
+{
+	assert(snapshotId != InvalidSnapshotId);
+
+	// clear() keeps the capacity, the slots stop allocating once every one of them has been used
+	Entry& entry = m_entries[snapshotId % Capacity];
+	entry.snapshotId = snapshotId;
+	entry.states.clear();
+
+	return entry.states;
+}
+
+bool HasStateChanged(const BrawlerStatesPacket::States& previous, const BrawlerStatesPacket::States& current)
+{
+	return HasChanged(previous.position, current.position) || HasChanged(previous.linearVelocity, current.linearVelocity);
+}
+
+void BuildSnapshotDelta(const SnapshotStates* baseline, const SnapshotStates& current, BrawlerStatesPacket& packet)
+{
+	packet.brawlers.clear();
+
+	if (!baseline)
+	{
+		packet.brawlers.insert(packet.brawlers.end(), current.begin(), current.end());
+		for (auto& state : packet.brawlers)
+			state.changedFields = BrawlerStatesPacket::AllFields;
+
+		return;
+	}
+
+	// Baseline states missing from current were removed (deleted entity, out of the area of interest...), the client drops them too
+	auto addRemoved = [&](std::uint32_t brawlerId)
+	{
+		auto& removed = packet.brawlers.emplace_back();
+		removed.brawlerId = brawlerId;
+		removed.changedFields = BrawlerStatesPacket::Removed;
+	};
+
+	// Both arrays are sorted by id, walk them side by side
+	auto baselineIt = baseline->begin();
+	for (const auto& state : current)
+	{
+		while (baselineIt != baseline->end() && baselineIt->brawlerId < state.brawlerId)
+			addRemoved((baselineIt++)->brawlerId);
+
+		std::uint8_t changedFields = BrawlerStatesPacket::AllFields;
+		if (baselineIt != baseline->end() && baselineIt->brawlerId == state.brawlerId)
+		{
+			changedFields = 0;
+			if (HasChanged(baselineIt->position, state.position))
+				changedFields |= BrawlerStatesPacket::Position;
+
+			if (HasChanged(baselineIt->linearVelocity, state.linearVelocity))
+				changedFields |= BrawlerStatesPacket::LinearVelocity;
+
+			++baselineIt;
+		}
+
+		if (changedFields == 0)
+			continue;
+
+		auto& delta = packet.brawlers.emplace_back(state);
+		delta.changedFields = changedFields;
+	}
+
+	for (; baselineIt != baseline->end(); ++baselineIt)
+		addRemoved(baselineIt->brawlerId);
+}
+
+void ApplySnapshotDelta(const SnapshotStates* baseline, const BrawlerStatesPacket& packet, SnapshotStates& states)
+{
+	states.clear();
+
+	if (!baseline)
+	{
+		states.insert(states.end(), packet.brawlers.begin(), packet.brawlers.end());
+		return;
+	}
+
+	// Merge the baseline with the delta (both sorted by id)
+	auto baselineIt = baseline->begin();
+	for (const auto& delta : packet.brawlers)
+	{
+		while (baselineIt != baseline->end() && baselineIt->brawlerId < delta.brawlerId)
+			states.push_back(*baselineIt++);
+
+		if (delta.changedFields == BrawlerStatesPacket::Removed)
+		{
+			if (baselineIt != baseline->end() && baselineIt->brawlerId == delta.brawlerId)
+				++baselineIt;
+
+			continue;
+		}
+
+		auto& state = states.emplace_back();
+		if (baselineIt != baseline->end() && baselineIt->brawlerId == delta.brawlerId)
+			state = *baselineIt++;
+
+		state.brawlerId = delta.brawlerId;
+		if (delta.changedFields & BrawlerStatesPacket::Position)
+			state.position = delta.position;
+
+		if (delta.changedFields & BrawlerStatesPacket::LinearVelocity)
+			state.linearVelocity = delta.linearVelocity;
+	}
+
+	states.insert(states.end(), baselineIt, baseline->end());
+}
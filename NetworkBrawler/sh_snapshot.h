@@ -0,0 +1,45 @@
+#pragma once
+
+#include "sh_protocol.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Full state of the replicated entities at a given snapshot, sorted by brawlerId
+using SnapshotStates = std::vector<BrawlerStatesPacket::States>;
+
+// Keeps the last snapshots (indexed by snapshot id) so that BrawlerStatesPacket can be encoded/decoded against a baseline.
+// The server keeps one per client (what it sent), the client keeps one (what it rebuilt).
+class SnapshotHistory
+{
+public:
+	// A baseline older than this can't be used anymore, the server falls back to a full snapshot
+	static constexpr std::size_t Capacity = 32;
+
+	SnapshotHistory() = default;
+
+	void Clear();
+
+	const SnapshotStates* Find(std::uint32_t snapshotId) const;
+
+	SnapshotStates& Store(std::uint32_t snapshotId);
+
+private:
+	struct Entry
+	{
+		std::uint32_t snapshotId = InvalidSnapshotId;
+		SnapshotStates states;
+	};
+
+	std::array<Entry, Capacity> m_entries;
+};
+
+// Does current differ from previous (position or velocity)
+bool HasStateChanged(const BrawlerStatesPacket::States& previous, const BrawlerStatesPacket::States& current);
+
+// Fills packet.brawlers with what changed between baseline and current (everything if baseline is null), including the states which aren't in current anymore
+void BuildSnapshotDelta(const SnapshotStates* baseline, const SnapshotStates& current, BrawlerStatesPacket& packet);
+
+// Rebuilds the full states of a snapshot from its baseline (null for a full snapshot) and the received packet
+void ApplySnapshotDelta(const SnapshotStates* baseline, const BrawlerStatesPacket& packet, SnapshotStates& states);
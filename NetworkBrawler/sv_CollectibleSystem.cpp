@@ -2,8 +2,9 @@
 #include "sh_protocol.h"
 #include "entt/entt.hpp"
 #include <Sel/Transform.hpp>
-#include <iostream>
 #include "sv_networkedcomponent.h"
+#include "sv_broadcast.h"
+#include "sv_logger.h"
 #include "sv_gamedata.h"
 
 CollectibleSystem::CollectibleSystem(entt::registry& registry, GameData& gameData) :
@@ -16,84 +17,76 @@ CollectibleSystem::CollectibleSystem(entt::registry& registry, GameData& gameDat
 bool CollectibleSystem::Update(GameData& gameData)
 {
     bool collectionOccured = false;
-	auto collectibleView = m_registry.view<Sel::Transform, CollectibleFlag, NetworkedComponent>();
-	auto brawlerView = m_registry.view<Sel::Transform, BrawlerFlag, NetworkedComponent>(entt::exclude<DeadFlag>);
+	auto collectibleView = m_registry.view<Sel::Transform, CollectibleFlag, NetworkedComponent>(entt::exclude<InactiveFlag>);
 
     // Loop through all collectibles
     for (auto collectible : collectibleView)
     {
         // Get components for each collectible
         auto& collectibleTransform = collectibleView.get<Sel::Transform>(collectible);
-        auto& collectibleNetwork = collectibleView.get<NetworkedComponent>(collectible);
         auto& collectibleFlag = collectibleView.get<CollectibleFlag>(collectible);
 
-        // Loop through all brawlers
-        for (auto brawler : brawlerView)
-        {
-            // Get components for each brawler
-            auto& brawlerTransform = brawlerView.get<Sel::Transform>(brawler);
-            auto& brawlerNetwork = brawlerView.get<NetworkedComponent>(brawler);
-
-            // Squared Distance
-            Sel::Vector2f delta = brawlerTransform.GetPosition() - collectibleTransform.GetPosition();
-            float distanceSqr = delta.x * delta.x + delta.y * delta.y;
+        Sel::Vector2f collectiblePosition = collectibleTransform.GetPosition();
 
-            if (distanceSqr <= 50.f * 50.f)
+        // Only the brawlers in the cells around the collectible are checked, the nearest one in contact collects it
+        std::optional<entt::entity> nearestBrawler;
+        float nearestDistanceSqr = 0.f;
+        m_gameData.brawlerGrid.ForEachInRadius(collectiblePosition, PickupRadius, [&](const SpatialGrid::Item& brawler)
+        {
+            float distanceSqr = (brawler.position - collectiblePosition).SquaredMagnitude();
+            if (!nearestBrawler || distanceSqr < nearestDistanceSqr)
             {
-                // They are in contact
-
-                if (collectibleFlag.type == CollectibleType::GoldenCarrot)
-                {
-                    std::cout << "golden gathered" << std::endl;
+                nearestBrawler = brawler.entity;
+                nearestDistanceSqr = distanceSqr;
+            }
+        });
 
-                    m_gameData.goldenCarrot.owningBrawlerId = brawlerNetwork.networkId;
-                    m_gameData.goldenCarrot.pointPulseClock.Restart();
+        if (!nearestBrawler)
+            continue;
 
-                    // Notify people
-                    GoldenEventPacket packet;
-                    packet.eventType = GoldenEventPacket::GoldenEventType::Gathered;
-                    packet.newOwner = brawlerNetwork.networkId;
+        // They are in contact
+        auto& brawlerNetwork = m_registry.get<NetworkedComponent>(*nearestBrawler);
 
-                    for (auto& player : gameData.players)
-                    {
-                        if (!player.peer)
-                            continue;
+        if (collectibleFlag.type == CollectibleType::GoldenCarrot)
+        {
+            log_info("golden gathered by brawler {}", brawlerNetwork.networkId);
 
-                        enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-                    }
+            m_gameData.goldenCarrot.owningBrawlerId = brawlerNetwork.networkId;
+            m_gameData.goldenCarrot.nextPulseTick = m_gameData.scheduler.GetTick() + m_gameData.scheduler.ToTicks(m_gameData.goldenCarrot.pulseTime);
 
-                    //Move it out the game space
-                    collectibleTransform.SetPosition({ -20000.f, -20000.f });
-                }
-                else
-                {
-                    // Remove the collectible from the registry
-                    m_registry.destroy(collectible);
+            // Notify people
+            GoldenEventPacket packet;
+            packet.eventType = GoldenEventPacket::GoldenEventType::Gathered;
+            packet.newOwner = brawlerNetwork.networkId;
 
-                }
+            broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
 
-                collectionOccured = true;
+            //Move it out the game space
+            collectibleTransform.SetPosition({ ParkedPosition, ParkedPosition });
+        }
+        else
+        {
+            // Park it until a spawn reuses it (the clients which know it are told to delete it)
+            m_gameData.collectiblePool.Release(collectible);
+        }
 
+        collectionOccured = true;
 
-                // Find the player controlling the brawler and send him a packet to notify he got a collectible
-                auto it = std::find_if(m_gameData.players.begin(), m_gameData.players.end(), [&](const Player& player) { return player.ownBrawlerNetworkId == brawlerNetwork.networkId; });
-                if(it != m_gameData.players.end());
-                {
-                    Player& player = *it;
 
-                    // Also update its score
-                    player.playerScore++;
+        // Find the player controlling the brawler and send him a packet to notify he got a collectible
+        auto it = std::find_if(m_gameData.players.begin(), m_gameData.players.end(), [&](const Player& player) { return player.ownBrawlerNetworkId == brawlerNetwork.networkId; });
+        if(it != m_gameData.players.end())
+        {
+            Player& player = *it;
 
-                    CollectibleCollectedPacket packet;
-                    enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-                }
+            // Also update its score
+            player.playerScore++;
+            m_gameData.leaderBoard.Update(m_gameData.players.GetHandle(player.index), player.playerScore, player.isDead);
 
-                // Break out of the inner loop to stop checking other brawlers for this collectible
-                break;
-            }
+            CollectibleCollectedPacket packet;
+            send_packet(m_gameData, player.peer, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
         }
     }
 
     return collectionOccured;
 }
-
@@ -0,0 +1,74 @@
+#include "sv_broadcast.h"
+#include "sv_gamedata.h"
+#include <cassert>
+
+void broadcast_packet(GameData& gameData, ENetPacket* packet, Recipients recipients)
+{
+	if (!packet)
+		return;
+
+	std::size_t queuedPacketCount = gameData.outbox.size();
+
+	switch (recipients)
+	{
+		case Recipients::All:
+		{
+			for (const Player& player : gameData.players)
+			{
+				if (player.peer != nullptr)
+					send_packet(gameData, player.peer, packet);
+			}
+
+			break;
+		}
+
+		case Recipients::Named:
+		{
+			for (const Player& player : gameData.players)
+			{
+				if (player.peer != nullptr && !player.name.empty())
+					send_packet(gameData, player.peer, packet);
+			}
+
+			break;
+		}
+
+		case Recipients::Playing:
+		{
+			for (PlayerHandle handle : gameData.playingPlayers)
+			{
+				const Player* player = gameData.players.Get(handle);
+				if (player && player->peer != nullptr)
+					send_packet(gameData, player->peer, packet);
+			}
+
+			break;
+		}
+
+		case Recipients::Spectators:
+		{
+			for (const Player& player : gameData.players)
+			{
+				if (player.peer != nullptr && !player.name.empty() && player.isDead)
+					send_packet(gameData, player.peer, packet);
+			}
+
+			break;
+		}
+	}
+
+	// Nobody will hold a reference on it, ENet won't ever free it
+	if (gameData.outbox.size() == queuedPacketCount)
+		enet_packet_destroy(packet);
+}
+
+void send_packet(GameData& gameData, ENetPeer* peer, ENetPacket* packet)
+{
+	assert(peer && packet);
+
+	// Sending it again (broadcast): the previous send isn't the last one anymore
+	if (!gameData.outbox.empty() && gameData.outbox.back().packet == packet)
+		gameData.outbox.back().isLastSend = false;
+
+	gameData.outbox.push_back({ peer, packet, true });
+}
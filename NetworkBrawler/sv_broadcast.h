@@ -0,0 +1,28 @@
+#pragma once
+
+#include "sh_protocol.h"
+#include <enet6/enet.h>
+
+struct GameData;
+
+// Who receives a broadcast packet
+enum class Recipients
+{
+	All,        //< every connected peer
+	Named,      //< players who sent their name
+	Playing,    //< players taking part in the current game (gameData.playingPlayers)
+	Spectators  //< named players who aren't alive in the current game (dead or joined while it was running)
+};
+
+// Sends the same packet to every recipient: it's built once and shared (ENet refcounts it), it's destroyed here if nobody received it
+void broadcast_packet(GameData& gameData, ENetPacket* packet, Recipients recipients);
+
+// Rooms are updated on worker threads and ENet is only called by the network thread: packets are queued in gameData.outbox,
+// the network thread sends them and destroys those which didn't reach anyone
+void send_packet(GameData& gameData, ENetPeer* peer, ENetPacket* packet);
+
+template<typename T>
+void broadcast_packet(GameData& gameData, const T& packet, enet_uint32 flags, Recipients recipients)
+{
+	broadcast_packet(gameData, build_packet(packet, flags), recipients);
+}
@@ -0,0 +1,56 @@
+#include "sv_collectiblepool.h"
+#include "sh_protocol.h"
+#include "sv_gamedata.h"
+#include <Sel/Transform.hpp>
+#include <cassert>
+
+CollectiblePool::CollectiblePool(entt::registry& registry) :
+	m_registry(registry)
+{
+}
+
+entt::entity CollectiblePool::Acquire(const Sel::Vector2f& position)
+{
+	if (m_inactiveCollectibles.empty())
+		return entt::null;
+
+	entt::entity collectible = m_inactiveCollectibles.back();
+	m_inactiveCollectibles.pop_back();
+	assert(m_registry.all_of<InactiveFlag>(collectible));
+
+	m_registry.remove<InactiveFlag>(collectible);
+	m_registry.get<Sel::Transform>(collectible).SetPosition(position);
+	m_stats.reusedCount++;
+
+	return collectible;
+}
+
+std::size_t CollectiblePool::GetInactiveCount() const
+{
+	return m_inactiveCollectibles.size();
+}
+
+const CollectiblePool::Stats& CollectiblePool::GetStats() const
+{
+	return m_stats;
+}
+
+void CollectiblePool::NotifyCreated()
+{
+	m_stats.createdCount++;
+}
+
+void CollectiblePool::Release(entt::entity collectible)
+{
+	assert(!m_registry.all_of<InactiveFlag>(collectible));
+
+	m_registry.emplace<InactiveFlag>(collectible);
+	m_registry.get<Sel::Transform>(collectible).SetPosition({ ParkedPosition, ParkedPosition });
+	m_inactiveCollectibles.push_back(collectible);
+	m_stats.releasedCount++;
+}
+
+void CollectiblePool::ResetStats()
+{
+	m_stats = Stats{};
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Sel/Vector2.hpp>
+#include <entt/entt.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Collected carrots aren't destroyed: they're parked out of the world (with an InactiveFlag) until the next spawn moves them back in.
+// They keep their components and their network id, the clients are only told to delete them and to create them again when they're in view.
+class CollectiblePool
+{
+public:
+	// Since the last ResetStats
+	struct Stats
+	{
+		std::uint64_t createdCount = 0;  //< spawns which found the pool empty
+		std::uint64_t reusedCount = 0;
+		std::uint64_t releasedCount = 0;
+	};
+
+	explicit CollectiblePool(entt::registry& registry);
+	CollectiblePool(const CollectiblePool&) = delete;
+	CollectiblePool(CollectiblePool&&) = delete;
+	~CollectiblePool() = default;
+
+	// Moves a parked collectible back in the world, entt::null if there's none (the caller creates a new one and calls NotifyCreated)
+	entt::entity Acquire(const Sel::Vector2f& position);
+
+	std::size_t GetInactiveCount() const;
+	const Stats& GetStats() const;
+
+	void NotifyCreated();
+
+	// Parks the collectible out of the world until Acquire picks it
+	void Release(entt::entity collectible);
+
+	void ResetStats();
+
+	CollectiblePool& operator=(const CollectiblePool&) = delete;
+	CollectiblePool& operator=(CollectiblePool&&) = delete;
+
+private:
+	std::vector<entt::entity> m_inactiveCollectibles;
+	entt::registry& m_registry;
+	Stats m_stats;
+};
@@ -2,75 +2,141 @@
 
 #include "sh_constants.h"
 #include <Sel/Color.hpp>
-#include <Sel/Stopwatch.hpp>
 #include <enet6/enet.h>
+#include <random>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <entt/entity/handle.hpp>
 #include "sh_brawler.h"
+#include "sh_snapshot.h"
+#include "sv_collectiblepool.h"
+#include "sv_inputbuffer.h"
+#include "sv_leaderboard.h"
+#include "sv_slotmap.h"
+#include "sv_spatialgrid.h"
+#include "sv_tickprofiler.h"
+#include "sv_tickscheduler.h"
+
+// Priority accumulated by a state waiting to be sent, split by what it was gained from (see NetworkSystem::LimitToBudget)
+struct StatePriority
+{
+	float total = 0.f; //< sum of the three below, what states are sorted by
+	float time = 0.f;
+	float distance = 0.f;
+	float velocityChange = 0.f;
+};
+
+// How the state updates of a player fitted in its budget, since the last NetworkSystem::DumpStats
+struct ReplicationStats
+{
+	std::uint64_t snapshotCount = 0;
+	std::uint64_t sentStateCount = 0;
+	std::uint64_t deferredStateCount = 0; //< states which didn't fit, summed over the snapshots
+	std::uint64_t byteCount = 0;
+	std::size_t maxPacketSize = 0;
+	float maxPriority = 0.f; //< highest accumulator reached
+	StatePriority gainedPriority; //< priority gained by every waiting state, summed over the snapshots
+	std::vector<std::pair<std::uint32_t, StatePriority>> topDeferred; //< (network id, highest accumulator) of the most urgent deferred states
+};
 
 struct Player
 {
 	Sel::Color color; //< Couleur du joueur
-	ENetPeer* peer = nullptr; //< Si peer est  nullptr alors le slot est libre
+	ENetPeer* peer = nullptr; //< null once the player is disconnecting (its slot is freed right after)
 	std::size_t index; //< La position du joueur dans le tableau (sert d'id numrique lors de l'affichage)
 	std::string name; //< Nom du joueur
 	std::optional<Brawler> brawler;
+	InputBuffer inputBuffer; //< received inputs, one is applied per tick
 	std::optional<std::uint32_t> ownBrawlerNetworkId;
 	std::uint32_t playerScore = 0;
 	std::uint8_t skinIndex = 0;
 	bool isReady;
 	bool isDead;
+
+	SnapshotHistory sentSnapshots; //< what we sent to this player, used as delta baselines
+	std::vector<std::uint32_t> knownEntities; //< network ids of the entities created on this player's client, sorted
+	std::optional<std::uint32_t> spectatedBrawlerId; //< brawler followed by the camera of the client while it isn't playing
+	std::optional<Sel::Vector2f> viewCenter; //< last known center of the client's camera, everything is replicated until there's one
+	std::unordered_map<std::uint32_t, StatePriority> statePriorities; //< priority accumulator of the known entities with a state, by network id
+	ReplicationStats replicationStats;
+	std::uint32_t lastAckedSnapshotId = InvalidSnapshotId; //< last snapshot the player acknowledged
 };
 
+// Players are referred to by handle (also stored in their ENetPeer::data), never by pointer
+using PlayerHandle = SlotHandle;
+
+// A packet queued by send_packet, waiting for the network thread to hand it to ENet.
+// A broadcast packet is queued once per recipient, in a row: the network thread holds it until its last send, which may destroy it (if no send is pending)
+struct OutgoingPacket
+{
+	ENetPeer* peer;
+	ENetPacket* packet;
+	bool isLastSend;
+};
+
+constexpr float PickupRadius = 50.f; //< a brawler this close to a collectible collects it
+constexpr float ParkedPosition = -20000.f; //< on both axes, out of the world and of every view: where collected carrots wait to respawn
+constexpr float StealRadius = 100.f; //< a brawler this close to the golden carrot owner steals it
+constexpr std::uint32_t MaxStealRewind = 10; //< snapshots (~333ms at 30Hz) a steal can be resolved in the past, an older view is clamped to it
+static_assert(MaxStealRewind < SnapshotHistory::Capacity);
+
+// Cells as large as the largest query radius, queries look at 3x3 cells
+constexpr float BrawlerGridCellSize = StealRadius;
+
 struct GoldenCarrot
 {
 	bool isSpawned = false;
 	std::optional<std::uint32_t> owningBrawlerId;
 	entt::handle handle;
 
-	Sel::Stopwatch goldenCarrotClock;
-	float spawnTime = 0.f;
+	std::uint64_t spawnTick = 0;
 
-	Sel::Stopwatch pointPulseClock; // < the golden carrot give 1 more points every 2 seconds to its owner
+	std::uint64_t nextPulseTick = 0; // < the golden carrot give 1 more points every 2 seconds to its owner
 	float pulseTime = 3.f;
 };
 
 struct GameData
 {
 	GameData(entt::registry& reg, GoldenCarrot& _goldenCarrot) :
-		registry(reg),
-		goldenCarrot(_goldenCarrot)
+		scheduler(TickDelay),
+		profiler(TickDelay),
+		brawlerGrid(Sel::Vector2f(-WorldHalfSize, -WorldHalfSize), Sel::Vector2f(WorldHalfSize, WorldHalfSize), BrawlerGridCellSize),
+		goldenCarrot(_goldenCarrot),
+		collectiblePool(reg),
+		registry(reg)
 	{
 	}
 
-	Sel::Stopwatch clock;
-	Sel::Stopwatch collectibleClock;
-	Sel::Stopwatch gameStartClock;
-	Sel::Stopwatch killClock;
+	TickScheduler scheduler; //< every timer below is a deadline in scheduler ticks
+	TickProfiler profiler; //< durations of the tick phases, a tick longer than TickDelay is an overrun
+	SpatialGrid brawlerGrid; //< alive brawlers, rebuilt by tick() once they moved
 
-	float nextTick = 0.f;
-	float tickInterval = TickDelay;
+	std::uint64_t gameStartTick = 0; //< when everyone is ready, the game starts at this tick
+	float gameStartDelay = 5.f;
 
-	float nextKill = KILL_INTERVAL;
+	std::uint64_t nextKillTick = 0;
 	float killInterval = KILL_INTERVAL;
 
 	GoldenCarrot& goldenCarrot;
 
 
-	float lastCollectibleSpawn = 0.f;
-	float nextCollectibleSpawn = 0.5f;
+	std::uint64_t nextCollectibleSpawnTick = 0;
 	float collectibleSpawnInterval = 4.0f;
-	std::uint32_t collectibleMaxCount = 25;
+	std::uint32_t collectibleMaxCount = 25; //< active ones, parked ones don't count
+	CollectiblePool collectiblePool; //< collected carrots, reused by the next spawns
 
 	GameState gamesState = GameState::Lobby;
 	bool allReady = false;
 
-	Player* lastWinner = nullptr;
-	std::vector<Player> players;
-	std::vector<Player*> playingPlayers; // players in the game. filled at game start with players present in lobby
-	std::vector<Player*> leaderBoard; // reordered when score changes first is the highest score
+	PlayerHandle lastWinner;
+	SlotMap<Player> players; //< player.index is its slot index
+	std::vector<PlayerHandle> playingPlayers; // players in the game. filled at game start with players present in lobby
+	Leaderboard leaderBoard; //< players of the current game, sent to the clients by flush_leaderboard at the end of the tick
 	entt::registry& registry;
 	std::unordered_map<std::uint32_t, entt::handle> networkToEntity;
+
+	std::mt19937 randomGenerator; //< one per room, rand() isn't thread-safe
+	std::vector<OutgoingPacket> outbox; //< filled while the room is updated, handed to the network thread afterwards
 };
\ No newline at end of file
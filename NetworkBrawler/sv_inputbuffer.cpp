@@ -0,0 +1,147 @@
+#include "sv_inputbuffer.h"
+#include <algorithm>
+#include <cassert>
+
+InputBuffer::InputBuffer() :
+	m_receivedTicks(0),
+	m_targetDepth(DefaultTargetDepth),
+	m_windowMinDepth(Capacity),
+	m_windowPopCount(0),
+	m_isFilling(true),
+	m_hasStarvedInWindow(false)
+{
+	m_inputs.reserve(Capacity);
+}
+
+std::size_t InputBuffer::GetDepth() const
+{
+	return m_inputs.size();
+}
+
+const InputBuffer::Stats& InputBuffer::GetStats() const
+{
+	return m_stats;
+}
+
+std::size_t InputBuffer::GetTargetDepth() const
+{
+	return m_targetDepth;
+}
+
+std::optional<PlayerInputs> InputBuffer::Pop()
+{
+	if (m_isFilling)
+	{
+		if (m_inputs.size() < m_targetDepth)
+			return std::nullopt;
+
+		m_isFilling = false;
+	}
+
+	if (m_inputs.empty())
+	{
+		// The inputs came too late for this tick, we need more of them in advance
+		m_stats.starvationCount++;
+		m_hasStarvedInWindow = true;
+		m_targetDepth = std::min(m_targetDepth + 1, MaxTargetDepth);
+		m_isFilling = true;
+		return std::nullopt;
+	}
+
+	m_windowMinDepth = std::min(m_windowMinDepth, m_inputs.size());
+
+	// A missing tick (lost packet) is skipped, the input after it is consumed instead
+	if (m_lastConsumedTick)
+		m_stats.lostCount += m_inputs.front().tick - *m_lastConsumedTick - 1;
+
+	PlayerInputs inputs = m_inputs.front().inputs;
+	m_lastConsumedTick = m_inputs.front().tick;
+	m_inputs.erase(m_inputs.begin());
+	m_stats.consumedCount++;
+
+	if (++m_windowPopCount >= AdaptWindow)
+		Adapt();
+
+	return inputs;
+}
+
+void InputBuffer::Push(std::uint32_t tick, const PlayerInputs& inputs, bool isResent)
+{
+	constexpr std::uint32_t ReceivedTickCount = 64;
+
+	if (!m_newestTick || tick > *m_newestTick)
+	{
+		std::uint32_t shift = (m_newestTick) ? tick - *m_newestTick : ReceivedTickCount;
+		m_receivedTicks = (shift < ReceivedTickCount) ? (m_receivedTicks << shift) | 1 : 1;
+		m_newestTick = tick;
+	}
+	else
+	{
+		// Older than what we received: a copy of an input we already have, or one which didn't come with its own packet
+		std::uint32_t age = *m_newestTick - tick;
+		if (age >= ReceivedTickCount || (m_receivedTicks & (std::uint64_t(1) << age)))
+			return;
+
+		m_receivedTicks |= std::uint64_t(1) << age;
+	}
+
+	if (m_lastConsumedTick && tick <= *m_lastConsumedTick)
+	{
+		m_stats.lateCount++;
+		return;
+	}
+
+	if (isResent)
+		m_stats.recoveredCount++;
+
+	auto it = std::lower_bound(m_inputs.begin(), m_inputs.end(), tick, [](const Entry& entry, std::uint32_t entryTick) { return entry.tick < entryTick; });
+	assert(it == m_inputs.end() || it->tick != tick);
+
+	if (m_inputs.size() >= Capacity)
+	{
+		// The client is way ahead of us, the oldest input goes (unless that's this one)
+		if (it == m_inputs.begin())
+		{
+			m_stats.skippedCount++;
+			return;
+		}
+
+		DropOldest(1);
+		it = std::lower_bound(m_inputs.begin(), m_inputs.end(), tick, [](const Entry& entry, std::uint32_t entryTick) { return entry.tick < entryTick; });
+	}
+
+	m_inputs.insert(it, Entry{ tick, inputs });
+	m_stats.maxDepth = std::max(m_stats.maxDepth, m_inputs.size());
+}
+
+void InputBuffer::ResetStats()
+{
+	m_stats = Stats{};
+}
+
+void InputBuffer::Adapt()
+{
+	// The whole window went fine, maybe it still would with less latency
+	if (!m_hasStarvedInWindow && m_targetDepth > MinTargetDepth)
+		m_targetDepth--;
+
+	// Inputs which never left the buffer during the window are pure latency
+	if (m_windowMinDepth > m_targetDepth)
+		DropOldest(std::min(m_windowMinDepth - m_targetDepth, m_inputs.size()));
+
+	m_windowMinDepth = Capacity;
+	m_windowPopCount = 0;
+	m_hasStarvedInWindow = false;
+}
+
+void InputBuffer::DropOldest(std::size_t count)
+{
+	assert(count <= m_inputs.size());
+	if (count == 0)
+		return;
+
+	// They count as consumed: if they arrive again, they're late
+	m_lastConsumedTick = m_inputs[count - 1].tick;
+	m_inputs.erase(m_inputs.begin(), m_inputs.begin() + count);
+	m_stats.skippedCount += count;
+}
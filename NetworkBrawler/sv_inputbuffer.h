@@ -0,0 +1,69 @@
+#pragma once
+
+#include "sh_inputs.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Inputs of a player waiting to be applied, sorted by the client tick they were sampled at.
+// The room consumes exactly one per tick, so jitter on their arrival doesn't show up as uneven movement.
+// Each input arrives several times (see PlayerInputsPacket), only its first copy is kept.
+// The depth adapts: a tick without input makes the buffer deeper (and it fills up again before being consumed),
+// a window without starvation makes it shallower, and inputs which stayed in excess during a whole window are dropped (they only add latency).
+class InputBuffer
+{
+public:
+	// Since the last ResetStats
+	struct Stats
+	{
+		std::uint64_t consumedCount = 0;
+		std::uint64_t starvationCount = 0; //< ticks which had no input to consume
+		std::uint64_t lateCount = 0;       //< dropped, a more recent input was already consumed
+		std::uint64_t lostCount = 0;       //< ticks skipped because their input never arrived in time
+		std::uint64_t recoveredCount = 0;  //< first received as a resent copy (the packet which first carried it was lost)
+		std::uint64_t skippedCount = 0;    //< dropped to bring the depth back down (excess or full buffer)
+		std::size_t maxDepth = 0;
+	};
+
+	InputBuffer();
+
+	std::size_t GetDepth() const;
+	const Stats& GetStats() const;
+	std::size_t GetTargetDepth() const;
+
+	// Input to apply this tick, none while the buffer is filling up or starving (the previous inputs stay in effect)
+	std::optional<PlayerInputs> Pop();
+
+	// Copies of an input already received are ignored, isResent tells it was sent again after the packet which first carried it
+	void Push(std::uint32_t tick, const PlayerInputs& inputs, bool isResent);
+
+	void ResetStats();
+
+	static constexpr std::size_t Capacity = 16; //< ~533ms at 30Hz
+	static constexpr std::size_t DefaultTargetDepth = 2;
+	static constexpr std::size_t MinTargetDepth = 1;
+	static constexpr std::size_t MaxTargetDepth = 6;
+	static constexpr std::uint32_t AdaptWindow = 300; //< consumed inputs (10s at 30Hz)
+
+private:
+	struct Entry
+	{
+		std::uint32_t tick;
+		PlayerInputs inputs;
+	};
+
+	void Adapt();
+	void DropOldest(std::size_t count);
+
+	std::vector<Entry> m_inputs; //< sorted by tick
+	std::optional<std::uint32_t> m_lastConsumedTick;
+	std::optional<std::uint32_t> m_newestTick; //< most recent input received
+	std::uint64_t m_receivedTicks; //< bit i is set if the input of m_newestTick - i was received
+	Stats m_stats;
+	std::size_t m_targetDepth;
+	std::size_t m_windowMinDepth; //< lowest depth a Pop saw during the current window
+	std::uint32_t m_windowPopCount;
+	bool m_isFilling;
+	bool m_hasStarvedInWindow;
+};
@@ -0,0 +1,155 @@
+#include "sv_leaderboard.h"
+#include <algorithm>
+#include <cassert>
+
+Leaderboard::Leaderboard() :
+	m_hasChanges(false),
+	m_needsFullUpdate(false)
+{
+}
+
+void Leaderboard::Add(SlotHandle player, std::uint32_t score, bool isDead)
+{
+	assert(Find(player) == InvalidIndex);
+
+	Entry& entry = m_entries.emplace_back();
+	entry.player = player;
+	entry.score = score;
+	entry.isDead = isDead;
+	entry.changes = Added;
+
+	m_hasChanges = true;
+
+	Reposition(m_entries.size() - 1);
+}
+
+void Leaderboard::Clear()
+{
+	m_entries.clear();
+	m_removedPlayers.clear();
+	m_hasChanges = true;
+	m_needsFullUpdate = true;
+}
+
+const std::vector<Leaderboard::Entry>& Leaderboard::GetEntries() const
+{
+	return m_entries;
+}
+
+const std::vector<SlotHandle>& Leaderboard::GetRemovedPlayers() const
+{
+	return m_removedPlayers;
+}
+
+bool Leaderboard::HasChanges() const
+{
+	return m_hasChanges;
+}
+
+void Leaderboard::MarkNameChanged(SlotHandle player)
+{
+	std::size_t index = Find(player);
+	if (index == InvalidIndex)
+		return;
+
+	m_entries[index].changes |= NameChanged;
+	m_hasChanges = true;
+}
+
+bool Leaderboard::NeedsFullUpdate() const
+{
+	return m_needsFullUpdate;
+}
+
+void Leaderboard::Remove(SlotHandle player)
+{
+	std::size_t index = Find(player);
+	if (index == InvalidIndex)
+		return;
+
+	// The others keep their relative order, there's nothing else to send for them
+	m_entries.erase(m_entries.begin() + index);
+	m_removedPlayers.push_back(player);
+	m_hasChanges = true;
+}
+
+void Leaderboard::ResetChanges()
+{
+	for (Entry& entry : m_entries)
+		entry.changes = 0;
+
+	m_removedPlayers.clear();
+	m_hasChanges = false;
+	m_needsFullUpdate = false;
+}
+
+void Leaderboard::Update(SlotHandle player, std::uint32_t score, bool isDead)
+{
+	std::size_t index = Find(player);
+	if (index == InvalidIndex)
+		return;
+
+	Entry& entry = m_entries[index];
+	if (entry.score == score && entry.isDead == isDead)
+		return;
+
+	if (entry.score != score)
+		entry.changes |= ScoreChanged;
+
+	if (entry.isDead != isDead)
+		entry.changes |= DeadChanged;
+
+	entry.score = score;
+	entry.isDead = isDead;
+	m_hasChanges = true;
+
+	Reposition(index);
+}
+
+std::size_t Leaderboard::Find(SlotHandle player) const
+{
+	// There are at most Room::MaxPlayerCount entries, a scan is cheaper than keeping an index up to date
+	for (std::size_t i = 0; i < m_entries.size(); ++i)
+	{
+		if (m_entries[i].player == player)
+			return i;
+	}
+
+	return InvalidIndex;
+}
+
+void Leaderboard::Reposition(std::size_t index)
+{
+	// Everything else is still sorted: shift the entries it passes by one, in a single direction
+	Entry entry = m_entries[index];
+
+	std::size_t newIndex = index;
+	while (newIndex > 0 && RanksBefore(entry, m_entries[newIndex - 1]))
+	{
+		m_entries[newIndex] = m_entries[newIndex - 1];
+		newIndex--;
+	}
+
+	if (newIndex == index)
+	{
+		while (newIndex + 1 < m_entries.size() && RanksBefore(m_entries[newIndex + 1], entry))
+		{
+			m_entries[newIndex] = m_entries[newIndex + 1];
+			newIndex++;
+		}
+	}
+
+	if (newIndex != index)
+		entry.changes |= Moved;
+
+	m_entries[newIndex] = entry;
+}
+
+bool Leaderboard::RanksBefore(const Entry& lhs, const Entry& rhs)
+{
+	// Dead players go last
+	if (lhs.isDead != rhs.isDead)
+		return !lhs.isDead;
+
+	return lhs.score > rhs.score;
+}
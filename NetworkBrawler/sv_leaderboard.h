@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sv_slotmap.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Players of the current game ranked alive first, then by decreasing score (ties keep their previous order).
+// Entries keep a copy of what they're ranked by, a change only moves the entry of that player to its new rank.
+// Changes are accumulated until ResetChanges, so the room can send them at most once per tick (see LeaderboardDeltaPacket).
+class Leaderboard
+{
+public:
+	enum Changes : std::uint8_t
+	{
+		Added = 1 << 0,
+		Moved = 1 << 1,
+		NameChanged = 1 << 2,
+		ScoreChanged = 1 << 3,
+		DeadChanged = 1 << 4
+	};
+
+	struct Entry
+	{
+		SlotHandle player;
+		std::uint32_t score;
+		bool isDead;
+		std::uint8_t changes; //< Changes since the last ResetChanges
+	};
+
+	Leaderboard();
+	Leaderboard(const Leaderboard&) = delete;
+	Leaderboard(Leaderboard&&) = delete;
+	~Leaderboard() = default;
+
+	void Add(SlotHandle player, std::uint32_t score, bool isDead);
+
+	// Removes everyone, the whole leaderboard has to be sent again
+	void Clear();
+
+	const std::vector<Entry>& GetEntries() const; //< first is the best ranked
+	const std::vector<SlotHandle>& GetRemovedPlayers() const;
+
+	bool HasChanges() const;
+
+	void MarkNameChanged(SlotHandle player);
+
+	bool NeedsFullUpdate() const;
+
+	void Remove(SlotHandle player);
+
+	void ResetChanges();
+
+	// Does nothing if the player isn't in the leaderboard
+	void Update(SlotHandle player, std::uint32_t score, bool isDead);
+
+	Leaderboard& operator=(const Leaderboard&) = delete;
+	Leaderboard& operator=(Leaderboard&&) = delete;
+
+private:
+	static constexpr std::size_t InvalidIndex = static_cast<std::size_t>(-1);
+
+	std::size_t Find(SlotHandle player) const;
+	void Reposition(std::size_t index);
+
+	static bool RanksBefore(const Entry& lhs, const Entry& rhs);
+
+	std::vector<Entry> m_entries;
+	std::vector<SlotHandle> m_removedPlayers;
+	bool m_hasChanges;
+	bool m_needsFullUpdate;
+};
@@ -0,0 +1,155 @@
+#include "sv_logger.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char* GetLevelName(LogLevel level)
+	{
+		switch (level)
+		{
+			case LogLevel::Debug:   return "debug";
+			case LogLevel::Info:    return "info";
+			case LogLevel::Warning: return "warning";
+			case LogLevel::Error:   return "error";
+			case LogLevel::Off:     break;
+		}
+
+		return "<unknown>";
+	}
+
+	template<typename T>
+	void AppendNumber(std::string& output, T value)
+	{
+		char buffer[32];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		output.append(buffer, result.ptr);
+	}
+}
+
+Logger::Logger() :
+	m_records(Capacity),
+	m_droppedCount(0),
+	m_minLevel(LogLevel::Info),
+	m_isRunning(true),
+	m_startTime(std::chrono::steady_clock::now())
+{
+	m_thread = std::thread([this] { Run(); });
+}
+
+Logger::~Logger()
+{
+	// The thread writes what's left before leaving
+	m_isRunning.store(false, std::memory_order_release);
+	m_thread.join();
+}
+
+std::uint64_t Logger::GetDroppedCount() const
+{
+	return m_droppedCount.load(std::memory_order_relaxed);
+}
+
+void Logger::SetMinLevel(LogLevel level)
+{
+	m_minLevel.store(level, std::memory_order_relaxed);
+}
+
+Logger& Logger::Instance()
+{
+	static Logger logger;
+	return logger;
+}
+
+void Logger::Format(const Record& record, std::string& output) const
+{
+	// [seconds since start] level: message
+	char header[48];
+	double seconds = std::chrono::duration<double>(record.time - m_startTime).count();
+	int headerSize = std::snprintf(header, sizeof(header), "[%10.3f] %s: ", seconds, GetLevelName(record.level));
+	output.append(header, std::clamp(headerSize, 0, static_cast<int>(sizeof(header)) - 1));
+
+	std::size_t argIndex = 0;
+	std::size_t textOffset = 0;
+	for (const char* c = record.format; *c != '\0'; ++c)
+	{
+		if (c[0] != '{' || c[1] != '}' || argIndex >= record.argCount)
+		{
+			output.push_back(*c);
+			continue;
+		}
+
+		const Arg& arg = record.args[argIndex++];
+		switch (arg.type)
+		{
+			case ArgType::Bool:  output.append(arg.b ? "true" : "false"); break;
+			case ArgType::Int:   AppendNumber(output, arg.i); break;
+			case ArgType::UInt:  AppendNumber(output, arg.u); break;
+			case ArgType::Float:
+			{
+				char buffer[32];
+				int size = std::snprintf(buffer, sizeof(buffer), "%g", arg.f);
+				output.append(buffer, std::clamp(size, 0, static_cast<int>(sizeof(buffer)) - 1));
+				break;
+			}
+
+			case ArgType::Text:
+				output.append(record.text.data() + textOffset, arg.textLength);
+				textOffset += arg.textLength;
+				break;
+		}
+
+		++c; //< skips the }
+	}
+
+	output.push_back('\n');
+}
+
+void Logger::Run()
+{
+	std::string output;
+	Record record;
+	std::uint64_t reportedDropCount = 0;
+
+	for (;;)
+	{
+		// Read before draining: everything logged before the destructor started is written
+		bool isRunning = m_isRunning.load(std::memory_order_acquire);
+
+		// Everything waiting is written at once
+		while (m_records.TryPop(record))
+			Format(record, output);
+
+		std::uint64_t dropCount = m_droppedCount.load(std::memory_order_relaxed);
+		if (dropCount != reportedDropCount)
+		{
+			output.append("[logger] ");
+			AppendNumber(output, dropCount - reportedDropCount);
+			output.append(" messages dropped (buffer full)\n");
+			reportedDropCount = dropCount;
+		}
+
+		if (!output.empty())
+		{
+			std::fwrite(output.data(), 1, output.size(), stdout);
+			std::fflush(stdout);
+			output.clear();
+		}
+		else if (isRunning)
+			std::this_thread::sleep_for(IdleSleep);
+
+		if (!isRunning)
+			break;
+	}
+}
+
+void Logger::StoreText(Record& record, Arg& arg, std::string_view value)
+{
+	std::size_t length = std::min(value.size(), TextCapacity - record.textSize);
+	std::memcpy(record.text.data() + record.textSize, value.data(), length);
+
+	arg.type = ArgType::Text;
+	arg.textLength = static_cast<std::uint16_t>(length);
+	record.textSize += static_cast<std::uint16_t>(length);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "sv_mpscqueue.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : std::uint8_t
+{
+	Debug,
+	Info,
+	Warning,
+	Error,
+
+	Off //< as minimum level, nothing is logged
+};
+
+// Logs from any thread without blocking nor allocating: the message is stored as its format and its arguments (texts are copied, up to TextCapacity bytes)
+// in a lock-free ring buffer, the logger thread formats and writes them to stdout.
+// The format is a string literal where each {} is replaced by the next argument. When the buffer is full the message is dropped and counted,
+// the logger thread then writes how many were.
+class Logger
+{
+public:
+	Logger(const Logger&) = delete;
+	Logger(Logger&&) = delete;
+	~Logger();
+
+	std::uint64_t GetDroppedCount() const;
+
+	template<std::size_t N, typename... Args> void Log(LogLevel level, const char (&format)[N], const Args&... args);
+
+	void SetMinLevel(LogLevel level);
+
+	Logger& operator=(const Logger&) = delete;
+	Logger& operator=(Logger&&) = delete;
+
+	static Logger& Instance();
+
+	static constexpr std::size_t Capacity = 4096; //< messages
+	static constexpr std::size_t MaxArgCount = 6;
+	static constexpr std::size_t TextCapacity = 96; //< bytes for all the text arguments of a message, longer ones are truncated
+	static constexpr std::chrono::milliseconds IdleSleep = std::chrono::milliseconds(10); //< how long the logger thread waits when there's nothing to write
+
+private:
+	enum class ArgType : std::uint8_t
+	{
+		Bool,
+		Float,
+		Int,
+		Text,
+		UInt
+	};
+
+	struct Arg
+	{
+		ArgType type;
+		union
+		{
+			bool b;
+			double f;
+			std::int64_t i;
+			std::uint64_t u;
+			std::uint16_t textLength; //< the text is stored after the previous text arguments
+		};
+	};
+
+	struct Record
+	{
+		std::chrono::steady_clock::time_point time;
+		const char* format;
+		LogLevel level;
+		std::uint8_t argCount;
+		std::uint16_t textSize;
+		std::array<Arg, MaxArgCount> args;
+		std::array<char, TextCapacity> text;
+	};
+
+	Logger();
+
+	void Format(const Record& record, std::string& output) const;
+	void Run();
+
+	template<typename T> static void StoreArg(Record& record, const T& value);
+	static void StoreText(Record& record, Arg& arg, std::string_view value);
+
+	MpscQueue<Record> m_records;
+	std::atomic<std::uint64_t> m_droppedCount;
+	std::atomic<LogLevel> m_minLevel;
+	std::atomic<bool> m_isRunning;
+	std::chrono::steady_clock::time_point m_startTime;
+	std::thread m_thread;
+};
+
+template<std::size_t N, typename... Args>
+void Logger::Log(LogLevel level, const char (&format)[N], const Args&... args)
+{
+	static_assert(sizeof...(Args) <= MaxArgCount, "too many log arguments");
+
+	if (level < m_minLevel.load(std::memory_order_relaxed))
+		return;
+
+	Record record;
+	record.time = std::chrono::steady_clock::now();
+	record.format = format;
+	record.level = level;
+	record.argCount = 0;
+	record.textSize = 0;
+	(StoreArg(record, args), ...);
+
+	if (!m_records.TryPush(std::move(record)))
+		m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void Logger::StoreArg(Record& record, const T& value)
+{
+	Arg& arg = record.args[record.argCount++];
+	if constexpr (std::is_same_v<T, bool>)
+	{
+		arg.type = ArgType::Bool;
+		arg.b = value;
+	}
+	else if constexpr (std::is_enum_v<T>)
+	{
+		arg.type = ArgType::Int;
+		arg.i = static_cast<std::int64_t>(value);
+	}
+	else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+	{
+		arg.type = ArgType::Int;
+		arg.i = value;
+	}
+	else if constexpr (std::is_integral_v<T>)
+	{
+		arg.type = ArgType::UInt;
+		arg.u = value;
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		arg.type = ArgType::Float;
+		arg.f = value;
+	}
+	else
+	{
+		static_assert(std::is_convertible_v<const T&, std::string_view>, "unsupported log argument type");
+
+		StoreText(record, arg, value);
+	}
+}
+
+template<std::size_t N, typename... Args> void log_debug(const char (&format)[N], const Args&... args) { Logger::Instance().Log(LogLevel::Debug, format, args...); }
+template<std::size_t N, typename... Args> void log_info(const char (&format)[N], const Args&... args) { Logger::Instance().Log(LogLevel::Info, format, args...); }
+template<std::size_t N, typename... Args> void log_warning(const char (&format)[N], const Args&... args) { Logger::Instance().Log(LogLevel::Warning, format, args...); }
+template<std::size_t N, typename... Args> void log_error(const char (&format)[N], const Args&... args) { Logger::Instance().Log(LogLevel::Error, format, args...); }
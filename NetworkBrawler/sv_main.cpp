@@ -1,894 +1,345 @@
 #pragma once
 
-#include <Sel/PhysicsSystem.hpp>
 #include "sh_constants.h"
-#include "sh_protocol.h"
-#include "sv_gamedata.h"
-#include "sv_networksystem.h"
+#include "sv_logger.h"
+#include "sv_networkthread.h"
+#include "sv_room.h"
+#include "sv_workerpool.h"
 #include <enet6/enet.h>
-#include <entt/entt.hpp>
-#include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cassert>
-#include <Sel/Transform.hpp>
-#include "sh_brawler.h"
-#include <Sel/VelocitySystem.hpp>
-#include "sv_networkedcomponent.h"
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
 #include <random>
-#include "sv_CollectibleSystem.h"
-#include <Sel/VelocityComponent.hpp>
-
-ENetPacket* build_playerlist_packet(GameData& gameData);
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-void handle_message(Player& player, const std::vector<std::uint8_t>& message, GameData& gameData, NetworkSystem& networkSystem);
-void tick(GameData& gameData, Sel::PhysicsSystem& physicsSystem, Sel::VelocitySystem& velocitySystem, NetworkSystem& networkSystem, CollectibleSystem& collectibleSystem);
-entt::handle spawn_collectible(GameData& gameData, const CollectibleType& type = CollectibleType::Carrot);
-void start_game(GameData& gameData);
-void end_game(GameData& gameData);
-void update_leaderboard(GameData& gameData);
-
-int main()
-{
-	if (enet_initialize() != 0)
-	{
-		std::cout << "Failed to initialize ENet" << std::endl;
-		return EXIT_FAILURE;
-	}
+void on_dump_signal(int signal);
+int run_replay(const std::string& filePath, std::size_t stateBudget);
 
-	// Cration de l'hte serveur
-	ENetAddress address;
-	enet_address_build_any(&address, ENET_ADDRESS_TYPE_IPV6);
-	address.port = AppPort;
+// Set by on_dump_signal, the main loop then dumps the message counters and the tick profiles
+volatile std::sig_atomic_t s_dumpMessageCounters = 0;
 
-	ENetHost* host = enet_host_create(ENET_ADDRESS_TYPE_ANY, &address, 10, 0, 0, 0);
-	if (!host)
-	{
-		std::cerr << "Failed to create ENet host" << std::endl;
-		return EXIT_FAILURE;
-	}
+// Without any player there is nothing to simulate, we only wake up this often (ms) to check the dump signal
+constexpr enet_uint32 IdleWaitTime = 1000;
 
-	entt::registry registry;
-	GoldenCarrot goldenCarrot;
-	GameData gameData(registry, goldenCarrot);
+// Traffic accounting (see NetworkStats), one JSON object per line
+constexpr const char* NetworkStatsPath = "server_netstats.jsonl";
 
-	Sel::PhysicsSystem physicsSystem(registry);
-	Sel::VelocitySystem velocitySystem(registry);
-	NetworkSystem networkSystem(registry, gameData);
-	CollectibleSystem collectibleSystem(registry, gameData);
-	physicsSystem.SetGravity({ 0.f, 0.f });
-	physicsSystem.SetDamping(0.9f);
+// The tick profile of every room is printed this often
+constexpr std::chrono::seconds ProfileReportInterval(10);
 
-	for (;;)
+// What the simulation thread knows about each ENetPeer, indexed by ENetPeer::incomingPeerID
+struct PeerConnection
+{
+	Room* room = nullptr;
+	enet_uint32 connectId = 0; //< connection our packets are meant for, kept after the disconnection so late packets are dropped
+};
+
+// usage: BrawlerServer [--record <directory>]    every room records what drives it to <directory>/room<index>.brr
+//        BrawlerServer --replay <file>           runs a recorded room again, without any network and as fast as possible
+//        [--room-size <players>]                 players a room holds before the next ones open a new room (every player the host accepts by default)
+//        [--state-budget <bytes>]                state update bytes each player may receive per snapshot (both modes)
+//        [--log-level <level>]                   debug, info (default), warning or error: least important messages logged (both modes)
+int main(int argc, char** argv)
+{
+	std::string recordDirectory;
+	std::string replayFile;
+	std::size_t roomSize = Room::MaxPlayerCount;
+	std::size_t stateBudget = NetworkSystem::DefaultStateBudget;
+	for (int i = 1; i + 1 < argc; i += 2)
 	{
-		float now = gameData.clock.GetElapsedTime();
-		float nowCollectible = gameData.collectibleClock.GetElapsedTime();
-		float nowKill = gameData.killClock.GetElapsedTime();
-
-		ENetEvent event;
-		if (enet_host_service(host, &event, 1) > 0) //< On met une milliseconde d'attente pour viter que notre serveur ne bouffe tout le processeur
+		std::string option = argv[i];
+		if (option == "--record")
+			recordDirectory = argv[i + 1];
+		else if (option == "--replay")
+			replayFile = argv[i + 1];
+		else if (option == "--room-size")
 		{
-			// On dpile tous les vnements
-			// enet_host_check_events permet de rcuprer les vnements sans faire tourner la couche rseau d'ENet (la meilleure approche est donc d'appeler enet_host_service une fois puis enet_host_check_events tant que celle-ci renvoie une valeur suprieure  zro)
-
-			do
+			char* end;
+			unsigned long value = std::strtoul(argv[i + 1], &end, 10);
+			if (*end != '\0' || value == 0 || value > Room::MaxPlayerCount)
 			{
-				switch (event.type)
-				{
-				case ENET_EVENT_TYPE_CONNECT:
-				{
-					if (gameData.players.empty()) {
-						// Reserve space for players (you could adjust this based on your needs)
-						gameData.players.reserve(25);
-					}
-
-					// If the players vector is already full, refuse the connection
-					if (gameData.players.size() >= gameData.players.capacity()) {
-						std::cout << "Connection refused: player limit reached" << std::endl;
-						enet_peer_disconnect_now(event.peer, 0); // Disconnect the peer immediately
-						break; // Exit the connection handling
-					}
-
-					// On enregistre le joueur en lui attribuant un id
-					// On cherche ici le premier ID libre
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(), [&](const Player& player) { return player.peer == nullptr; });
-					if (it == gameData.players.end())
-					{
-						// Pas de slot libre, on en rajoute un
-						auto& player = gameData.players.emplace_back();
-						player.index = gameData.players.size() - 1;
-						it = gameData.players.end() - 1; //< end() renvoie un itrateur sur l'lment aprs le dernier lment du tableau, on soustrait pour rcuprer un itrateur sur le dernier lment
-					}
-
-					Player& player = *it;
-					player.color = Sel::Color{ (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, 1.f }; //< On associe une couleur alatoire
-					player.peer = event.peer; //< On associe le joueur  son peer
-					player.name.clear();
-
-					// Someone join so he is not ready. Stop the game start countdown
-					if (gameData.gamesState == GameState::Lobby)
-					{
-						gameData.allReady = false;
-					}
-
-
-					std::cout << "Player connected" << std::endl;
-					break;
-				}
-
-				case ENET_EVENT_TYPE_DISCONNECT:
-				case ENET_EVENT_TYPE_DISCONNECT_TIMEOUT:
-				{
-					// Un joueur s'est dconnect
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(), [&](const Player& player) { return player.peer == event.peer; });
-					assert(it != gameData.players.end());
-
-					Player& player = *it;
-
-					std::cout << "Player #" << player.index << " (" << player.name << ") disconnected from server" << std::endl;
-
-					// On enlve son peer (pour rendre son slot disponible)
-					player.peer = nullptr;
-
-					// On delete son brawler
-					player.brawler.reset();
-					if (player.ownBrawlerNetworkId)
-					{
-						auto it = gameData.networkToEntity.find(*(player.ownBrawlerNetworkId));
-						if (it != gameData.networkToEntity.end())
-						{
-							entt::handle entityHandle = it->second;
-
-							// S'il avait la golden carrot on la remet en jeu  l'emplacement de la mort
-							if (&(gameData.goldenCarrot) && gameData.goldenCarrot.owningBrawlerId == player.ownBrawlerNetworkId)
-							{
-								// On notifie tout le monde
-								GoldenEventPacket packet;
-								packet.eventType = GoldenEventPacket::GoldenEventType::Released;
-
-								packet.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
-
-								for (auto& player : gameData.players)
-								{
-									if (!player.peer)
-										continue;
-
-									enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-								}
-
-								gameData.goldenCarrot.handle.try_get<Sel::Transform>()->SetPosition(entityHandle.try_get<Sel::Transform>()->GetPosition());
-								gameData.goldenCarrot.owningBrawlerId.reset();
-
-							}
-
-							gameData.registry.destroy(entityHandle);
-
-							gameData.networkToEntity.erase(it);
-
-						}
-					}
-
-					player.ownBrawlerNetworkId.reset();
-
-					// Supprimer le joueur de gameData.playingPlayers et gameData.leaderBoard
-					gameData.playingPlayers.erase(
-						std::remove(gameData.playingPlayers.begin(), gameData.playingPlayers.end(), &player),
-						gameData.playingPlayers.end()
-					);
-
-					gameData.leaderBoard.erase(
-						std::remove(gameData.leaderBoard.begin(), gameData.leaderBoard.end(), &player),
-						gameData.leaderBoard.end()
-					);
-
-					update_leaderboard(gameData);
-
-
-					// On renvoie la liste des joueurs  tous les joueurs (si ce joueur avait un nom)
-					if (!player.name.empty())
-					{
-						ENetPacket* playerListPacket = build_playerlist_packet(gameData);
-
-						for (const Player& player : gameData.players)
-						{
-							if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-								enet_peer_send(player.peer, 0, playerListPacket);
-						}
-					}
-					break;
-				}
-
-				case ENET_EVENT_TYPE_RECEIVE:
-				{
-					auto it = std::find_if(gameData.players.begin(), gameData.players.end(), [&](const Player& player) { return player.peer == event.peer; });
-					assert(it != gameData.players.end());
-
-					Player& player = *it;
-
-					// On a reu un message ! Traitons-le
-					std::vector<std::uint8_t> content(event.packet->dataLength); //< On copie son contenu dans un std::vector pour plus de facilit de gestion
-					std::memcpy(content.data(), event.packet->data, event.packet->dataLength);
-
-					// On gre le message qu'on a reu
-					handle_message(player, content, gameData, networkSystem);
+				std::cerr << "Invalid room size " << argv[i + 1] << " (1 to " << Room::MaxPlayerCount << ")" << std::endl;
+				return EXIT_FAILURE;
+			}
 
-					// On n'oublie pas de librer le packet
-					enet_packet_destroy(event.packet);
-					break;
-				}
-				}
-			} while (enet_host_check_events(host, &event) > 0);
+			roomSize = value;
 		}
-		
-
-		// On vrifie si assez de temps s'est coul pour faire avancer la logique du jeu
-		if (now >= gameData.nextTick)
+		else if (option == "--state-budget")
 		{
-			//worldLimit.Update();
-
-			// On met  jour la logique du jeu
-			tick(gameData, physicsSystem, velocitySystem, networkSystem, collectibleSystem);
-
-			if (gameData.gamesState == GameState::GameRunning)
+			char* end;
+			unsigned long value = std::strtoul(argv[i + 1], &end, 10);
+			if (*end != '\0' || value == 0)
 			{
-				auto brawlerView = gameData.registry.view<BrawlerFlag>(entt::exclude<DeadFlag>);
-				int brawlerCount = std::distance(brawlerView.begin(), brawlerView.end());
-
-				if (brawlerCount <= 1)
-				{
-					// There's only one brawler left, find it
-					for (auto entity : brawlerView)
-					{
-						// Get the NetworkComponent of the last remaining brawler
-						auto& networkComp = gameData.registry.get<NetworkedComponent>(entity);
-						auto lastNetworkID = networkComp.networkId;
-
-						// Find the player whose ownBrawlerNetworkID matches lastNetworkID
-						auto it = std::find_if(gameData.playingPlayers.begin(), gameData.playingPlayers.end(),
-							[&lastNetworkID](Player* player)
-							{
-								return player->ownBrawlerNetworkId == lastNetworkID;
-							});
-
-						if (it != gameData.playingPlayers.end())
-						{
-							// Store the last winner in gameData
-							gameData.lastWinner = *it;
-
-							std::cout << gameData.lastWinner->name << " wins -> END GAME" << std::endl;
-						}
-					}
-
-					gameData.gamesState = GameState::EndScreen;
-					end_game(gameData);
-				}
-				else
-				{
-					// Spawn de la carotte legendaire
-					if (brawlerCount > 0 && gameData.goldenCarrot.goldenCarrotClock.GetElapsedTime() >= gameData.goldenCarrot.spawnTime && !gameData.goldenCarrot.isSpawned)
-					{
-						gameData.goldenCarrot.handle = spawn_collectible(gameData, CollectibleType::GoldenCarrot);
-						gameData.goldenCarrot.isSpawned = true;
-
-						// On notifie tout le monde
-						GoldenEventPacket packet;
-						packet.eventType = GoldenEventPacket::GoldenEventType::Spawn;
-
-						for (auto& player : gameData.players)
-						{
-							if (!player.peer)
-								continue;
-
-							enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-						}
-					}
-
-					// Add point to the brawler owning the golden carrot
-					if (
-						brawlerCount > 0
-						&& gameData.goldenCarrot.isSpawned
-						&& gameData.goldenCarrot.owningBrawlerId.has_value()
-						&& gameData.goldenCarrot.pointPulseClock.GetElapsedTime() >= gameData.goldenCarrot.pulseTime
-						)
-					{
-						// Find the player controlling the brawler and send him a packet to notify he got a collectible
-						auto it = std::find_if(gameData.players.begin(), gameData.players.end(), [&](const Player& player) { return player.ownBrawlerNetworkId == gameData.goldenCarrot.owningBrawlerId; });
-						if (it != gameData.players.end());
-						{
-							Player& player = *it;
-
-							// Update its score
-							player.playerScore++;
-						}
-						gameData.goldenCarrot.pointPulseClock.Restart();
-
-						update_leaderboard(gameData);
-					}
-
-					std::size_t collectibleCount = gameData.registry.view<CollectibleFlag>().size();
-
-					// On check s'il y a au moins un brawler et si le nombre de collectibles est inferieur au maximum autorise
-					if (brawlerCount > 0 && collectibleCount < gameData.collectibleMaxCount)
-					{
-						if (now >= gameData.nextCollectibleSpawn)
-						{
-							spawn_collectible(gameData);
-							/*std::cout << "Spawn Collectible now - " << collectibleCount + 1 << std::endl;*/
-							gameData.nextCollectibleSpawn = now + gameData.collectibleSpawnInterval;  // Prochain spawn X seconds apres mtnt
-						}
-					}
-
-					// System qui kill le dernier  interval rgulier
-					if (brawlerCount > 0 && nowKill >= gameData.nextKill)
-					{
-
-						for (auto it = gameData.leaderBoard.rbegin(); it != gameData.playingPlayers.rend(); ++it)
-						{
-							if ((*it)->isDead)
-								continue;
-
-							// Set the player as dead
-							(*it)->isDead = true;
-
-							std::cout << (*it)->name << "'s brawler has been killed" << std::endl;
-
-							if (!(*it)->ownBrawlerNetworkId)
-								continue;
-
-							// Find the brawler associated with this player in the NetworkToEntities map
-							auto entityIt = gameData.networkToEntity.find((*it)->ownBrawlerNetworkId.value());
-							if (entityIt != gameData.networkToEntity.end())
-							{
-								// Add DeadFlag to the entity
-								gameData.registry.emplace_or_replace<DeadFlag>(entityIt->second);
-
-								Sel::Vector2f deathPosition;
-								std::int8_t deathScaleX = 1.f;
-								auto transform = gameData.registry.try_get<Sel::Transform>(entityIt->second);
-								if (transform)
-								{
-									deathPosition = transform->GetGlobalPosition();
-									deathScaleX = transform->GetScale().x;
-									transform->SetPosition({ -20000.f, -20000.f }); // On le place trs loin
-								}
-
-								update_leaderboard(gameData);
-
-								// S'il avait la golden carrot on la remet en jeu
-								if (gameData.goldenCarrot.owningBrawlerId == (*it)->ownBrawlerNetworkId)
-								{
-									// On notifie tout le monde
-									GoldenEventPacket packet;
-									packet.eventType = GoldenEventPacket::GoldenEventType::Released;
-
-									packet.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
-
-									for (auto& player : gameData.players)
-									{
-										if (!player.peer)
-											continue;
-
-										enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-									}
-
-									gameData.goldenCarrot.handle.try_get<Sel::Transform>()->SetPosition(deathPosition);
-									gameData.goldenCarrot.owningBrawlerId.reset();
-								}
-
-								// On notifie tout les joueurs de cette mort
-								BrawlerDeathPacket packet;
-								packet.playerId = (*it)->index;
-								packet.brawlerId = (*it)->ownBrawlerNetworkId.value();
-								packet.deathPosition = deathPosition;
-								packet.deathScaleX = deathScaleX;
-
-								for (auto& player : gameData.playingPlayers)
-								{
-									if (!player->peer)
-										continue;
-
-									enet_peer_send(player->peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-								}
-							}
-
-							break;
-						}
-
-						gameData.nextKill = nowKill + gameData.killInterval;
-					}
-
-
-				}
-
-
-				
+				std::cerr << "Invalid state budget " << argv[i + 1] << std::endl;
+				return EXIT_FAILURE;
 			}
 
-			// On prvoit la prochaine mise  jour
-			gameData.nextTick += gameData.tickInterval;
-		}	
-
-		// Countdown until game starts when all brawlers are ready
-		float nowStartGameCountdown = gameData.gameStartClock.GetElapsedTime();
-		if (gameData.gamesState == GameState::Lobby && gameData.allReady && nowStartGameCountdown >= 5.0f)
+			stateBudget = value;
+		}
+		else if (option == "--log-level")
 		{
-			gameData.allReady = false;
-			gameData.gamesState = GameState::GameRunning;
-
-			start_game(gameData);
-
-			gameData.killClock.Restart();
-			std::cout << "START GAME!" << std::endl;
-
-
-			UpdateGameStatePacket packet;
-			packet.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
-
-			for (const auto& player : gameData.playingPlayers)
+			std::string level = argv[i + 1];
+			if (level == "debug")
+				Logger::Instance().SetMinLevel(LogLevel::Debug);
+			else if (level == "info")
+				Logger::Instance().SetMinLevel(LogLevel::Info);
+			else if (level == "warning")
+				Logger::Instance().SetMinLevel(LogLevel::Warning);
+			else if (level == "error")
+				Logger::Instance().SetMinLevel(LogLevel::Error);
+			else
 			{
-				if (!player->peer)
-					continue;
-
-				enet_peer_send(player->peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+				std::cerr << "Invalid log level " << level << std::endl;
+				return EXIT_FAILURE;
 			}
 		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
 	}
 
-	return EXIT_SUCCESS;
-}
-
-ENetPacket* build_playerlist_packet(GameData& gameData)
-{
-	// Construisons le packet de liste de joueur
-	PlayerListPacket packet;
-	for (const Player& player : gameData.players)
+	if (enet_initialize() != 0)
 	{
-		if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-		{
-			// Oui, rajoutons-le  la liste
-			auto& packetPlayer = packet.players.emplace_back();
-			packetPlayer.name = player.name;
-			if (player.ownBrawlerNetworkId.has_value())
-			{
-				packetPlayer.id = player.index;
-				packetPlayer.hasBrawler = true;
-				packetPlayer.isDead = player.isDead;
-				packetPlayer.brawlerId = player.ownBrawlerNetworkId.value();
-			}
-			else
-			{
-				packetPlayer.id = player.index;
-				packetPlayer.hasBrawler = false;
-				packetPlayer.isDead = player.isDead;
-				packetPlayer.brawlerId.reset();
-			}
-		}
+		std::cout << "Failed to initialize ENet" << std::endl;
+		return EXIT_FAILURE;
 	}
 
-	return build_packet(packet, ENET_PACKET_FLAG_RELIABLE);
-}
+	if (!replayFile.empty())
+		return run_replay(replayFile, stateBudget);
 
-void handle_message(Player& player, const std::vector<std::uint8_t>& message, GameData& gameData, NetworkSystem& networkSystem)
-{
-	// On traite les messages reus par un joueur, diffrencis par l'opcode
-	std::size_t offset = 0;
+	// Cration de l'hte serveur
+	ENetAddress address;
+	enet_address_build_any(&address, ENET_ADDRESS_TYPE_IPV6);
+	address.port = AppPort;
 
-	Opcode opcode = static_cast<Opcode>(Deserialize_u8(message, offset));
-	switch (opcode)
+	ENetHost* host = enet_host_create(ENET_ADDRESS_TYPE_ANY, &address, MaxPlayers, 0, 0, 0);
+	if (!host)
 	{
-		case Opcode::C_PlayerName:
-		{
-			PlayerNamePacket playerName = PlayerNamePacket::Deserialize(message, offset);
+		std::cerr << "Failed to create ENet host" << std::endl;
+		return EXIT_FAILURE;
+	}
 
-			// On rduit la taille du nom si elle est trop longue pour viter les petits malins (oui je vous voir venir)
-			if (playerName.name.size() > MaxPlayerNameLength)
-				playerName.name.resize(MaxPlayerNameLength);
+	std::ofstream networkStatsFile(NetworkStatsPath, std::ios::app);
+	if (!networkStatsFile)
+		std::cerr << "Failed to open " << NetworkStatsPath << ", network stats won't be written" << std::endl;
 
-			std::cout << "Player #" << player.index << " is " << playerName.name << std::endl;
-			player.name = playerName.name;
+	// ENet is serviced by its own thread, this one runs the simulation and takes part in the room updates, the workers run the other rooms
+	NetworkThread networkThread(host, networkStatsFile ? &networkStatsFile : nullptr);
 
-			// Envoyons la liste des joueurs
-			ENetPacket* playerListPacket = build_playerlist_packet(gameData);
+	WorkerPool workerPool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	log_info("Rooms are updated by {} threads", workerPool.GetWorkerCount() + 1);
 
-			for (const Player& player : gameData.players)
-			{
-				if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-					enet_peer_send(player.peer, 0, playerListPacket);
-			}
+	std::vector<std::unique_ptr<Room>> rooms;
+	std::vector<PeerConnection> peerConnections(host->peerCount);
+	std::vector<Room*> updatedRooms;
 
-			// On cr toutes les entits de son ct
-			networkSystem.CreateAllEntities(player.peer);
+	// Counters are dumped on demand: kill -USR1 <pid> (Ctrl+Break on Windows)
+#ifdef _WIN32
+	std::signal(SIGBREAK, &on_dump_signal);
+#else
+	std::signal(SIGUSR1, &on_dump_signal);
+#endif
 
-			// On lui envoie l'tat du jeu et par consquent son player mode
-			UpdateGameStatePacket gameStatePacket;
-			gameStatePacket.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+	auto nextProfileReport = std::chrono::steady_clock::now() + ProfileReportInterval;
 
-			UpdatePlayerModePacket playerModePacket;
-			if (gameData.gamesState == GameState::Lobby)
-			{
-				player.isDead = false;
-				playerModePacket.newPlayerMode = static_cast<std::uint8_t>(PlayerMode::Playing);
-			}
-			else
+	for (;;)
+	{
+		// No room is being updated here, reading their counters is safe
+		if (s_dumpMessageCounters)
+		{
+			s_dumpMessageCounters = 0;
+			for (const auto& room : rooms)
 			{
-				player.isDead = true;
-				playerModePacket.newPlayerMode = static_cast<std::uint8_t>(PlayerMode::Spectating);
+				room->DumpCounters(std::cout);
+				room->DumpProfile(std::cout);
+				room->DumpInputs(std::cout);
+				room->DumpReplication(std::cout);
 			}
-
-			enet_peer_send(player.peer, 0, build_packet(playerModePacket, ENET_PACKET_FLAG_RELIABLE));
-			//enet_peer_send(player.peer, 0, build_packet(gameStatePacket, ENET_PACKET_FLAG_RELIABLE));
-
-			break;
 		}
-		case Opcode::C_CreateBrawlerRequest:
-		{
-			std::cout << "Player " << player.name << " wants to spawn its brawler" << std::endl;
-
-			// On cree le brawler cot serveur
-			Brawler brawler(gameData.registry, Sel::Vector2f(0.f, 0.f), 0.f, 1.f, Sel::Vector2f(10.f, 0.f));
-
-			//skin
-			srand(time(0));
-			player.skinIndex = (int)rand() % 3 + 1;
 
-			// on lui donne l'id de son player
-			auto flag = brawler.GetHandle().try_get<BrawlerFlag>();
-			if (flag)
+		if (std::chrono::steady_clock::now() >= nextProfileReport)
+		{
+			nextProfileReport += ProfileReportInterval;
+			for (const auto& room : rooms)
 			{
-				flag->playerId = player.index;
-				flag->skinId = player.skinIndex;
+				if (room->GetPlayerCount() > 0)
+				{
+					room->DumpProfile(std::cout);
+					room->DumpInputs(std::cout);
+					room->DumpReplication(std::cout);
+				}
 			}
-
-			auto network = brawler.GetHandle().try_get<NetworkedComponent>();
-			if (!network)
-				break;
-
-			// On l'ajoute  la liste d'entit
-			gameData.networkToEntity[network->networkId] = brawler.GetHandle();
-
-			// On renvois au createur l'id rseaux de son brawler
-			UpdateSelfBrawlerId updateSelfBrawlerIdPacket;
-			updateSelfBrawlerIdPacket.id = network->networkId;
-
-			enet_peer_send(player.peer, 0, build_packet(updateSelfBrawlerIdPacket, ENET_PACKET_FLAG_RELIABLE));
-
-			player.ownBrawlerNetworkId = network->networkId;
-			player.brawler = std::move(brawler);
-
-			
-
-			break;
 		}
-		case Opcode::C_PlayerInputs:
-		{
-			PlayerInputsPacket packet = PlayerInputsPacket::Deserialize(message, offset);
-
-			if (!player.brawler)
-				break;
 
-			// On applique ses input si son brawler n'est pas mort
-			if(!player.isDead && gameData.gamesState != GameState::EndScreen)
-				player.brawler->ApplyInputs(packet.inputs);
+		// We sleep until the network thread receives something or until the next tick of a room is due (every game timer is a tick deadline, so nothing can happen before it)
+		enet_uint32 waitTime = IdleWaitTime;
+		for (const auto& room : rooms)
+			waitTime = std::min(waitTime, room->GetWaitTime());
 
+		if (waitTime > 0)
+			networkThread.WaitForEvents(waitTime);
 
-			break;
-		}
-		case Opcode::C_PlayerReady:
+		// Events are only taken here, before the rooms are updated: a message received before this point is handled before the ticks of this update
+		NetworkEvent event;
+		while (networkThread.PollEvent(event))
 		{
-			PlayerReadyPacket packet = PlayerReadyPacket::Deserialize(message, offset);
+			PeerConnection& connection = peerConnections[event.peer->incomingPeerID];
 
-			if (gameData.gamesState == GameState::EndScreen)
+			switch (event.type)
 			{
-				gameData.gamesState = GameState::Lobby;
-
-				// On ramne tout le monde au centre
-				auto view = gameData.registry.view<Sel::Transform, BrawlerFlag>();
-				for (auto&& [entity, transform, flag] : view.each())
+			case ENET_EVENT_TYPE_CONNECT:
+			{
+				// The player joins the first room which isn't full, a new one is opened if they all are
+				auto it = std::find_if(rooms.begin(), rooms.end(), [](const std::unique_ptr<Room>& room) { return !room->IsFull(); });
+				if (it == rooms.end())
 				{
-					transform.SetPosition(Sel::Vector2f(0.f, 0.f));
+					rooms.push_back(std::make_unique<Room>(rooms.size(), std::random_device{}()));
+					it = rooms.end() - 1;
+					(*it)->SetMaxPlayerCount(roomSize);
+					(*it)->SetStateBudget(stateBudget);
 
-					if (gameData.registry.all_of<DeadFlag>(entity))
-						gameData.registry.remove<DeadFlag>(entity);
-				}
+					log_info("Room #{} opened", (*it)->GetIndex());
 
-				UpdateGameStatePacket packet;
-				packet.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
-				
-				for (auto& player : gameData.players)
-				{
-					if (!player.peer)
-						continue;
-							
-					player.isReady = false;
-					player.isDead = false;
-					enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+					if (!recordDirectory.empty())
+					{
+						std::string recordPath = recordDirectory + "/room" + std::to_string((*it)->GetIndex()) + ".brr";
+						try
+						{
+							(*it)->StartRecording(recordPath);
+							log_info("Room #{} is recorded to {}", (*it)->GetIndex(), recordPath);
+						}
+						catch (const std::exception& e)
+						{
+							log_error("Room #{} won't be recorded: {}", (*it)->GetIndex(), e.what());
+						}
+					}
 				}
 
+				Room& room = **it;
+				connection.room = &room;
+				connection.connectId = event.connectId;
+				room.HandleConnect(event.peer);
 				break;
 			}
 
-			std::cout << "player " << player.index << " ready state is: " << static_cast<int>(packet.newReadyValue) << std::endl;
-			player.isReady = packet.newReadyValue;
-
-
-			// Qqn se met pas prt
-			if (!packet.newReadyValue)
+			case ENET_EVENT_TYPE_DISCONNECT:
+			case ENET_EVENT_TYPE_DISCONNECT_TIMEOUT:
 			{
-				gameData.allReady = false;
+				assert(connection.room);
+
+				connection.room->HandleDisconnect(event.peer);
+				connection.room = nullptr;
 				break;
 			}
 
-			bool allReady = true;
-			for (const auto& player : gameData.players)
+			case ENET_EVENT_TYPE_RECEIVE:
 			{
-				if (!player.peer)
-				{
-					continue;
-				}
-
-				if (player.isReady)
-					continue;
+				assert(connection.room);
 
-				allReady = false;
+				// Handled during the next update of the room, which destroys the packet
+				connection.room->PushMessage(event.peer, event.packet);
 				break;
 			}
 
-			if (allReady)
-			{
-				gameData.gameStartClock.Restart();
-				gameData.allReady = true;
+			case ENET_EVENT_TYPE_NONE:
+				break;
 			}
-
-			break;
 		}
 
-		case Opcode::C_PlayerStealRequest:
+		// Rooms with messages to handle or ticks to run are updated in parallel, they don't share anything
+		updatedRooms.clear();
+		for (const auto& room : rooms)
 		{
-			PlayerStealPacketRequest packet = PlayerStealPacketRequest::Deserialize(message, offset);
-
-			// On informe tout le monde qu'un brawler tente un vol (pour jouer l'animation chez tous les clients)
-			PlayerStealPacket stealPacket;
-			stealPacket.brawlerId = packet.brawlerId;
-
-			for (auto& playingPlayer : gameData.playingPlayers)
-			{
-				if (!playingPlayer->peer /*|| player.peer == playingPlayer->peer*/)
-					continue;
-
-				enet_peer_send(playingPlayer->peer, 0, build_packet(stealPacket, ENET_PACKET_FLAG_RELIABLE));
-			}
-
-			
-			if (!gameData.goldenCarrot.isSpawned || !gameData.goldenCarrot.owningBrawlerId.has_value())
-				break;
-
-			auto itStealer = gameData.networkToEntity.find(packet.brawlerId);
-			if (itStealer == gameData.networkToEntity.end())
-				break;
-
-			if (itStealer->first == gameData.goldenCarrot.owningBrawlerId.value()) // Le voler est deja le detenteur de la carotte
-				break;
-
-			Sel::Vector2f transformStealerPosition = itStealer->second.try_get<Sel::Transform>()->GetGlobalPosition();
-
-			auto view = gameData.registry.view<Sel::Transform, BrawlerFlag, NetworkedComponent>(entt::exclude<DeadFlag>);
-			for (auto&& [entity, transform, flag, network] : view.each())
-			{
-				if (network.networkId != gameData.goldenCarrot.owningBrawlerId.value()) // Ce brawler n'a pas la golden carotte. Pas ncessaire de checker si on en est assez proche pour le voler
-					continue; 
-
-				Sel::Vector2f transformPosition = gameData.registry.try_get<Sel::Transform>(entity)->GetGlobalPosition();
-
-				if ((transformStealerPosition - transformPosition).Magnitude() <= 100.f)
-				{
-					// On notifie tout le monde
-					GoldenEventPacket goldenEventPacket;
-					goldenEventPacket.eventType = GoldenEventPacket::GoldenEventType::Steal;
-
-					goldenEventPacket.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
-					goldenEventPacket.newOwner = packet.brawlerId;
-
-					for (auto& player : gameData.players)
-					{
-						if (!player.peer)
-							continue;
-
-						enet_peer_send(player.peer, 0, build_packet(goldenEventPacket, ENET_PACKET_FLAG_RELIABLE));
-					}
-
-					std::cout << "steal" << std::endl;
-					gameData.goldenCarrot.goldenCarrotClock.Restart();
-					gameData.goldenCarrot.owningBrawlerId = packet.brawlerId;
-
-					break; // Il n'y a qu'un seul porteur de golden carotte et on viens de le trouver. on sort de la boucle
-				}
-				else
-				{
-					std::cout << "no steal" << std::endl;
-				}
-
-			}
-
-			break;
+			if (room->HasWork())
+				updatedRooms.push_back(room.get());
 		}
-	}
-}
-
-
 
-void tick(GameData& gameData, Sel::PhysicsSystem& physicsSystem, Sel::VelocitySystem& velocitySystem, NetworkSystem& networkSystem, CollectibleSystem& collectibleSystem)
-{
-	// On fait avancer le monde
-	//physicsSystem.Update(TickDelay);
-	velocitySystem.Update(TickDelay);
-	networkSystem.Update();
-
-	auto view = gameData.registry.view<Sel::Transform, BrawlerFlag>(entt::exclude<DeadFlag>);
-	for (auto&& [entity, transform, flag] : view.each())
-	{
-		Sel::Vector2f position = transform.GetPosition();
+		workerPool.ParallelFor(updatedRooms.size(), [&](std::size_t roomIndex) { updatedRooms[roomIndex]->Update(); });
 
-		// Clamp the position between -1000.f and 1000.f for each axis
-		position.x = std::clamp(position.x, -1000.f, 1000.f);
-		position.y = std::clamp(position.y, -1000.f, 1000.f);
-
-		// Set the clamped position back to the transform
-		transform.SetPosition(position);
-	}
-
-	if (gameData.gamesState == GameState::GameRunning)
-	{
-		// Update the collectible system and modify leaderbaord if one collection occured (return true) 
-		if (collectibleSystem.Update(gameData))
+		// Every room may have queued packets (a disconnection is handled right away), the network thread sends them
+		for (const auto& room : rooms)
 		{
-			std::cout << "update leaderboard" << std::endl;
+			for (const OutgoingPacket& outgoing : room->GetOutbox())
+				networkThread.Send(outgoing, peerConnections[outgoing.peer->incomingPeerID].connectId);
 
-			update_leaderboard(gameData);
+			room->ClearOutbox();
 		}
-	}
-}
 
-entt::handle spawn_collectible(GameData& gameData, const CollectibleType& type)
-{
-	entt::entity newCollectible = gameData.registry.create();
-
-	// random spawn position
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_real_distribution<float> disX(-900.f, 900.f);
-	std::uniform_real_distribution<float> disY(-900.f, 900.f);
-
-	float spawnX = disX(gen);
-	float spawnY = disY(gen);
-
-	auto& transform = gameData.registry.emplace<Sel::Transform>(newCollectible);
-	if(type == CollectibleType::GoldenCarrot)
-		transform.SetPosition({ 0.f, 0.f });
-	else
-		transform.SetPosition({ spawnX, spawnY });
-	transform.SetRotation(0.f);
-	transform.SetScale({ 1.f, 1.f });
-
-	// The server synchronize position of the entity with velocity component. 
-	// Sometimes the golden carrot is moved in/out the game space when it's catch/released instead of instantiate/destroyed
-	// So I add it that velocity component even if it is not really moving so that in/out get sync on client 
-	// That might be not clean
-	if (type == CollectibleType::GoldenCarrot) 
-	{
-		auto& velocity = gameData.registry.emplace<Sel::VelocityComponent>(newCollectible);
-		velocity.linearVel = { 0.f, 0.f };
+		// The network thread waits for this (or its own deadline) before sending them
+		networkThread.Flush();
 	}
 
-	auto& network = gameData.registry.emplace<NetworkedComponent>(newCollectible);
-
-	auto& collectibleFlag = gameData.registry.emplace<CollectibleFlag>(newCollectible);
-	collectibleFlag.type = type;
-
-	if(type == CollectibleType::GoldenCarrot)
-		gameData.registry.emplace<GoldenCarrotFlag>(newCollectible);
-
-	// On cre un handle
-	entt::handle handle = entt::handle(gameData.registry, newCollectible);
-
-	// On l'ajoute  la liste d'entit
-	gameData.networkToEntity[network.networkId] = handle;
-
-	return handle;
+	return EXIT_SUCCESS;
 }
 
-void start_game(GameData& gameData)
+void on_dump_signal(int /*signal*/)
 {
-	gameData.playingPlayers.clear();
-	gameData.leaderBoard.clear();
-
-	for (auto& player : gameData.players)
-	{
-		if (player.name.empty() || !player.peer || !player.ownBrawlerNetworkId)
-			continue;
-
-		player.playerScore = 0;
-		player.isDead = false;
-
-		gameData.playingPlayers.push_back(&player);
-		gameData.leaderBoard.push_back(&player);
-	}
-
-	float goldenCarrotSpawnTime = static_cast<int>(gameData.playingPlayers.size() * 0.5f) * gameData.killInterval + 4.0f; // 4 sec aprs que la moiti des joueurs soient morts
-	//float goldenCarrotSpawnTime = 5.f;
-
-	gameData.goldenCarrot.goldenCarrotClock.Restart();
-	gameData.goldenCarrot.spawnTime = goldenCarrotSpawnTime;
-
-	gameData.killClock.Restart();
-	gameData.nextKill = gameData.killInterval;
-
-	update_leaderboard(gameData);
+	s_dumpMessageCounters = 1;
 }
 
-void end_game(GameData& gameData)
+int run_replay(const std::string& filePath, std::size_t stateBudget)
 {
-	// destroy all collectibles remaining
-	auto collectiblesView = gameData.registry.view<CollectibleFlag>();
-	for (auto collectible : collectiblesView)
+	try
 	{
-		gameData.registry.destroy(collectible);
-	}
+		ReplayReader reader(filePath);
+		Room room(0, reader.GetSeed());
+		room.SetStateBudget(stateBudget);
 
-	// stop movement in case of need (i.e. brawler has been killed but last input received indicate it has to move)
-	auto view = gameData.registry.view<Sel::VelocityComponent>();
-	for (auto&& [entity, velocity] : view.each())
-	{
-		velocity.linearVel = Sel::Vector2f(0.f, 0.f);
-	}
+		// The room only uses its peers to tell its players apart, one fake peer per slot stands for them
+		std::vector<ENetPeer> peers(Room::MaxPlayerCount);
+		for (std::size_t i = 0; i < peers.size(); ++i)
+			peers[i].incomingPeerID = static_cast<enet_uint16>(i);
 
-	// reset golden carrot
-	gameData.goldenCarrot.isSpawned = false;
-	gameData.goldenCarrot.owningBrawlerId.reset();
+		// The game logs would take most of the time
+		Logger::Instance().SetMinLevel(LogLevel::Off);
 
-	// Notifions tout le monde qu'il y a un gagnant
-	WinnerPacket packet;
-	packet.brawlerNetworkId = gameData.lastWinner->index;
+		std::uint64_t recordCount = 0;
+		std::uint64_t tickCount = 0;
+		auto start = std::chrono::steady_clock::now();
 
-	UpdateGameStatePacket gameStatePacket;
-	gameStatePacket.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+		ReplayRecord record;
+		while (reader.Read(record))
+		{
+			if (record.slot >= peers.size())
+				throw std::runtime_error("invalid player slot in replay");
 
-	for (auto& player : gameData.playingPlayers)
-	{
-		if (!player->peer)
-			continue;
+			room.Replay(record, &peers[record.slot]);
 
-		enet_peer_send(player->peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
-		enet_peer_send(player->peer, 0, build_packet(gameStatePacket, ENET_PACKET_FLAG_RELIABLE));
-	}
+			recordCount++;
+			if (record.type == ReplayRecordType::Update)
+				tickCount += record.tickCount;
 
-}
-
-void update_leaderboard(GameData& gameData)
-{
-	std::stable_sort(gameData.leaderBoard.begin(), gameData.leaderBoard.end(),
-		[](const Player* a, const Player* b)
-		{
-			if (a->isDead != b->isDead) {
-				return !a->isDead; // Les joueurs morts vont  la fin
+			// Nothing is sent: the packets nobody holds a reference on are destroyed right away
+			for (const OutgoingPacket& outgoing : room.GetOutbox())
+			{
+				if (outgoing.isLastSend && outgoing.packet->referenceCount == 0)
+					enet_packet_destroy(outgoing.packet);
 			}
-			return a->playerScore > b->playerScore; // Tri par score dcroissant
-		});
+			room.ClearOutbox();
+		}
 
-	// On notifie tout le monde du changement de leadearboard
-	UpdateLeaderboardPacket packet;
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-	for (auto& playerData : gameData.leaderBoard)
-	{
-		auto& data = packet.leaderboard.emplace_back();
-		data.playerId = playerData->index;
-		data.playerName = playerData->name;
-		data.playerScore = playerData->playerScore;
-		data.isDead = playerData->isDead;
+		std::cout << "Replayed " << recordCount << " records, " << tickCount << " ticks in " << elapsed << " s (" << tickCount / elapsed << " ticks/s)" << std::endl;
+		room.DumpProfile(std::cout);
+		room.DumpInputs(std::cout);
+		room.DumpReplication(std::cout);
 	}
-
-	for (auto& player : gameData.players)
+	catch (const std::exception& e)
 	{
-		if (!player.peer)
-			continue;
-
-		enet_peer_send(player.peer, 0, build_packet(packet, ENET_PACKET_FLAG_RELIABLE));
+		std::cerr << "Replay failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
 	}
+
+	return EXIT_SUCCESS;
 }
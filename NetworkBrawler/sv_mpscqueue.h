@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue between any number of producer threads and one consumer thread (the rooms' threads and the logger thread).
+// Each cell has a sequence number telling whether it's free for the writer of a given index or ready for the reader (see Dmitry Vyukov's bounded queue):
+// producers claim an index with a CAS, then publish the cell by bumping its sequence with release semantics.
+template<typename T>
+class MpscQueue
+{
+public:
+	// capacity must be a power of two
+	explicit MpscQueue(std::size_t capacity) :
+		m_cells(std::make_unique<Cell[]>(capacity)),
+		m_mask(capacity - 1),
+		m_readIndex(0),
+		m_writeIndex(0)
+	{
+		assert(capacity > 0 && (capacity & m_mask) == 0);
+
+		for (std::size_t i = 0; i < capacity; ++i)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue(MpscQueue&&) = delete;
+	~MpscQueue() = default;
+
+	std::size_t GetCapacity() const
+	{
+		return m_mask + 1;
+	}
+
+	// Consumer only: returns false if the queue is empty (or if the next value is still being written)
+	bool TryPop(T& value)
+	{
+		Cell& cell = m_cells[m_readIndex & m_mask];
+		if (cell.sequence.load(std::memory_order_acquire) != m_readIndex + 1)
+			return false;
+
+		value = std::move(cell.value);
+
+		// The cell is free again for the writer of the index one lap later
+		cell.sequence.store(m_readIndex + m_mask + 1, std::memory_order_release);
+		m_readIndex++;
+		return true;
+	}
+
+	// Any thread: returns false if the queue is full (the value is left untouched)
+	bool TryPush(T&& value)
+	{
+		std::size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[writeIndex & m_mask];
+			std::intptr_t diff = static_cast<std::intptr_t>(cell.sequence.load(std::memory_order_acquire)) - static_cast<std::intptr_t>(writeIndex);
+			if (diff == 0)
+			{
+				// The cell is free, it's ours if no other producer claimed this index in the meantime
+				if (m_writeIndex.compare_exchange_weak(writeIndex, writeIndex + 1, std::memory_order_relaxed))
+				{
+					cell.value = std::move(value);
+					cell.sequence.store(writeIndex + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false; //< the reader didn't free this cell yet
+			else
+				writeIndex = m_writeIndex.load(std::memory_order_relaxed); //< another producer got it, try the next index
+		}
+	}
+
+	MpscQueue& operator=(const MpscQueue&) = delete;
+	MpscQueue& operator=(MpscQueue&&) = delete;
+
+private:
+	struct Cell
+	{
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	// The read index is only used by the consumer, the write index is shared by the producers (on its own cache line)
+	std::unique_ptr<Cell[]> m_cells;
+	std::size_t m_mask;
+	std::size_t m_readIndex;
+	alignas(64) std::atomic<std::size_t> m_writeIndex;
+};
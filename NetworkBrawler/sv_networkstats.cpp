@@ -0,0 +1,141 @@
+#include "sv_networkstats.h"
+#include <algorithm>
+
+Reliability GetPacketReliability(const ENetPacket* packet)
+{
+	if (packet->flags & ENET_PACKET_FLAG_RELIABLE)
+		return Reliability::Reliable;
+
+	if (packet->flags & ENET_PACKET_FLAG_UNSEQUENCED)
+		return Reliability::Unsequenced;
+
+	return Reliability::Unreliable;
+}
+
+const char* GetReliabilityName(Reliability reliability)
+{
+	switch (reliability)
+	{
+		case Reliability::Reliable:    return "reliable";
+		case Reliability::Unreliable:  return "unreliable";
+		case Reliability::Unsequenced: return "unsequenced";
+	}
+
+	return "<unknown>";
+}
+
+NetworkStats::NetworkStats(ENetHost* host) :
+	m_intervalStart(std::chrono::steady_clock::now()),
+	m_peers(host->peerCount),
+	m_host(host)
+{
+}
+
+void NetworkStats::RecordConnect(const ENetPeer* peer)
+{
+	// The ENetPeer may have been used by someone else earlier during the interval
+	m_peers[peer->incomingPeerID] = Counters{};
+}
+
+void NetworkStats::RecordReceived(const ENetPeer* peer, const ENetPacket* packet)
+{
+	std::size_t size = packet->dataLength;
+
+	m_total.received.Add(size);
+	m_peers[peer->incomingPeerID].received.Add(size);
+	m_reliabilities[static_cast<std::size_t>(GetPacketReliability(packet))].received.Add(size);
+	GetOpcodeCounters(packet).received.Add(size);
+}
+
+void NetworkStats::RecordSent(const ENetPeer* peer, const ENetPacket* packet)
+{
+	std::size_t size = packet->dataLength;
+
+	m_total.sent.Add(size);
+	m_peers[peer->incomingPeerID].sent.Add(size);
+	m_reliabilities[static_cast<std::size_t>(GetPacketReliability(packet))].sent.Add(size);
+	GetOpcodeCounters(packet).sent.Add(size);
+}
+
+void NetworkStats::WriteJson(std::ostream& out)
+{
+	auto now = std::chrono::steady_clock::now();
+	double interval = std::chrono::duration<double>(now - m_intervalStart).count();
+	double timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	out.precision(3);
+	out << std::fixed << "{\"time\":" << timestamp << ",\"interval\":" << interval << ",\"total\":";
+	WriteCounters(out, m_total);
+
+	out << ",\"peers\":[";
+	bool isFirst = true;
+	for (std::size_t i = 0; i < m_host->peerCount; ++i)
+	{
+		ENetPeer& peer = m_host->peers[i];
+		if (peer.state != ENET_PEER_STATE_CONNECTED)
+			continue;
+
+		if (!isFirst)
+			out << ',';
+		isFirst = false;
+
+		// sentReliableCommands are waiting for their ack, outgoingCommands haven't been sent yet (both grow when the peer can't keep up)
+		out << "{\"id\":" << i
+		    << ",\"rtt\":" << peer.roundTripTime
+		    << ",\"rttVariance\":" << peer.roundTripTimeVariance
+		    << ",\"packetLoss\":" << static_cast<double>(peer.packetLoss) / ENET_PEER_PACKET_LOSS_SCALE
+		    << ",\"reliableInFlight\":" << enet_list_size(&peer.sentReliableCommands)
+		    << ",\"reliableBytesInFlight\":" << peer.reliableDataInTransit
+		    << ",\"outgoingQueued\":" << enet_list_size(&peer.outgoingCommands)
+		    << ",\"traffic\":";
+		WriteCounters(out, m_peers[i]);
+		out << '}';
+	}
+
+	out << "],\"opcodes\":{";
+	for (std::size_t i = 0; i < OpcodeCount; ++i)
+	{
+		if (i > 0)
+			out << ',';
+
+		out << '"' << GetOpcodeName(static_cast<Opcode>(i)) << "\":";
+		WriteCounters(out, m_opcodes[i]);
+	}
+	out << ",\"invalid\":";
+	WriteCounters(out, m_invalidOpcodes);
+
+	out << "},\"reliability\":{";
+	for (std::size_t i = 0; i < ReliabilityCount; ++i)
+	{
+		if (i > 0)
+			out << ',';
+
+		out << '"' << GetReliabilityName(static_cast<Reliability>(i)) << "\":";
+		WriteCounters(out, m_reliabilities[i]);
+	}
+	out << "}}" << std::endl;
+
+	// New interval
+	m_intervalStart = now;
+	m_opcodes.fill(Counters{});
+	m_reliabilities.fill(Counters{});
+	std::fill(m_peers.begin(), m_peers.end(), Counters{});
+	m_invalidOpcodes = Counters{};
+	m_total = Counters{};
+}
+
+NetworkStats::Counters& NetworkStats::GetOpcodeCounters(const ENetPacket* packet)
+{
+	if (packet->dataLength == 0 || packet->data[0] >= OpcodeCount)
+		return m_invalidOpcodes;
+
+	return m_opcodes[packet->data[0]];
+}
+
+void NetworkStats::WriteCounters(std::ostream& out, const Counters& counters)
+{
+	out << "{\"sentPackets\":" << counters.sent.packetCount
+	    << ",\"sentBytes\":" << counters.sent.byteCount
+	    << ",\"receivedPackets\":" << counters.received.packetCount
+	    << ",\"receivedBytes\":" << counters.received.byteCount << '}';
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "sh_protocol.h"
+#include <enet6/enet.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Reliability class of a packet, from its ENet flags
+enum class Reliability : std::uint8_t
+{
+	Reliable,
+	Unreliable, //< sequenced
+	Unsequenced
+};
+
+constexpr std::size_t ReliabilityCount = static_cast<std::size_t>(Reliability::Unsequenced) + 1;
+
+Reliability GetPacketReliability(const ENetPacket* packet);
+const char* GetReliabilityName(Reliability reliability);
+
+// Packets and bytes going through the server, per peer, per opcode and per reliability class, along with ENet's view of each peer
+// (RTT, packet loss, reliable commands waiting for their ack). Counters cover the time since the last WriteJson.
+// Network thread only: the packets are recorded when they're handed to ENet or received from it.
+class NetworkStats
+{
+public:
+	explicit NetworkStats(ENetHost* host);
+	NetworkStats(const NetworkStats&) = delete;
+	NetworkStats(NetworkStats&&) = delete;
+	~NetworkStats() = default;
+
+	void RecordConnect(const ENetPeer* peer);
+	void RecordReceived(const ENetPeer* peer, const ENetPacket* packet);
+	void RecordSent(const ENetPeer* peer, const ENetPacket* packet);
+
+	// Writes every counter as a single JSON line and resets them
+	void WriteJson(std::ostream& out);
+
+	NetworkStats& operator=(const NetworkStats&) = delete;
+	NetworkStats& operator=(NetworkStats&&) = delete;
+
+private:
+	struct Traffic
+	{
+		std::uint64_t packetCount = 0;
+		std::uint64_t byteCount = 0;
+
+		void Add(std::size_t bytes)
+		{
+			packetCount++;
+			byteCount += bytes;
+		}
+	};
+
+	struct Counters
+	{
+		Traffic sent;
+		Traffic received;
+	};
+
+	Counters& GetOpcodeCounters(const ENetPacket* packet);
+
+	static void WriteCounters(std::ostream& out, const Counters& counters);
+
+	std::array<Counters, OpcodeCount> m_opcodes;
+	std::array<Counters, ReliabilityCount> m_reliabilities;
+	std::chrono::steady_clock::time_point m_intervalStart;
+	std::vector<Counters> m_peers; //< indexed by ENetPeer::incomingPeerID
+	Counters m_invalidOpcodes; //< empty packets or unknown opcodes
+	Counters m_total;
+	ENetHost* m_host;
+};
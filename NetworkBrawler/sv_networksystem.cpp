@@ -2,126 +2,456 @@
 #include "sv_networkedcomponent.h"
 #include "sh_protocol.h"
 #include "sh_constants.h"
+#include "sv_broadcast.h"
 #include "sv_gamedata.h"
 #include <Sel/RigidBodyComponent.hpp>
 #include <Sel/Transform.hpp>
 #include <entt/entt.hpp>
 #include <Sel/VelocityComponent.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 NetworkSystem::NetworkSystem(entt::registry& registry, GameData& gameData) :
-	m_networkObserver(registry, entt::collector.group<Sel::Transform, NetworkedComponent>()),
 	m_registry(registry),
 	m_gameData(gameData),
-	m_nextShapeId(0)
+	m_nextShapeId(0),
+	m_lastSnapshotId(InvalidSnapshotId),
+	m_stateBudget(DefaultStateBudget)
 {
 	m_registry.on_construct<NetworkedComponent>().connect<&NetworkSystem::OnNetworkedConstruct>(this);
 	m_registry.on_destroy<NetworkedComponent>().connect<&NetworkSystem::OnNetworkedDestruct>(this);
 }
 
-void NetworkSystem::CreateAllEntities(ENetPeer* peer)
+void NetworkSystem::CreateAllEntities(Player& player)
 {
-	auto view = m_registry.view<NetworkedComponent, Sel::Transform>();
-	for (entt::entity entity : view)
+	UpdateViewCenter(player);
+	CollectEntities();
+
+	// Everything is sent in a single reliable message, the client applies it at once
+	WorldSnapshotPacket worldSnapshot;
+
+	player.knownEntities.clear();
+	for (const ReplicatedEntity& replicated : m_entities)
+	{
+		if (replicated.isInactive || (!IsInView(player, replicated.position, ViewMargin) && !IsNeededOutOfView(player, replicated)))
+			continue;
+
+		if (m_registry.any_of<BrawlerFlag>(replicated.entity))
+			worldSnapshot.brawlers.push_back(BuildCreateBrawler(replicated.entity));
+		else if (m_registry.any_of<CollectibleFlag>(replicated.entity))
+			worldSnapshot.collectibles.push_back(BuildCreateCollectible(replicated.entity));
+		else
+			continue;
+
+		player.knownEntities.push_back(replicated.networkId);
+	}
+
+	send_packet(m_gameData, player.peer, build_packet(worldSnapshot, ENET_PACKET_FLAG_RELIABLE));
+}
+
+void NetworkSystem::DumpStats(std::ostream& out)
+{
+	for (Player& player : m_gameData.players)
 	{
-		auto& transform = view.get<Sel::Transform>(entity);
-		auto& networked = view.get<NetworkedComponent>(entity);
+		ReplicationStats& stats = player.replicationStats;
+		if (stats.snapshotCount == 0)
+			continue;
+
+		out << "  player " << player.index << " (" << player.name << "): "
+		    << stats.snapshotCount << " snapshots, "
+		    << stats.sentStateCount / stats.snapshotCount << " states sent/snapshot, "
+		    << stats.deferredStateCount / stats.snapshotCount << " deferred/snapshot, "
+		    << stats.byteCount / stats.snapshotCount << " bytes/snapshot (max " << stats.maxPacketSize << "), "
+		    << "max priority " << stats.maxPriority << "\n";
+
+		// Which weight the priorities come from, then the states which waited the most
+		out << "    priority gained/snapshot: time " << stats.gainedPriority.time / stats.snapshotCount
+		    << ", distance " << stats.gainedPriority.distance / stats.snapshotCount
+		    << ", velocity change " << stats.gainedPriority.velocityChange / stats.snapshotCount << "\n";
 
-		if (m_registry.any_of<BrawlerFlag>(entity))
+		std::sort(stats.topDeferred.begin(), stats.topDeferred.end(), [](const auto& lhs, const auto& rhs) { return lhs.second.total > rhs.second.total; });
+		for (const auto& [networkId, priority] : stats.topDeferred)
 		{
-			auto& flag = m_registry.get<BrawlerFlag>(entity);
-			auto& velocity = m_registry.get<Sel::VelocityComponent>(entity);
-
-			CreateBrawlerPacket createBrawler;
-			createBrawler.playerId = flag.playerId;
-			createBrawler.brawlerId = networked.networkId;
-			createBrawler.skinId = flag.skinId;
-			createBrawler.position = transform.GetPosition();
-			createBrawler.linearVelocity = velocity.linearVel;
-			createBrawler.scale = transform.GetScale().x;
-
-			ENetPacket* createBrawlerPacket = build_packet(createBrawler, ENET_PACKET_FLAG_RELIABLE);
-			enet_peer_send(peer, 0, createBrawlerPacket);
+			out << "    deferred entity " << networkId << ": priority " << priority.total
+			    << " (time " << priority.time << ", distance " << priority.distance << ", velocity change " << priority.velocityChange << ")\n";
 		}
-		else if (m_registry.any_of<CollectibleFlag>(entity))
-		{
-			auto& collectibleFlag = m_registry.get<CollectibleFlag>(entity);
 
-			CreateCollectiblePacket createCollectible;
-			createCollectible.collectibleId = networked.networkId;
-			createCollectible.position = transform.GetPosition();
-			createCollectible.scale = transform.GetScale().x;
-			createCollectible.type = collectibleFlag.type;
+		stats = ReplicationStats{};
+	}
+}
+
+std::uint32_t NetworkSystem::GetLastSnapshotId() const
+{
+	return m_lastSnapshotId;
+}
+
+const SnapshotStates* NetworkSystem::GetPastStates(std::uint32_t snapshotId) const
+{
+	return m_stateHistory.Find(snapshotId);
+}
+
+void NetworkSystem::SetStateBudget(std::size_t budget)
+{
+	m_stateBudget = budget;
+}
+
+void NetworkSystem::Update()
+{
+	CollectEntities();
+
+	// Current state of every replicated entity, sorted by id so it can be diffed against each client baseline
+	m_currentStates.clear();
+
+	auto view = m_registry.view<NetworkedComponent, Sel::Transform, Sel::VelocityComponent>();
+	for (auto [entity, network, transform, velocity] : view.each())
+	{
+		auto& brawlerData = m_currentStates.emplace_back();
+		brawlerData.brawlerId = network.networkId;
+		brawlerData.position = transform.GetPosition();
+		brawlerData.linearVelocity = velocity.linearVel;
+	}
+
+	std::sort(m_currentStates.begin(), m_currentStates.end(), [](const auto& lhs, const auto& rhs) { return lhs.brawlerId < rhs.brawlerId; });
+
+	m_lastSnapshotId++;
+	m_stateHistory.Store(m_lastSnapshotId) = m_currentStates;
 
-			ENetPacket* createCollectiblePacket = build_packet(createCollectible, ENET_PACKET_FLAG_RELIABLE);
-			enet_peer_send(peer, 0, createCollectiblePacket);
+	for (Player& player : m_gameData.players)
+	{
+		if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
+		{
+			// Entities have to be created before the states referencing them
+			UpdateViewCenter(player);
+			UpdateInterest(player);
+			SendPlayerStates(player);
 		}
 	}
 }
 
-void NetworkSystem::Update()
+CreateBrawlerPacket NetworkSystem::BuildCreateBrawler(entt::entity entity) const
+{
+	auto& transform = m_registry.get<Sel::Transform>(entity);
+	auto& networked = m_registry.get<NetworkedComponent>(entity);
+	auto& flag = m_registry.get<BrawlerFlag>(entity);
+	auto& velocity = m_registry.get<Sel::VelocityComponent>(entity);
+
+	CreateBrawlerPacket createBrawler;
+	createBrawler.playerId = flag.playerId;
+	createBrawler.brawlerId = networked.networkId;
+	createBrawler.skinId = flag.skinId;
+	createBrawler.position = transform.GetPosition();
+	createBrawler.linearVelocity = velocity.linearVel;
+	createBrawler.scale = transform.GetScale().x;
+
+	return createBrawler;
+}
+
+CreateCollectiblePacket NetworkSystem::BuildCreateCollectible(entt::entity entity) const
 {
-	m_networkObserver.each([&](entt::entity entity)
+	auto& transform = m_registry.get<Sel::Transform>(entity);
+	auto& networked = m_registry.get<NetworkedComponent>(entity);
+	auto& collectibleFlag = m_registry.get<CollectibleFlag>(entity);
+
+	CreateCollectiblePacket createCollectible;
+	createCollectible.collectibleId = networked.networkId;
+	createCollectible.position = transform.GetPosition();
+	createCollectible.scale = transform.GetScale().x;
+	createCollectible.type = collectibleFlag.type;
+
+	return createCollectible;
+}
+
+void NetworkSystem::CollectEntities()
+{
+	m_entities.clear();
+
+	auto view = m_registry.view<NetworkedComponent, Sel::Transform>();
+	for (auto [entity, network, transform] : view.each())
+		m_entities.push_back({ network.networkId, entity, transform.GetPosition(), m_registry.any_of<InactiveFlag>(entity) });
+
+	std::sort(m_entities.begin(), m_entities.end(), [](const ReplicatedEntity& lhs, const ReplicatedEntity& rhs) { return lhs.networkId < rhs.networkId; });
+}
+
+bool NetworkSystem::IsInView(const Player& player, const Sel::Vector2f& position, float margin) const
+{
+	// Until the client has a camera target, it gets everything
+	if (!player.viewCenter)
+		return true;
+
+	Sel::Vector2f offset = position - *player.viewCenter;
+	return std::abs(offset.x) <= WINDOW_WIDTH * 0.5f + margin && std::abs(offset.y) <= WINDOW_HEIGHT * 0.5f + margin;
+}
+
+bool NetworkSystem::IsNeededOutOfView(const Player& player, const ReplicatedEntity& replicated) const
+{
+	if (player.ownBrawlerNetworkId == replicated.networkId || player.spectatedBrawlerId == replicated.networkId)
+		return true;
+
+	// The golden carrot indicator points to the carrot or to its owner
+	const GoldenCarrot& goldenCarrot = m_gameData.goldenCarrot;
+	if (goldenCarrot.isSpawned && (goldenCarrot.handle.entity() == replicated.entity || goldenCarrot.owningBrawlerId == replicated.networkId))
+		return true;
+
+	return false;
+}
+
+void NetworkSystem::LimitToBudget(Player& player, const SnapshotStates* baseline)
+{
+	auto& candidates = m_statesPacket.brawlers;
+
+	auto findState = [](const SnapshotStates& states, std::uint32_t id) -> const BrawlerStatesPacket::States*
+	{
+		auto it = std::lower_bound(states.begin(), states.end(), id, [](const auto& state, std::uint32_t stateId) { return state.brawlerId < stateId; });
+		return (it != states.end() && it->brawlerId == id) ? &*it : nullptr;
+	};
+
+	// Only waiting states have a priority (this also forgets the entities the client caught up with or doesn't know anymore)
+	for (auto it = player.statePriorities.begin(); it != player.statePriorities.end();)
+	{
+		if (!findState(candidates, it->first))
+			it = player.statePriorities.erase(it);
+		else
+			++it;
+	}
+
+	// Every state waiting to be sent gains priority, the closer to the view and the more its velocity changed, the faster
+	// Removals are a few bits each and always sent (the client would keep the state otherwise), their room is taken first
+	ReplicationStats& stats = player.replicationStats;
+	std::size_t bitCount = 0;
+	std::size_t removedBitCount = 0;
+	std::uint32_t previousId = 0;
+	for (const auto& state : candidates)
+	{
+		bitCount += BrawlerStatesPacket::GetStateBitCount(state, previousId);
+		previousId = state.brawlerId;
+
+		if (state.changedFields == BrawlerStatesPacket::Removed)
 		{
-			ENetPacket* createEntityPacket = nullptr;
+			removedBitCount += BrawlerStatesPacket::GetStateBitCount(state, 0);
+			continue;
+		}
+
+		float distancePriority = DistancePriority;
+		if (player.viewCenter)
+			distancePriority /= 1.f + (state.position - *player.viewCenter).Magnitude() / PriorityDistanceScale;
+
+		float velocityChangePriority = 0.f;
+		if (const auto* baselineState = (baseline) ? findState(*baseline, state.brawlerId) : nullptr)
+			velocityChangePriority = VelocityChangePriority * (state.linearVelocity - baselineState->linearVelocity).Magnitude() / BrawlerSpeed;
+
+		StatePriority& priority = player.statePriorities[state.brawlerId];
+		priority.time += PriorityPerSnapshot;
+		priority.distance += distancePriority;
+		priority.velocityChange += velocityChangePriority;
+		priority.total += PriorityPerSnapshot + distancePriority + velocityChangePriority;
+
+		stats.gainedPriority.time += PriorityPerSnapshot;
+		stats.gainedPriority.distance += distancePriority;
+		stats.gainedPriority.velocityChange += velocityChangePriority;
+		stats.gainedPriority.total += PriorityPerSnapshot + distancePriority + velocityChangePriority;
+		stats.maxPriority = std::max(stats.maxPriority, priority.total);
+	}
+
+	std::size_t budget = std::min(m_stateBudget, MaxStatePacketSize);
+
+	m_isStateSent.assign(candidates.size(), true);
+	std::size_t deferredCount = 0;
+	if (BrawlerStatesPacket::HeaderSize + (bitCount + 7) / 8 > budget)
+	{
+		m_priorityOrder.clear();
+		for (std::size_t i = 0; i < candidates.size(); ++i)
+		{
+			if (candidates[i].changedFields != BrawlerStatesPacket::Removed)
+				m_priorityOrder.emplace_back(player.statePriorities[candidates[i].brawlerId].total, i);
+		}
 
-			auto& transform = m_registry.get<Sel::Transform>(entity);
-			auto& networked = m_registry.get<NetworkedComponent>(entity);
+		std::sort(m_priorityOrder.begin(), m_priorityOrder.end(), [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second); });
 
-			if (m_registry.any_of<BrawlerFlag>(entity))
+		// Each state is counted as if its id was sent whole (the gap with the previous sent state isn't known yet), so what's picked always fits
+		std::size_t remainingBits = (budget > BrawlerStatesPacket::HeaderSize) ? (budget - BrawlerStatesPacket::HeaderSize) * 8 : 0;
+		remainingBits -= std::min(removedBitCount, remainingBits);
+		for (const auto& [priority, index] : m_priorityOrder)
+		{
+			std::size_t stateBits = BrawlerStatesPacket::GetStateBitCount(candidates[index], 0);
+			if (stateBits <= remainingBits)
+				remainingBits -= stateBits;
+			else
 			{
-				auto& velocity = m_registry.get<Sel::VelocityComponent>(entity);
-				auto& flag = m_registry.get<BrawlerFlag>(entity);
-
-				CreateBrawlerPacket createBrawler;
-				createBrawler.playerId = flag.playerId;
-				createBrawler.brawlerId = networked.networkId;
-				createBrawler.skinId = flag.skinId;
-				createBrawler.position = transform.GetPosition();
-				createBrawler.linearVelocity = velocity.linearVel;
-				createBrawler.scale = transform.GetScale().x;
-
-				createEntityPacket = build_packet(createBrawler, ENET_PACKET_FLAG_RELIABLE);
+				m_isStateSent[index] = false;
+				deferredCount++;
+
+				std::uint32_t networkId = candidates[index].brawlerId;
+				RecordDeferred(player, networkId, player.statePriorities[networkId]);
 			}
-			else if (m_registry.any_of<CollectibleFlag>(entity))
-			{
-				auto& collectibleFlag = m_registry.get<CollectibleFlag>(entity);
+		}
+	}
 
-				CreateCollectiblePacket createCollectible;
-				createCollectible.collectibleId = networked.networkId;
-				createCollectible.position = transform.GetPosition();
-				createCollectible.scale = transform.GetScale().x;
-				createCollectible.type = collectibleFlag.type;
+	// Sent states start accumulating from zero again, deferred ones stay as the client has them: their baseline state, or nothing if they aren't in the baseline
+	std::size_t sentCount = 0;
+	auto clientIt = m_clientStates.begin();
+	for (std::size_t i = 0; i < candidates.size(); ++i)
+	{
+		if (m_isStateSent[i])
+		{
+			player.statePriorities.erase(candidates[i].brawlerId);
+			candidates[sentCount++] = candidates[i];
+			continue;
+		}
 
-				createEntityPacket = build_packet(createCollectible, ENET_PACKET_FLAG_RELIABLE);
-			}
+		clientIt = std::lower_bound(clientIt, m_clientStates.end(), candidates[i].brawlerId, [](const auto& state, std::uint32_t id) { return state.brawlerId < id; });
+		assert(clientIt != m_clientStates.end() && clientIt->brawlerId == candidates[i].brawlerId);
+
+		if (const auto* baselineState = (baseline) ? findState(*baseline, clientIt->brawlerId) : nullptr)
+			*clientIt++ = *baselineState;
+		else
+			clientIt = m_clientStates.erase(clientIt);
+	}
+
+	candidates.resize(sentCount);
+
+	bitCount = 0;
+	previousId = 0;
+	for (const auto& state : candidates)
+	{
+		bitCount += BrawlerStatesPacket::GetStateBitCount(state, previousId);
+		previousId = state.brawlerId;
+	}
+
+	std::size_t packetSize = BrawlerStatesPacket::HeaderSize + (bitCount + 7) / 8;
+	stats.snapshotCount++;
+	stats.sentStateCount += candidates.size();
+	stats.deferredStateCount += deferredCount;
+	stats.byteCount += packetSize;
+	stats.maxPacketSize = std::max(stats.maxPacketSize, packetSize);
+}
+
+void NetworkSystem::RecordDeferred(Player& player, std::uint32_t networkId, const StatePriority& priority)
+{
+	// Each entity is listed once, with the highest accumulator it reached
+	auto& topDeferred = player.replicationStats.topDeferred;
+	auto it = std::find_if(topDeferred.begin(), topDeferred.end(), [&](const auto& deferred) { return deferred.first == networkId; });
+	if (it == topDeferred.end())
+	{
+		if (topDeferred.size() < TopDeferredCount)
+		{
+			topDeferred.emplace_back(networkId, priority);
+			return;
+		}
+
+		it = std::min_element(topDeferred.begin(), topDeferred.end(), [](const auto& lhs, const auto& rhs) { return lhs.second.total < rhs.second.total; });
+	}
+
+	if (priority.total > it->second.total)
+		*it = { networkId, priority };
+}
+
+void NetworkSystem::SendPlayerStates(Player& player)
+{
+	// Only the states of the entities the client knows, out of view ones keep their previous state between two refreshes
+	bool refreshOutOfView = (m_lastSnapshotId % OutOfViewStateInterval) == 0;
+	const SnapshotStates* previousStates = player.sentSnapshots.Find(m_lastSnapshotId - 1);
 
-			if (!createEntityPacket)
-				return;
+	m_clientStates.clear();
 
-			for (const Player& player : m_gameData.players)
+	auto knownIt = player.knownEntities.begin();
+	for (const auto& state : m_currentStates)
+	{
+		knownIt = std::lower_bound(knownIt, player.knownEntities.end(), state.brawlerId);
+		if (knownIt == player.knownEntities.end())
+			break;
+
+		if (*knownIt != state.brawlerId)
+			continue;
+
+		if (!refreshOutOfView && previousStates && !IsInView(player, state.position, ViewMargin + ViewHysteresis))
+		{
+			auto previousIt = std::lower_bound(previousStates->begin(), previousStates->end(), state.brawlerId, [](const auto& previous, std::uint32_t id) { return previous.brawlerId < id; });
+			if (previousIt != previousStates->end() && previousIt->brawlerId == state.brawlerId)
 			{
-				if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-					enet_peer_send(player.peer, 0, createEntityPacket);
+				m_clientStates.push_back(*previousIt);
+				continue;
 			}
-		});
+		}
 
-	auto view = m_registry.view<NetworkedComponent, Sel::Transform, Sel::VelocityComponent>();
-	BrawlerStatesPacket brawlerStates;
-	for (auto [entity, network, transform, velocity] : view.each())
-	{
-		auto& brawlerData = brawlerStates.brawlers.emplace_back();
-		brawlerData.brawlerId = network.networkId;
-		brawlerData.position = transform.GetPosition();
-		brawlerData.linearVelocity = velocity.linearVel;
+		m_clientStates.push_back(state);
 	}
 
-	ENetPacket* brawlerStatesPacket = build_packet(brawlerStates, 0);
+	// Delta against the last snapshot this client acknowledged, full snapshot if there's none or if it's too old
+	const SnapshotStates* baseline = nullptr;
+	if (m_lastSnapshotId - player.lastAckedSnapshotId < SnapshotHistory::Capacity)
+		baseline = player.sentSnapshots.Find(player.lastAckedSnapshotId);
+
+	m_statesPacket.snapshotId = m_lastSnapshotId;
+	m_statesPacket.baselineId = (baseline) ? player.lastAckedSnapshotId : InvalidSnapshotId;
+	BuildSnapshotDelta(baseline, m_clientStates, m_statesPacket);
+	LimitToBudget(player, baseline);
+
+	// That's what the client will have once it applies this packet
+	player.sentSnapshots.Store(m_lastSnapshotId) = m_clientStates;
+
+	send_packet(m_gameData, player.peer, build_packet(m_statesPacket, 0));
+}
+
+void NetworkSystem::UpdateInterest(Player& player)
+{
+	// Both m_entities and knownEntities are sorted by id, so is the new interest set
+	m_interest.clear();
 
-	for (const Player& player : m_gameData.players)
+	auto knownIt = player.knownEntities.begin();
+	for (const ReplicatedEntity& replicated : m_entities)
 	{
-		if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-			enet_peer_send(player.peer, 0, brawlerStatesPacket);
+		knownIt = std::lower_bound(knownIt, player.knownEntities.end(), replicated.networkId);
+		bool isKnown = (knownIt != player.knownEntities.end() && *knownIt == replicated.networkId);
+
+		// Known entities are kept a bit further than where new ones are created, parked collectibles leave right away (and come back through here once respawned)
+		float margin = (isKnown) ? ViewMargin + ViewHysteresis : ViewMargin;
+		if (replicated.isInactive || (!IsInView(player, replicated.position, margin) && !IsNeededOutOfView(player, replicated)))
+			continue;
+
+		if (!isKnown)
+		{
+			if (m_registry.any_of<BrawlerFlag>(replicated.entity))
+				send_packet(m_gameData, player.peer, build_packet(BuildCreateBrawler(replicated.entity), ENET_PACKET_FLAG_RELIABLE));
+			else if (m_registry.any_of<CollectibleFlag>(replicated.entity))
+				send_packet(m_gameData, player.peer, build_packet(BuildCreateCollectible(replicated.entity), ENET_PACKET_FLAG_RELIABLE));
+			else
+				continue;
+		}
+
+		m_interest.push_back(replicated.networkId);
+	}
+
+	// Known entities which aren't in the new set left the area of interest (destroyed ones were already removed by OnNetworkedDestruct)
+	auto interestIt = m_interest.begin();
+	for (std::uint32_t networkId : player.knownEntities)
+	{
+		interestIt = std::lower_bound(interestIt, m_interest.end(), networkId);
+		if (interestIt != m_interest.end() && *interestIt == networkId)
+			continue;
+
+		DeleteEntityPacket deleteEntity;
+		deleteEntity.brawlerId = networkId;
+
+		send_packet(m_gameData, player.peer, build_packet(deleteEntity, ENET_PACKET_FLAG_RELIABLE));
 	}
+
+	std::swap(player.knownEntities, m_interest);
+}
+
+void NetworkSystem::UpdateViewCenter(Player& player)
+{
+	// The camera follows the player's brawler while it plays, the spectated brawler otherwise
+	std::optional<std::uint32_t> targetId = (!player.isDead) ? player.ownBrawlerNetworkId : player.spectatedBrawlerId;
+	if (!targetId)
+		return;
+
+	// Without a target (a dead player who didn't pick one yet), the camera didn't move
+	auto it = m_gameData.networkToEntity.find(*targetId);
+	if (it == m_gameData.networkToEntity.end() || it->second.all_of<DeadFlag>())
+		return;
+
+	player.viewCenter = it->second.get<Sel::Transform>().GetPosition();
 }
 
 void NetworkSystem::OnNetworkedConstruct(entt::registry& registry, entt::entity entity)
@@ -137,11 +467,16 @@ void NetworkSystem::OnNetworkedDestruct(entt::registry& registry, entt::entity e
 	DeleteEntityPacket deleteBrawler;
 	deleteBrawler.brawlerId = networked.networkId;
 
-	ENetPacket* deleteShapePacket = build_packet(deleteBrawler, ENET_PACKET_FLAG_RELIABLE);
-
-	for (const Player& player : m_gameData.players)
+	// Only the clients which know the entity are told
+	for (Player& player : m_gameData.players)
 	{
-		if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
-			enet_peer_send(player.peer, 0, deleteShapePacket);
+		auto it = std::lower_bound(player.knownEntities.begin(), player.knownEntities.end(), networked.networkId);
+		if (it == player.knownEntities.end() || *it != networked.networkId)
+			continue;
+
+		player.knownEntities.erase(it);
+
+		if (player.peer)
+			send_packet(m_gameData, player.peer, build_packet(deleteBrawler, ENET_PACKET_FLAG_RELIABLE));
 	}
-}
\ No newline at end of file
+}
@@ -2,9 +2,25 @@
 
 #include <entt/entt.hpp>
 #include <enet6/enet.h>
+#include "sh_snapshot.h"
+#include <Sel/Vector2.hpp>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
 
 struct GameData;
+struct Player;
+struct StatePriority;
 
+// Replicates the networked entities to each client, limited to its area of interest: what its camera shows plus a margin.
+// Entities are created on a client when they enter that area and removed when they leave it (a bit further, so that an entity
+// on the border doesn't keep being created and removed). The golden carrot, its owner and the player's own brawler are needed
+// out of view (indicator, camera), their state is only refreshed every OutOfViewStateInterval snapshots there.
+//
+// The state packet of a client is limited to a byte budget (and to the MTU). When its changes don't fit, they're sent by priority:
+// each waiting state accumulates a priority every snapshot (more when it's close to the view or its velocity changed), it's reset once sent.
+// A state which didn't fit stays as the client knows it (its baseline), the client keeps extrapolating it until its turn comes.
 class NetworkSystem
 {
 public:
@@ -13,19 +29,74 @@ public:
 	NetworkSystem(NetworkSystem&&) = delete;
 	~NetworkSystem() = default;
 
-	void CreateAllEntities(ENetPeer* peer);
+	// Sends the entities of the player's area of interest in a single message (used when the player joins)
+	void CreateAllEntities(Player& player);
+
+	// Writes the replication stats of every player since the last call (see ReplicationStats) and resets them
+	void DumpStats(std::ostream& out);
+
+	std::uint32_t GetLastSnapshotId() const;
+
+	// States of every replicated entity (sorted by id) at a past snapshot, null once it left the history
+	const SnapshotStates* GetPastStates(std::uint32_t snapshotId) const;
+
+	// Bytes per snapshot a client may receive (capped to MaxStatePacketSize)
+	void SetStateBudget(std::size_t budget);
 
 	void Update();
 
 	NetworkSystem& operator=(const NetworkSystem&) = delete;
 	NetworkSystem& operator=(NetworkSystem&&) = delete;
 
+	static constexpr float ViewMargin = 200.f; //< entities closer than this to the view are created
+	static constexpr float ViewHysteresis = 150.f; //< they're only removed once they're ViewHysteresis further
+	static constexpr std::uint32_t OutOfViewStateInterval = 4;
+
+	static constexpr std::size_t DefaultStateBudget = 1000;
+	static constexpr std::size_t MaxStatePacketSize = 1200; //< under ENet's default MTU (1392) once its headers are added, never fragmented
+
+	// Priority accumulated by a waiting state every snapshot
+	static constexpr float PriorityPerSnapshot = 1.f;
+	static constexpr float DistancePriority = 4.f; //< scaled by 1 / (1 + distance to the view center / PriorityDistanceScale)
+	static constexpr float PriorityDistanceScale = 500.f;
+	static constexpr float VelocityChangePriority = 8.f; //< scaled by how much its velocity changed since the client's state, in BrawlerSpeed units
+
+	static constexpr std::size_t TopDeferredCount = 5; //< deferred states listed per player by DumpStats
+
 private:
+	struct ReplicatedEntity
+	{
+		std::uint32_t networkId;
+		entt::entity entity;
+		Sel::Vector2f position;
+		bool isInactive; //< parked in the CollectiblePool: never created on a client, deleted from those which know it
+	};
+
+	CreateBrawlerPacket BuildCreateBrawler(entt::entity entity) const;
+	CreateCollectiblePacket BuildCreateCollectible(entt::entity entity) const;
+	void CollectEntities();
+	bool IsInView(const Player& player, const Sel::Vector2f& position, float margin) const;
+	bool IsNeededOutOfView(const Player& player, const ReplicatedEntity& replicated) const;
+	void LimitToBudget(Player& player, const SnapshotStates* baseline);
+	void RecordDeferred(Player& player, std::uint32_t networkId, const StatePriority& priority);
+	void SendPlayerStates(Player& player);
+	void UpdateInterest(Player& player);
+	void UpdateViewCenter(Player& player);
+
 	void OnNetworkedConstruct(entt::registry& registry, entt::entity entity);
 	void OnNetworkedDestruct(entt::registry& registry, entt::entity entity);
 
-	entt::observer m_networkObserver;
+	std::vector<ReplicatedEntity> m_entities; //< sorted by network id
+	std::vector<std::uint32_t> m_interest;
 	entt::registry& m_registry;
 	GameData& m_gameData;
 	std::uint32_t m_nextShapeId;
+	std::uint32_t m_lastSnapshotId;
+	SnapshotStates m_currentStates;
+	SnapshotHistory m_stateHistory; //< m_currentStates of the last snapshots, to resolve requests against what a client saw
+	SnapshotStates m_clientStates;
+	BrawlerStatesPacket m_statesPacket;
+	std::size_t m_stateBudget;
+	std::vector<std::pair<float, std::size_t>> m_priorityOrder; //< (priority, index in m_statesPacket.brawlers)
+	std::vector<bool> m_isStateSent;
 };
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "sv_networkthread.h"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+NetworkThread::NetworkThread(ENetHost* host, std::ostream* statsOutput) :
+	m_isStopping(false),
+	m_isWakePending(false),
+	m_host(host),
+	m_heldBroadcast(nullptr),
+	m_stats(host),
+	m_events(EventQueueCapacity),
+	m_queuedPackets(PacketQueueCapacity),
+	m_statsOutput(statsOutput),
+	m_hasNewEvents(false)
+{
+	// Bound to an ephemeral loopback port, the datagrams we send to it only wake the network thread up
+	m_wakeSocket = enet_socket_create(ENET_ADDRESS_TYPE_IPV4, ENET_SOCKET_TYPE_DATAGRAM);
+	if (m_wakeSocket == ENET_SOCKET_NULL)
+		throw std::runtime_error("failed to create the network thread wake-up socket");
+
+	enet_address_set_host(&m_wakeAddress, ENET_ADDRESS_TYPE_IPV4, "127.0.0.1");
+	m_wakeAddress.port = 0;
+	if (enet_socket_bind(m_wakeSocket, &m_wakeAddress) < 0 || enet_socket_get_address(m_wakeSocket, &m_wakeAddress) < 0)
+	{
+		enet_socket_destroy(m_wakeSocket);
+		throw std::runtime_error("failed to bind the network thread wake-up socket");
+	}
+
+	enet_socket_set_option(m_wakeSocket, ENET_SOCKOPT_NONBLOCK, 1);
+
+	m_thread = std::thread(&NetworkThread::ThreadMain, this);
+}
+
+NetworkThread::~NetworkThread()
+{
+	m_isStopping = true;
+	Wake();
+	m_thread.join();
+
+	enet_socket_destroy(m_wakeSocket);
+
+	// Whatever the simulation didn't handle is dropped
+	NetworkEvent event;
+	while (m_events.TryPop(event))
+	{
+		if (event.packet)
+			enet_packet_destroy(event.packet);
+	}
+}
+
+bool NetworkThread::PollEvent(NetworkEvent& event)
+{
+	return m_events.TryPop(event);
+}
+
+void NetworkThread::Send(const OutgoingPacket& outgoing, enet_uint32 connectId)
+{
+	// The network thread keeps sending while it waits for room in the event queue, so it always ends up making room here too
+	QueuedPacket queued{ outgoing, connectId };
+	while (!m_queuedPackets.TryPush(std::move(queued)))
+	{
+		Wake();
+		std::this_thread::yield();
+	}
+}
+
+void NetworkThread::Flush()
+{
+	Wake();
+}
+
+void NetworkThread::WaitForEvents(std::uint32_t timeout)
+{
+	std::unique_lock<std::mutex> lock(m_notifyMutex);
+	m_eventsReceived.wait_for(lock, std::chrono::milliseconds(timeout), [&] { return m_hasNewEvents; });
+	m_hasNewEvents = false;
+}
+
+void NetworkThread::NotifyEvents()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_notifyMutex);
+		m_hasNewEvents = true;
+	}
+	m_eventsReceived.notify_one();
+}
+
+void NetworkThread::PushEvent(NetworkEvent&& event)
+{
+	if (m_events.TryPush(std::move(event)))
+		return;
+
+	// The simulation is late: we make sure it's awake and keep sending its packets until it pops some events
+	NotifyEvents();
+	do
+	{
+		SendQueuedPackets();
+		std::this_thread::yield();
+	} while (!m_events.TryPush(std::move(event)));
+}
+
+void NetworkThread::SendQueuedPackets()
+{
+	// Cleared before looking at the queue: a packet pushed from now on comes with a new wake-up
+	m_isWakePending = false;
+
+	QueuedPacket queued;
+	while (m_queuedPackets.TryPop(queued))
+	{
+		const OutgoingPacket& outgoing = queued.outgoing;
+
+		// A broadcast is queued once per recipient and may be popped in several calls, with enet_host_service running in between:
+		// ENet would free the packet as soon as its sends so far are acknowledged (or their peer reset), before the next recipients get it
+		if (!outgoing.isLastSend && m_heldBroadcast != outgoing.packet)
+		{
+			assert(!m_heldBroadcast); //< the sends of a broadcast are queued in a row
+			m_heldBroadcast = outgoing.packet;
+			m_heldBroadcast->referenceCount++;
+		}
+
+		// The peer may have been disconnected and reused by someone else since the packet was queued
+		if (outgoing.peer->connectID == queued.connectId && enet_peer_send(outgoing.peer, 0, outgoing.packet) == 0)
+			m_stats.RecordSent(outgoing.peer, outgoing.packet);
+
+		if (!outgoing.isLastSend)
+			continue;
+
+		if (m_heldBroadcast == outgoing.packet)
+		{
+			m_heldBroadcast->referenceCount--;
+			m_heldBroadcast = nullptr;
+		}
+
+		// No reference left means the sends were all acknowledged or none succeeded, ENet won't ever free it
+		if (outgoing.packet->referenceCount == 0)
+			enet_packet_destroy(outgoing.packet);
+	}
+}
+
+void NetworkThread::ThreadMain()
+{
+	auto nextStats = std::chrono::steady_clock::now() + StatsInterval;
+
+	while (!m_isStopping)
+	{
+		// Sent by the next enet_host_service
+		SendQueuedPackets();
+
+		// ENet doesn't wait, we do (on its socket and ours): its wait can't be interrupted by the simulation
+		ENetEvent event;
+		if (enet_host_service(m_host, &event, 0) > 0)
+		{
+			// Every pending event is handed over, enet_host_check_events doesn't run the network layer again
+			do
+			{
+				if (event.type == ENET_EVENT_TYPE_CONNECT)
+					m_stats.RecordConnect(event.peer);
+				else if (event.type == ENET_EVENT_TYPE_RECEIVE)
+					m_stats.RecordReceived(event.peer, event.packet);
+
+				PushEvent({ event.type, event.peer, event.packet, event.peer->connectID });
+			} while (enet_host_check_events(m_host, &event) > 0);
+
+			NotifyEvents();
+		}
+		else
+			Wait((m_host->connectedPeers > 0) ? ServiceTimeout : IdleServiceTimeout);
+
+		if (m_statsOutput && std::chrono::steady_clock::now() >= nextStats)
+		{
+			nextStats += StatsInterval;
+			m_stats.WriteJson(*m_statsOutput);
+		}
+	}
+}
+
+void NetworkThread::Wait(enet_uint32 timeout)
+{
+	ENetSocketSet readSet;
+	ENET_SOCKETSET_EMPTY(readSet);
+	ENET_SOCKETSET_ADD(readSet, m_host->socket);
+	ENET_SOCKETSET_ADD(readSet, m_wakeSocket);
+
+	if (enet_socketset_select(std::max(m_host->socket, m_wakeSocket), &readSet, nullptr, timeout) <= 0 || !ENET_SOCKETSET_CHECK(readSet, m_wakeSocket))
+		return;
+
+	// Only the wake-up matters, not what the datagrams hold
+	std::uint8_t byte;
+	ENetBuffer buffer;
+	buffer.data = &byte;
+	buffer.dataLength = sizeof(byte);
+	while (enet_socket_receive(m_wakeSocket, nullptr, &buffer, 1) > 0);
+}
+
+void NetworkThread::Wake()
+{
+	// One datagram until the network thread looks at the queue again is enough
+	if (m_isWakePending.exchange(true))
+		return;
+
+	std::uint8_t byte = 0;
+	ENetBuffer buffer;
+	buffer.data = &byte;
+	buffer.dataLength = sizeof(byte);
+	enet_socket_send(m_wakeSocket, &m_wakeAddress, &buffer, 1);
+}
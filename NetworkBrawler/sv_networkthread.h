@@ -0,0 +1,91 @@
+#pragma once
+
+#include "sv_gamedata.h"
+#include "sv_networkstats.h"
+#include "sv_spscqueue.h"
+#include <enet6/enet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Something which happened on the network, handed to the simulation thread in the order ENet reported it
+struct NetworkEvent
+{
+	ENetEventType type;
+	ENetPeer* peer;
+	ENetPacket* packet;    //< receive events only, destroyed by whoever handles the message
+	enet_uint32 connectId; //< ENetPeer are reused by later connections, this identifies the connection itself
+};
+
+// Services ENet on its own thread, so a burst of packets doesn't delay the ticks and a slow tick doesn't delay the acks.
+// This thread is the only one calling ENet on the host: received events are handed to the simulation thread through a lock-free queue,
+// and the packets the simulation sends come back through another one.
+// It also accounts for the traffic (see NetworkStats) and writes it periodically as JSON lines.
+class NetworkThread
+{
+public:
+	// statsOutput receives a JSON line every StatsInterval (nothing is written if it's null), it's only used by the network thread
+	NetworkThread(ENetHost* host, std::ostream* statsOutput);
+	NetworkThread(const NetworkThread&) = delete;
+	NetworkThread(NetworkThread&&) = delete;
+	~NetworkThread();
+
+	// Simulation thread: returns false once every event received so far has been popped
+	bool PollEvent(NetworkEvent& event);
+
+	// Simulation thread: the packet is sent to the peer if it's still the same connection (see OutgoingPacket for its ownership),
+	// once the network thread is woken up (see Flush)
+	void Send(const OutgoingPacket& outgoing, enet_uint32 connectId);
+
+	// Simulation thread: wakes the network thread up so it sends the packets queued so far
+	void Flush();
+
+	// Simulation thread: blocks until new events are received or the timeout (ms) expires
+	void WaitForEvents(std::uint32_t timeout);
+
+	NetworkThread& operator=(const NetworkThread&) = delete;
+	NetworkThread& operator=(NetworkThread&&) = delete;
+
+	static constexpr std::size_t EventQueueCapacity = 16 * 1024;
+	static constexpr std::size_t PacketQueueCapacity = 64 * 1024;
+
+	// The network thread waits for a datagram or for a Flush, and wakes up on its own this often (ms) for ENet's timers (resends, pings, timeouts)
+	static constexpr enet_uint32 ServiceTimeout = 10;
+	// Same without any connected peer: there's nothing to resend nor to send, only connections (which are datagrams) can happen
+	static constexpr enet_uint32 IdleServiceTimeout = 1000;
+
+	static constexpr std::chrono::seconds StatsInterval{ 5 };
+
+private:
+	struct QueuedPacket
+	{
+		OutgoingPacket outgoing;
+		enet_uint32 connectId;
+	};
+
+	void NotifyEvents();
+	void PushEvent(NetworkEvent&& event);
+	void SendQueuedPackets();
+	void ThreadMain();
+	void Wait(enet_uint32 timeout);
+	void Wake();
+
+	std::atomic_bool m_isStopping;
+	std::atomic_bool m_isWakePending; //< a wake-up datagram was sent and the network thread didn't look at the queue since
+	std::condition_variable m_eventsReceived;
+	std::mutex m_notifyMutex;
+	ENetHost* m_host;
+	ENetPacket* m_heldBroadcast; //< broadcast packet being sent, we hold a reference on it until its last send
+	NetworkStats m_stats;
+	SpscQueue<NetworkEvent> m_events;
+	SpscQueue<QueuedPacket> m_queuedPackets;
+	std::ostream* m_statsOutput;
+	ENetAddress m_wakeAddress;
+	ENetSocket m_wakeSocket; //< loopback socket the network thread waits on along with the host's, Wake sends it a one-byte datagram
+	std::thread m_thread;
+	bool m_hasNewEvents;
+};
@@ -0,0 +1,186 @@
+#include "sv_replay.h"
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	constexpr char Magic[4] = { 'B', 'R', 'R', 'P' };
+	constexpr std::uint8_t Version = 1;
+
+	void Serialize_varint(std::vector<std::uint8_t>& byteArray, std::uint64_t value)
+	{
+		// 7 bits per byte, the high bit tells there's more
+		while (value >= 0x80)
+		{
+			byteArray.push_back(static_cast<std::uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+
+		byteArray.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	void CheckRemaining(const std::vector<std::uint8_t>& content, std::size_t offset, std::size_t size)
+	{
+		if (size > content.size() || offset > content.size() - size)
+			throw std::runtime_error("truncated replay file");
+	}
+
+	std::uint64_t Deserialize_varint(const std::vector<std::uint8_t>& content, std::size_t& offset)
+	{
+		std::uint64_t value = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7)
+		{
+			CheckRemaining(content, offset, 1);
+			std::uint8_t byte = content[offset++];
+
+			value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+
+		throw std::runtime_error("invalid varint in replay file");
+	}
+}
+
+ReplayRecorder::ReplayRecorder(const std::string& filePath, std::uint32_t seed) :
+	m_file(filePath, std::ios::binary | std::ios::trunc),
+	m_lastTick(0)
+{
+	if (!m_file)
+		throw std::runtime_error("failed to open " + filePath);
+
+	m_buffer.reserve(FlushThreshold * 2);
+	m_buffer.insert(m_buffer.end(), std::begin(Magic), std::end(Magic));
+	Serialize_u8(m_buffer, Version);
+	Serialize_u32(m_buffer, seed);
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	Flush();
+}
+
+void ReplayRecorder::RecordConnect(std::uint64_t tick, std::size_t slot)
+{
+	assert(slot <= std::numeric_limits<std::uint8_t>::max());
+
+	BeginRecord(ReplayRecordType::Connect, tick);
+	Serialize_u8(m_buffer, static_cast<std::uint8_t>(slot));
+}
+
+void ReplayRecorder::RecordDisconnect(std::uint64_t tick, std::size_t slot)
+{
+	assert(slot <= std::numeric_limits<std::uint8_t>::max());
+
+	BeginRecord(ReplayRecordType::Disconnect, tick);
+	Serialize_u8(m_buffer, static_cast<std::uint8_t>(slot));
+}
+
+void ReplayRecorder::RecordMessage(std::uint64_t tick, std::size_t slot, ByteSpan message)
+{
+	assert(slot <= std::numeric_limits<std::uint8_t>::max());
+
+	BeginRecord(ReplayRecordType::Message, tick);
+	Serialize_u8(m_buffer, static_cast<std::uint8_t>(slot));
+	Serialize_varint(m_buffer, message.size);
+	m_buffer.insert(m_buffer.end(), message.data, message.data + message.size);
+}
+
+void ReplayRecorder::RecordUpdate(std::uint64_t tick, std::uint32_t tickCount)
+{
+	assert(tickCount <= std::numeric_limits<std::uint8_t>::max());
+
+	BeginRecord(ReplayRecordType::Update, tick);
+	Serialize_u8(m_buffer, static_cast<std::uint8_t>(tickCount));
+
+	// Only at the end of an update, the file is never left in the middle of a tick
+	if (m_buffer.size() >= FlushThreshold)
+		Flush();
+}
+
+void ReplayRecorder::BeginRecord(ReplayRecordType type, std::uint64_t tick)
+{
+	assert(tick >= m_lastTick);
+
+	Serialize_u8(m_buffer, static_cast<std::uint8_t>(type));
+	Serialize_varint(m_buffer, tick - m_lastTick);
+	m_lastTick = tick;
+}
+
+void ReplayRecorder::Flush()
+{
+	m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+	m_file.flush();
+	m_buffer.clear();
+}
+
+ReplayReader::ReplayReader(const std::string& filePath) :
+	m_offset(0),
+	m_lastTick(0)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("failed to open " + filePath);
+
+	m_content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	CheckRemaining(m_content, 0, sizeof(Magic) + 1 + 4);
+	if (std::memcmp(m_content.data(), Magic, sizeof(Magic)) != 0)
+		throw std::runtime_error(filePath + " is not a replay file");
+
+	m_offset = sizeof(Magic);
+	if (Deserialize_u8(m_content, m_offset) != Version)
+		throw std::runtime_error(filePath + " has an unsupported replay version");
+
+	m_seed = Deserialize_u32(m_content, m_offset);
+}
+
+std::uint32_t ReplayReader::GetSeed() const
+{
+	return m_seed;
+}
+
+bool ReplayReader::Read(ReplayRecord& record)
+{
+	if (m_offset == m_content.size())
+		return false;
+
+	std::uint8_t type = m_content[m_offset++];
+	if (type > static_cast<std::uint8_t>(ReplayRecordType::Update))
+		throw std::runtime_error("invalid replay record type");
+
+	record = ReplayRecord{};
+	record.type = static_cast<ReplayRecordType>(type);
+	m_lastTick += Deserialize_varint(m_content, m_offset);
+	record.tick = m_lastTick;
+
+	CheckRemaining(m_content, m_offset, 1);
+	switch (record.type)
+	{
+		case ReplayRecordType::Connect:
+		case ReplayRecordType::Disconnect:
+			record.slot = Deserialize_u8(m_content, m_offset);
+			break;
+
+		case ReplayRecordType::Message:
+		{
+			record.slot = Deserialize_u8(m_content, m_offset);
+
+			std::uint64_t size = Deserialize_varint(m_content, m_offset);
+			CheckRemaining(m_content, m_offset, size);
+
+			record.message = ByteSpan(m_content.data() + m_offset, static_cast<std::size_t>(size));
+			m_offset += static_cast<std::size_t>(size);
+			break;
+		}
+
+		case ReplayRecordType::Update:
+			record.tickCount = Deserialize_u8(m_content, m_offset);
+			break;
+	}
+
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sh_protocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary log of everything which drives the simulation of a room, enough to run it again without any network (see Room::Replay).
+// File: "BRRP" magic, version (u8), RNG seed of the room (u32), then records until the end of the file.
+// Record: type (u8), tick delta since the previous record (varint) then, depending on the type:
+// - Connect / Disconnect: player slot (u8)
+// - Message: player slot (u8), size (varint), message bytes (opcode included)
+// - Update: number of ticks run (u8)
+enum class ReplayRecordType : std::uint8_t
+{
+	Connect,    //< a player took this slot
+	Disconnect, //< the player of this slot left
+	Message,    //< a message was handled for the player of this slot
+	Update      //< the room ran tickCount ticks, starting at tick
+};
+
+struct ReplayRecord
+{
+	ReplayRecordType type = ReplayRecordType::Connect;
+	std::uint64_t tick = 0;
+	std::uint8_t slot = 0;
+	std::uint8_t tickCount = 0;
+	ByteSpan message; //< points into the reader's buffer
+};
+
+class ReplayRecorder
+{
+public:
+	ReplayRecorder(const std::string& filePath, std::uint32_t seed);
+	ReplayRecorder(const ReplayRecorder&) = delete;
+	ReplayRecorder(ReplayRecorder&&) = delete;
+	~ReplayRecorder();
+
+	void RecordConnect(std::uint64_t tick, std::size_t slot);
+	void RecordDisconnect(std::uint64_t tick, std::size_t slot);
+	void RecordMessage(std::uint64_t tick, std::size_t slot, ByteSpan message);
+	void RecordUpdate(std::uint64_t tick, std::uint32_t tickCount);
+
+	ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+	ReplayRecorder& operator=(ReplayRecorder&&) = delete;
+
+	// Records are buffered and written once there's at least this many bytes
+	static constexpr std::size_t FlushThreshold = 64 * 1024;
+
+private:
+	void BeginRecord(ReplayRecordType type, std::uint64_t tick);
+	void Flush();
+
+	std::ofstream m_file;
+	std::vector<std::uint8_t> m_buffer;
+	std::uint64_t m_lastTick;
+};
+
+// Reads a whole replay file at once, throws if it's invalid
+class ReplayReader
+{
+public:
+	explicit ReplayReader(const std::string& filePath);
+	ReplayReader(const ReplayReader&) = delete;
+	ReplayReader(ReplayReader&&) = delete;
+	~ReplayReader() = default;
+
+	std::uint32_t GetSeed() const;
+
+	// Returns false at the end of the file
+	bool Read(ReplayRecord& record);
+
+	ReplayReader& operator=(const ReplayReader&) = delete;
+	ReplayReader& operator=(ReplayReader&&) = delete;
+
+private:
+	std::vector<std::uint8_t> m_content;
+	std::size_t m_offset;
+	std::uint64_t m_lastTick;
+	std::uint32_t m_seed;
+};
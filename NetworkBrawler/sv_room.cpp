@@ -0,0 +1,1102 @@
+#include "sv_room.h"
+#include "sh_brawler.h"
+#include "sh_constants.h"
+#include "sh_protocol.h"
+#include "sv_broadcast.h"
+#include "sv_logger.h"
+#include "sv_networkedcomponent.h"
+#include <Sel/Transform.hpp>
+#include <Sel/VelocityComponent.hpp>
+#include <algorithm>
+#include <cassert>
+#include <ostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+ENetPacket* build_leaderboard_packet(GameData& gameData);
+ENetPacket* build_playerlist_packet(GameData& gameData);
+Player* find_peer_player(GameData& gameData, ENetPeer* peer);
+
+void register_message_handlers(MessageDispatcher<Player&, GameData&, NetworkSystem&>& dispatcher);
+void tick(GameData& gameData, Sel::VelocitySystem& velocitySystem, NetworkSystem& networkSystem, CollectibleSystem& collectibleSystem);
+entt::handle spawn_collectible(GameData& gameData, const CollectibleType& type = CollectibleType::Carrot);
+void start_game(GameData& gameData);
+void end_game(GameData& gameData);
+void flush_leaderboard(GameData& gameData);
+void update_leaderboard(GameData& gameData, const Player& player);
+
+Room::Room(std::size_t index, std::uint32_t seed) :
+	m_gameData(m_registry, m_goldenCarrot),
+	m_velocitySystem(m_registry),
+	m_networkSystem(m_registry, m_gameData),
+	m_collectibleSystem(m_registry, m_gameData),
+	m_index(index),
+	m_maxPlayerCount(MaxPlayerCount),
+	m_seed(seed)
+{
+	m_gameData.randomGenerator.seed(seed);
+
+	register_message_handlers(m_messageDispatcher);
+}
+
+void Room::ClearOutbox()
+{
+	m_gameData.outbox.clear();
+}
+
+const std::vector<OutgoingPacket>& Room::GetOutbox() const
+{
+	return m_gameData.outbox;
+}
+
+void Room::DumpCounters(std::ostream& out) const
+{
+	out << "room #" << m_index << " (" << m_gameData.players.GetSize() << " players)" << std::endl;
+	m_messageDispatcher.DumpCounters(out);
+}
+
+void Room::DumpProfile(std::ostream& out)
+{
+	out << "room #" << m_index << " tick profile (" << m_gameData.players.GetSize() << " players)" << std::endl;
+	m_gameData.profiler.Dump(out);
+}
+
+void Room::DumpInputs(std::ostream& out)
+{
+	out << "room #" << m_index << " input buffers (" << m_gameData.players.GetSize() << " players)" << std::endl;
+	for (Player& player : m_gameData.players)
+	{
+		const InputBuffer::Stats& stats = player.inputBuffer.GetStats();
+		out << "  player " << player.index << " (" << player.name << "): depth " << player.inputBuffer.GetDepth()
+		    << " (target " << player.inputBuffer.GetTargetDepth() << ", max " << stats.maxDepth << "), "
+		    << stats.consumedCount << " consumed, " << stats.starvationCount << " starved, "
+		    << stats.lostCount << " lost, " << stats.recoveredCount << " recovered, " << stats.lateCount << " late, " << stats.skippedCount << " skipped" << "\n";
+
+		player.inputBuffer.ResetStats();
+	}
+}
+
+void Room::DumpReplication(std::ostream& out)
+{
+	out << "room #" << m_index << " replication (" << m_gameData.players.GetSize() << " players)" << std::endl;
+	m_networkSystem.DumpStats(out);
+
+	const CollectiblePool::Stats& poolStats = m_gameData.collectiblePool.GetStats();
+	out << "  collectibles: " << poolStats.createdCount << " created, " << poolStats.reusedCount << " reused, " << poolStats.releasedCount << " released, "
+	    << m_gameData.collectiblePool.GetInactiveCount() << " parked" << "\n";
+
+	m_gameData.collectiblePool.ResetStats();
+}
+
+std::size_t Room::GetIndex() const
+{
+	return m_index;
+}
+
+std::size_t Room::GetPlayerCount() const
+{
+	return m_gameData.players.GetSize();
+}
+
+std::uint32_t Room::GetWaitTime() const
+{
+	if (m_gameData.players.IsEmpty())
+		return std::numeric_limits<std::uint32_t>::max();
+
+	return m_gameData.scheduler.GetWaitTime();
+}
+
+void Room::HandleConnect(ENetPeer* peer)
+{
+	GameData& gameData = m_gameData;
+
+	// Nothing ran while the room was empty, the ticks it slept through aren't caught up
+	if (gameData.players.IsEmpty())
+		gameData.scheduler.SkipDueTicks();
+
+	// The player takes a free slot (its index is its id), the peer keeps its handle to find it back in O(1)
+	PlayerHandle handle = gameData.players.Insert();
+	peer->data = handle.ToUserData();
+
+	Player& player = *gameData.players.Get(handle);
+	player.index = handle.index;
+	std::uniform_real_distribution<float> colorDistribution(0.f, 1.f);
+	player.color = Sel::Color{ colorDistribution(gameData.randomGenerator), colorDistribution(gameData.randomGenerator), colorDistribution(gameData.randomGenerator), 1.f }; //< On associe une couleur alatoire
+	player.peer = peer; //< On associe le joueur  son peer
+
+	if (m_recorder)
+		m_recorder->RecordConnect(gameData.scheduler.GetTick(), handle.index);
+
+	// Someone join so he is not ready. Stop the game start countdown
+	if (gameData.gamesState == GameState::Lobby)
+	{
+		gameData.allReady = false;
+	}
+
+
+	log_info("Player connected to room #{}", m_index);
+}
+
+void Room::HandleDisconnect(ENetPeer* peer)
+{
+	GameData& gameData = m_gameData;
+
+	// Un joueur s'est dconnect
+	Player* peerPlayer = find_peer_player(gameData, peer);
+	assert(peerPlayer);
+
+	Player& player = *peerPlayer;
+	PlayerHandle handle = gameData.players.GetHandle(player.index);
+
+	log_info("Player #{} ({}) disconnected from server", player.index, player.name);
+
+	if (m_recorder)
+		m_recorder->RecordDisconnect(gameData.scheduler.GetTick(), player.index);
+
+	// Nothing is sent to him anymore, his slot is freed once he's been removed from everything
+	player.peer = nullptr;
+	peer->data = nullptr;
+
+	// On delete son brawler
+	player.brawler.reset();
+	if (player.ownBrawlerNetworkId)
+	{
+		auto it = gameData.networkToEntity.find(*(player.ownBrawlerNetworkId));
+		if (it != gameData.networkToEntity.end())
+		{
+			entt::handle entityHandle = it->second;
+
+			// S'il avait la golden carrot on la remet en jeu  l'emplacement de la mort
+			if (&(gameData.goldenCarrot) && gameData.goldenCarrot.owningBrawlerId == player.ownBrawlerNetworkId)
+			{
+				// On notifie tout le monde
+				GoldenEventPacket packet;
+				packet.eventType = GoldenEventPacket::GoldenEventType::Released;
+
+				packet.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
+
+				broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
+
+				gameData.goldenCarrot.handle.try_get<Sel::Transform>()->SetPosition(entityHandle.try_get<Sel::Transform>()->GetPosition());
+				gameData.goldenCarrot.owningBrawlerId.reset();
+
+			}
+
+			gameData.registry.destroy(entityHandle);
+
+			gameData.networkToEntity.erase(it);
+
+		}
+	}
+
+	player.ownBrawlerNetworkId.reset();
+
+	// Supprimer le joueur de gameData.playingPlayers et gameData.leaderBoard
+	gameData.playingPlayers.erase(
+		std::remove(gameData.playingPlayers.begin(), gameData.playingPlayers.end(), handle),
+		gameData.playingPlayers.end()
+	);
+
+	gameData.leaderBoard.Remove(handle);
+
+	bool hadName = !player.name.empty();
+	gameData.players.Remove(handle);
+
+	// On renvoie la liste des joueurs  tous les joueurs (si ce joueur avait un nom)
+	if (hadName)
+		broadcast_packet(gameData, build_playerlist_packet(gameData), Recipients::Named);
+}
+
+bool Room::HasWork() const
+{
+	return !m_pendingMessages.empty() || GetWaitTime() == 0;
+}
+
+bool Room::IsFull() const
+{
+	return m_gameData.players.GetSize() >= m_maxPlayerCount;
+}
+
+void Room::PushMessage(ENetPeer* peer, ENetPacket* packet)
+{
+	// The handle is taken now: if the player leaves before the update, the message is dropped
+	m_pendingMessages.push_back({ PlayerHandle::FromUserData(peer->data), packet });
+}
+
+void Room::Replay(const ReplayRecord& record, ENetPeer* peer)
+{
+	TickScheduler& scheduler = m_gameData.scheduler;
+
+	switch (record.type)
+	{
+		case ReplayRecordType::Connect:
+		{
+			HandleConnect(peer);
+
+			// HandleConnect looked at the clock if the room was empty, the recorded tick is the one which matters
+			scheduler.SetTick(record.tick);
+
+			if (PlayerHandle::FromUserData(peer->data).index != record.slot)
+				throw std::runtime_error("replay diverged: player didn't get the recorded slot");
+
+			break;
+		}
+
+		case ReplayRecordType::Disconnect:
+		{
+			if (!find_peer_player(m_gameData, peer))
+				throw std::runtime_error("replay diverged: no player to disconnect in the recorded slot");
+
+			scheduler.SetTick(record.tick);
+			HandleDisconnect(peer);
+			break;
+		}
+
+		case ReplayRecordType::Message:
+		{
+			// The messages of an update are all handled at the tick it started on
+			scheduler.SetTick(record.tick);
+			PushMessage(peer, enet_packet_create(record.message.data, record.message.size, 0));
+			break;
+		}
+
+		case ReplayRecordType::Update:
+		{
+			HandleMessages();
+
+			// The recorded tick already skips the ticks the server dropped
+			scheduler.SetTick(record.tick);
+			RunTicks(record.tickCount);
+			break;
+		}
+	}
+}
+
+void Room::SetMaxPlayerCount(std::size_t maxPlayerCount)
+{
+	assert(maxPlayerCount > 0 && maxPlayerCount <= MaxPlayerCount);
+	m_maxPlayerCount = maxPlayerCount;
+}
+
+void Room::SetStateBudget(std::size_t budget)
+{
+	m_networkSystem.SetStateBudget(budget);
+}
+
+void Room::StartRecording(const std::string& filePath)
+{
+	static_assert(MaxPlayerCount <= 256, "replay records store player slots on 8 bits");
+
+	// Players already in the room wouldn't be in the recording
+	assert(m_gameData.players.IsEmpty());
+
+	m_recorder = std::make_unique<ReplayRecorder>(filePath, m_seed);
+}
+
+void Room::Update()
+{
+	GameData& gameData = m_gameData;
+
+	HandleMessages();
+
+	if (gameData.players.IsEmpty())
+		return;
+
+	// Runs every tick which is due, the scheduler drops them if we're too late
+	std::uint64_t droppedTicks = gameData.scheduler.GetDroppedTicks();
+	std::uint32_t dueTicks = gameData.scheduler.CollectDueTicks();
+	if (gameData.scheduler.GetDroppedTicks() != droppedTicks)
+		log_warning("Room #{} is running late, {} ticks dropped", m_index, gameData.scheduler.GetDroppedTicks() - droppedTicks);
+
+	if (m_recorder)
+		m_recorder->RecordUpdate(gameData.scheduler.GetTick(), dueTicks);
+
+	RunTicks(dueTicks);
+}
+
+void Room::HandleMessages()
+{
+	GameData& gameData = m_gameData;
+
+	for (const PendingMessage& message : m_pendingMessages)
+	{
+		// On a reu un message ! Traitons-le
+		// It is decoded in place from the ENet packet, which stays alive until we destroy it below
+		Player* player = gameData.players.Get(message.player);
+		if (player)
+		{
+			ByteSpan bytes(message.packet->data, message.packet->dataLength);
+			if (m_recorder)
+				m_recorder->RecordMessage(gameData.scheduler.GetTick(), player->index, bytes);
+
+			if (!m_messageDispatcher.Dispatch(bytes, *player, gameData, m_networkSystem))
+				log_warning("Unhandled message from player #{} of room #{}", player->index, m_index);
+		}
+
+		// On n'oublie pas de librer le packet
+		enet_packet_destroy(message.packet);
+	}
+	m_pendingMessages.clear();
+}
+
+void Room::RunTicks(std::uint32_t tickCount)
+{
+	GameData& gameData = m_gameData;
+
+	for (std::uint32_t i = 0; i < tickCount; ++i)
+	{
+		RunTick();
+		gameData.scheduler.EndTick();
+	}
+
+	// Countdown until game starts when all brawlers are ready
+	if (gameData.gamesState == GameState::Lobby && gameData.allReady && gameData.scheduler.GetTick() >= gameData.gameStartTick)
+	{
+		gameData.allReady = false;
+		gameData.gamesState = GameState::GameRunning;
+
+		start_game(gameData);
+
+		log_info("START GAME!");
+
+
+		UpdateGameStatePacket packet;
+		packet.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+
+		broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::Playing);
+	}
+}
+
+void Room::RunTick()
+{
+	GameData& gameData = m_gameData;
+
+	std::uint64_t now = gameData.scheduler.GetTick();
+
+	TickProfiler::Scope tickScope(gameData.profiler, TickPhase::Tick);
+
+	//worldLimit.Update();
+
+	// On met  jour la logique du jeu
+	tick(gameData, m_velocitySystem, m_networkSystem, m_collectibleSystem);
+
+	if (gameData.gamesState == GameState::GameRunning)
+	{
+		TickProfiler::Scope winCheckScope(gameData.profiler, TickPhase::WinCheck);
+
+		auto brawlerView = gameData.registry.view<BrawlerFlag>(entt::exclude<DeadFlag>);
+		int brawlerCount = std::distance(brawlerView.begin(), brawlerView.end());
+
+		if (brawlerCount <= 1)
+		{
+			// There's only one brawler left, find it
+			for (auto entity : brawlerView)
+			{
+				// Get the NetworkComponent of the last remaining brawler
+				auto& networkComp = gameData.registry.get<NetworkedComponent>(entity);
+				auto lastNetworkID = networkComp.networkId;
+
+				// Find the player whose ownBrawlerNetworkID matches lastNetworkID
+				auto it = std::find_if(gameData.playingPlayers.begin(), gameData.playingPlayers.end(),
+					[&](PlayerHandle handle)
+					{
+						return gameData.players.Get(handle)->ownBrawlerNetworkId == lastNetworkID;
+					});
+
+				if (it != gameData.playingPlayers.end())
+				{
+					// Store the last winner in gameData
+					gameData.lastWinner = *it;
+
+					log_info("{} wins -> END GAME", gameData.players.Get(gameData.lastWinner)->name);
+				}
+			}
+
+			gameData.gamesState = GameState::EndScreen;
+			end_game(gameData);
+		}
+		else
+		{
+			winCheckScope.Stop();
+
+			TickProfiler::Scope goldenCarrotScope(gameData.profiler, TickPhase::GoldenCarrot);
+
+			// Spawn de la carotte legendaire
+			if (brawlerCount > 0 && now >= gameData.goldenCarrot.spawnTick && !gameData.goldenCarrot.isSpawned)
+			{
+				gameData.goldenCarrot.handle = spawn_collectible(gameData, CollectibleType::GoldenCarrot);
+				gameData.goldenCarrot.isSpawned = true;
+
+				// On notifie tout le monde
+				GoldenEventPacket packet;
+				packet.eventType = GoldenEventPacket::GoldenEventType::Spawn;
+
+				broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
+			}
+
+			// Add point to the brawler owning the golden carrot
+			if (
+				brawlerCount > 0
+				&& gameData.goldenCarrot.isSpawned
+				&& gameData.goldenCarrot.owningBrawlerId.has_value()
+				&& now >= gameData.goldenCarrot.nextPulseTick
+				)
+			{
+				// Find the player controlling the brawler and send him a packet to notify he got a collectible
+				auto it = std::find_if(gameData.players.begin(), gameData.players.end(), [&](const Player& player) { return player.ownBrawlerNetworkId == gameData.goldenCarrot.owningBrawlerId; });
+				if (it != gameData.players.end())
+				{
+					Player& player = *it;
+
+					// Update its score
+					player.playerScore++;
+					update_leaderboard(gameData, player);
+				}
+				gameData.goldenCarrot.nextPulseTick = now + gameData.scheduler.ToTicks(gameData.goldenCarrot.pulseTime);
+			}
+
+			goldenCarrotScope.Stop();
+
+			TickProfiler::Scope spawnScope(gameData.profiler, TickPhase::Spawn);
+
+			std::size_t collectibleCount = gameData.registry.view<CollectibleFlag>().size() - gameData.collectiblePool.GetInactiveCount();
+
+			// On check s'il y a au moins un brawler et si le nombre de collectibles est inferieur au maximum autorise
+			if (brawlerCount > 0 && collectibleCount < gameData.collectibleMaxCount)
+			{
+				if (now >= gameData.nextCollectibleSpawnTick)
+				{
+					spawn_collectible(gameData);
+					/*std::cout << "Spawn Collectible now - " << collectibleCount + 1 << std::endl;*/
+					gameData.nextCollectibleSpawnTick = now + gameData.scheduler.ToTicks(gameData.collectibleSpawnInterval);  // Prochain spawn X seconds apres mtnt
+				}
+			}
+
+			spawnScope.Stop();
+
+			TickProfiler::Scope killScope(gameData.profiler, TickPhase::Kill);
+
+			// System qui kill le dernier  interval rgulier
+			if (brawlerCount > 0 && now >= gameData.nextKillTick)
+			{
+
+				// Backward: a dead player only moves down, to ranks which were already visited
+				const auto& leaderboardEntries = gameData.leaderBoard.GetEntries();
+				for (std::size_t i = leaderboardEntries.size(); i-- > 0;)
+				{
+					Player& player = *gameData.players.Get(leaderboardEntries[i].player);
+
+					if (player.isDead)
+						continue;
+
+					// Set the player as dead
+					player.isDead = true;
+					update_leaderboard(gameData, player);
+
+					log_info("{}'s brawler has been killed", player.name);
+
+					if (!player.ownBrawlerNetworkId)
+						continue;
+
+					// Find the brawler associated with this player in the NetworkToEntities map
+					auto entityIt = gameData.networkToEntity.find(player.ownBrawlerNetworkId.value());
+					if (entityIt != gameData.networkToEntity.end())
+					{
+						// Add DeadFlag to the entity
+						gameData.registry.emplace_or_replace<DeadFlag>(entityIt->second);
+
+						Sel::Vector2f deathPosition;
+						std::int8_t deathScaleX = 1.f;
+						auto transform = gameData.registry.try_get<Sel::Transform>(entityIt->second);
+						if (transform)
+						{
+							deathPosition = transform->GetGlobalPosition();
+							deathScaleX = transform->GetScale().x;
+							transform->SetPosition({ -20000.f, -20000.f }); // On le place trs loin
+						}
+
+						// S'il avait la golden carrot on la remet en jeu
+						if (gameData.goldenCarrot.owningBrawlerId == player.ownBrawlerNetworkId)
+						{
+							// On notifie tout le monde
+							GoldenEventPacket packet;
+							packet.eventType = GoldenEventPacket::GoldenEventType::Released;
+
+							packet.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
+
+							broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
+
+							gameData.goldenCarrot.handle.try_get<Sel::Transform>()->SetPosition(deathPosition);
+							gameData.goldenCarrot.owningBrawlerId.reset();
+						}
+
+						// On notifie tout les joueurs de cette mort
+						BrawlerDeathPacket packet;
+						packet.playerId = player.index;
+						packet.brawlerId = player.ownBrawlerNetworkId.value();
+						packet.deathPosition = deathPosition;
+						packet.deathScaleX = deathScaleX;
+
+						broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::Playing);
+					}
+
+					break;
+				}
+
+				gameData.nextKillTick = now + gameData.scheduler.ToTicks(gameData.killInterval);
+			}
+
+
+		}
+
+
+
+	}
+
+	// Every leaderboard change of the tick (collections, golden carrot pulses, deaths, departures) in a single packet
+	TickProfiler::Scope leaderboardScope(gameData.profiler, TickPhase::Leaderboard);
+	flush_leaderboard(gameData);
+}
+
+Player* find_peer_player(GameData& gameData, ENetPeer* peer)
+{
+	return gameData.players.Get(PlayerHandle::FromUserData(peer->data));
+}
+
+ENetPacket* build_playerlist_packet(GameData& gameData)
+{
+	// Construisons le packet de liste de joueur
+	PlayerListPacket packet;
+	for (const Player& player : gameData.players)
+	{
+		if (player.peer != nullptr && !player.name.empty()) //< Est-ce que le slot est occup par un joueur (et est-ce que ce joueur a bien envoy son nom) ?
+		{
+			// Oui, rajoutons-le  la liste
+			auto& packetPlayer = packet.players.emplace_back();
+			packetPlayer.name = player.name;
+			if (player.ownBrawlerNetworkId.has_value())
+			{
+				packetPlayer.id = player.index;
+				packetPlayer.hasBrawler = true;
+				packetPlayer.isDead = player.isDead;
+				packetPlayer.brawlerId = player.ownBrawlerNetworkId.value();
+			}
+			else
+			{
+				packetPlayer.id = player.index;
+				packetPlayer.hasBrawler = false;
+				packetPlayer.isDead = player.isDead;
+				packetPlayer.brawlerId.reset();
+			}
+		}
+	}
+
+	return build_packet(packet, ENET_PACKET_FLAG_RELIABLE);
+}
+
+void handle_player_name(Player& player, GameData& gameData, NetworkSystem& networkSystem, PlayerNamePacket& playerName)
+{
+	// On rduit la taille du nom si elle est trop longue pour viter les petits malins (oui je vous voir venir)
+	if (playerName.name.size() > MaxPlayerNameLength)
+		playerName.name.resize(MaxPlayerNameLength);
+
+	log_info("Player #{} is {}", player.index, playerName.name);
+	player.name = playerName.name;
+
+	// Envoyons la liste des joueurs
+	broadcast_packet(gameData, build_playerlist_packet(gameData), Recipients::Named);
+
+	// The others only get the new name, the player needs the whole leaderboard of the game being played (they only receive its changes afterwards)
+	PlayerHandle handle = gameData.players.GetHandle(player.index);
+	gameData.leaderBoard.MarkNameChanged(handle);
+	if (gameData.gamesState != GameState::Lobby)
+		send_packet(gameData, player.peer, build_leaderboard_packet(gameData));
+
+	// On cr toutes les entits de son ct
+	networkSystem.CreateAllEntities(player);
+
+	// On lui envoie l'tat du jeu et par consquent son player mode
+	UpdateGameStatePacket gameStatePacket;
+	gameStatePacket.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+
+	UpdatePlayerModePacket playerModePacket;
+	if (gameData.gamesState == GameState::Lobby)
+	{
+		player.isDead = false;
+		playerModePacket.newPlayerMode = static_cast<std::uint8_t>(PlayerMode::Playing);
+	}
+	else
+	{
+		player.isDead = true;
+		playerModePacket.newPlayerMode = static_cast<std::uint8_t>(PlayerMode::Spectating);
+	}
+
+	send_packet(gameData, player.peer, build_packet(playerModePacket, ENET_PACKET_FLAG_RELIABLE));
+	//send_packet(gameData, player.peer, build_packet(gameStatePacket, ENET_PACKET_FLAG_RELIABLE));
+}
+
+void handle_create_brawler_request(Player& player, GameData& gameData, NetworkSystem& /*networkSystem*/, CreateBrawlerResquest& /*packet*/)
+{
+	log_debug("Player {} wants to spawn its brawler", player.name);
+
+	// On cree le brawler cot serveur
+	Brawler brawler(gameData.registry, Sel::Vector2f(0.f, 0.f), 0.f, 1.f, Sel::Vector2f(10.f, 0.f));
+
+	//skin
+	std::uniform_int_distribution<int> skinDistribution(1, 3);
+	player.skinIndex = skinDistribution(gameData.randomGenerator);
+
+	// on lui donne l'id de son player
+	auto flag = brawler.GetHandle().try_get<BrawlerFlag>();
+	if (flag)
+	{
+		flag->playerId = player.index;
+		flag->skinId = player.skinIndex;
+	}
+
+	auto network = brawler.GetHandle().try_get<NetworkedComponent>();
+	if (!network)
+		return;
+
+	// On l'ajoute  la liste d'entit
+	gameData.networkToEntity[network->networkId] = brawler.GetHandle();
+
+	// On renvois au createur l'id rseaux de son brawler
+	UpdateSelfBrawlerId updateSelfBrawlerIdPacket;
+	updateSelfBrawlerIdPacket.id = network->networkId;
+
+	send_packet(gameData, player.peer, build_packet(updateSelfBrawlerIdPacket, ENET_PACKET_FLAG_RELIABLE));
+
+	player.ownBrawlerNetworkId = network->networkId;
+	player.brawler = std::move(brawler);
+
+	// Clients far from this brawler won't receive its creation, they learn its id with the player list
+	broadcast_packet(gameData, build_playerlist_packet(gameData), Recipients::Named);
+}
+
+void handle_player_inputs(Player& player, GameData& /*gameData*/, NetworkSystem& networkSystem, PlayerInputsPacket& packet)
+{
+	// Inputs also acknowledge the last snapshot the client applied, it becomes its delta baseline (spectators send them too)
+	if (packet.lastSnapshotId > player.lastAckedSnapshotId && packet.lastSnapshotId <= networkSystem.GetLastSnapshotId())
+		player.lastAckedSnapshotId = packet.lastSnapshotId;
+
+	// They're applied by the tick, one per tick (see InputBuffer), the oldest first: inputs[i] is from inputTick - i
+	for (std::size_t i = packet.inputCount; i-- > 0;)
+	{
+		if (i <= packet.inputTick)
+			player.inputBuffer.Push(packet.inputTick - static_cast<std::uint32_t>(i), packet.inputs[i], i > 0);
+	}
+}
+
+void handle_player_ready(Player& player, GameData& gameData, NetworkSystem& /*networkSystem*/, PlayerReadyPacket& packet)
+{
+	if (gameData.gamesState == GameState::EndScreen)
+	{
+		gameData.gamesState = GameState::Lobby;
+
+		// On ramne tout le monde au centre
+		auto view = gameData.registry.view<Sel::Transform, BrawlerFlag>();
+		for (auto&& [entity, transform, flag] : view.each())
+		{
+			transform.SetPosition(Sel::Vector2f(0.f, 0.f));
+
+			if (gameData.registry.all_of<DeadFlag>(entity))
+				gameData.registry.remove<DeadFlag>(entity);
+		}
+
+		UpdateGameStatePacket packet;
+		packet.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+		
+		for (auto& player : gameData.players)
+		{
+			if (!player.peer)
+				continue;
+					
+			player.isReady = false;
+			player.isDead = false;
+		}
+
+		broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
+
+		return;
+	}
+
+	log_debug("player {} ready state is: {}", player.index, packet.newReadyValue);
+	player.isReady = packet.newReadyValue;
+
+
+	// Qqn se met pas prt
+	if (!packet.newReadyValue)
+	{
+		gameData.allReady = false;
+		return;
+	}
+
+	bool allReady = true;
+	for (const auto& player : gameData.players)
+	{
+		if (!player.peer)
+		{
+			continue;
+		}
+
+		if (player.isReady)
+			continue;
+
+		allReady = false;
+		break;
+	}
+
+	if (allReady)
+	{
+		gameData.gameStartTick = gameData.scheduler.GetTick() + gameData.scheduler.ToTicks(gameData.gameStartDelay);
+		gameData.allReady = true;
+	}
+}
+
+void handle_player_steal_request(Player& /*player*/, GameData& gameData, NetworkSystem& networkSystem, PlayerStealPacketRequest& packet)
+{
+	// On informe tout le monde qu'un brawler tente un vol (pour jouer l'animation chez tous les clients)
+	PlayerStealPacket stealPacket;
+	stealPacket.brawlerId = packet.brawlerId;
+
+	broadcast_packet(gameData, stealPacket, ENET_PACKET_FLAG_RELIABLE, Recipients::Playing);
+
+	
+	if (!gameData.goldenCarrot.isSpawned || !gameData.goldenCarrot.owningBrawlerId.has_value())
+		return;
+
+	auto itStealer = gameData.networkToEntity.find(packet.brawlerId);
+	if (itStealer == gameData.networkToEntity.end())
+		return;
+
+	if (itStealer->first == gameData.goldenCarrot.owningBrawlerId.value()) // Le voler est deja le detenteur de la carotte
+		return;
+
+	TickProfiler::Scope rewindScope(gameData.profiler, TickPhase::StealRewind);
+
+	// The stealer aimed at what its screen showed: the range is checked at the last snapshot its client applied (no further back than MaxStealRewind)
+	std::uint32_t ownerId = gameData.goldenCarrot.owningBrawlerId.value();
+	std::uint32_t lastSnapshotId = networkSystem.GetLastSnapshotId();
+	std::uint32_t rewind = (packet.viewSnapshotId <= lastSnapshotId) ? std::min(lastSnapshotId - packet.viewSnapshotId, MaxStealRewind) : 0;
+
+	auto findPastState = [](const SnapshotStates& states, std::uint32_t brawlerId) -> const BrawlerStatesPacket::States*
+	{
+		auto it = std::lower_bound(states.begin(), states.end(), brawlerId, [](const auto& state, std::uint32_t id) { return state.brawlerId < id; });
+		return (it != states.end() && it->brawlerId == brawlerId) ? &*it : nullptr;
+	};
+
+	const BrawlerStatesPacket::States* pastStealer = nullptr;
+	const BrawlerStatesPacket::States* pastOwner = nullptr;
+	if (const SnapshotStates* pastStates = networkSystem.GetPastStates(lastSnapshotId - rewind))
+	{
+		pastStealer = findPastState(*pastStates, packet.brawlerId);
+		pastOwner = findPastState(*pastStates, ownerId);
+	}
+
+	bool isOwnerInRange = false;
+	if (pastStealer && pastOwner)
+		isOwnerInRange = (pastOwner->position - pastStealer->position).SquaredMagnitude() <= StealRadius * StealRadius;
+	else
+	{
+		// One of them didn't exist back then, current positions are used
+		rewind = 0;
+
+		Sel::Vector2f transformStealerPosition = itStealer->second.try_get<Sel::Transform>()->GetGlobalPosition();
+
+		// On cherche le porteur de la carotte parmi les brawlers proches (le grid date du dernier tick, rien n'a boug depuis)
+		gameData.brawlerGrid.ForEachInRadius(transformStealerPosition, StealRadius, [&](const SpatialGrid::Item& brawler)
+		{
+			// The brawler may have been destroyed since the grid was built
+			if (!gameData.registry.valid(brawler.entity))
+				return;
+
+			auto network = gameData.registry.try_get<NetworkedComponent>(brawler.entity);
+			if (network && network->networkId == ownerId)
+				isOwnerInRange = true;
+		});
+	}
+
+	rewindScope.Stop();
+
+	if (!isOwnerInRange)
+	{
+		log_debug("no steal ({} snapshots back)", rewind);
+		return;
+	}
+
+	// On notifie tout le monde
+	GoldenEventPacket goldenEventPacket;
+	goldenEventPacket.eventType = GoldenEventPacket::GoldenEventType::Steal;
+
+	goldenEventPacket.previousOwner = gameData.goldenCarrot.owningBrawlerId.value();
+	goldenEventPacket.newOwner = packet.brawlerId;
+
+	broadcast_packet(gameData, goldenEventPacket, ENET_PACKET_FLAG_RELIABLE, Recipients::All);
+
+	log_info("steal ({} snapshots back)", rewind);
+	gameData.goldenCarrot.owningBrawlerId = packet.brawlerId;
+}
+
+void handle_spectate_target(Player& player, GameData& /*gameData*/, NetworkSystem& /*networkSystem*/, SpectateTargetPacket& packet)
+{
+	// Only used to know what the client sees (see NetworkSystem), an unknown brawler is simply ignored there
+	player.spectatedBrawlerId = packet.brawlerId;
+}
+
+void register_message_handlers(MessageDispatcher<Player&, GameData&, NetworkSystem&>& dispatcher)
+{
+	dispatcher.Register<PlayerNamePacket>(&handle_player_name);
+	dispatcher.Register<CreateBrawlerResquest>(&handle_create_brawler_request);
+	dispatcher.Register<PlayerInputsPacket>(&handle_player_inputs);
+	dispatcher.Register<PlayerReadyPacket>(&handle_player_ready);
+	dispatcher.Register<PlayerStealPacketRequest>(&handle_player_steal_request);
+	dispatcher.Register<SpectateTargetPacket>(&handle_spectate_target);
+}
+
+
+void tick(GameData& gameData, Sel::VelocitySystem& velocitySystem, NetworkSystem& networkSystem, CollectibleSystem& collectibleSystem)
+{
+	{
+		TickProfiler::Scope scope(gameData.profiler, TickPhase::Inputs);
+
+		// Everyone's buffer is consumed at the same pace, even if its inputs are ignored (spectators send them too)
+		for (Player& player : gameData.players)
+		{
+			std::optional<PlayerInputs> inputs = player.inputBuffer.Pop();
+
+			// On applique ses input si son brawler n'est pas mort
+			if (inputs && player.brawler && !player.isDead && gameData.gamesState != GameState::EndScreen)
+				player.brawler->ApplyInputs(*inputs);
+		}
+	}
+
+	// On fait avancer le monde
+	{
+		TickProfiler::Scope scope(gameData.profiler, TickPhase::Velocity);
+		velocitySystem.Update(TickDelay);
+	}
+
+	{
+		TickProfiler::Scope scope(gameData.profiler, TickPhase::Network);
+		networkSystem.Update();
+	}
+
+	TickProfiler::Scope boundsClampScope(gameData.profiler, TickPhase::BoundsClamp);
+
+	auto view = gameData.registry.view<Sel::Transform, BrawlerFlag>(entt::exclude<DeadFlag>);
+	for (auto&& [entity, transform, flag] : view.each())
+	{
+		Sel::Vector2f position = transform.GetPosition();
+
+		// Clamp the position between -WorldHalfSize and WorldHalfSize for each axis
+		position.x = std::clamp(position.x, -WorldHalfSize, WorldHalfSize);
+		position.y = std::clamp(position.y, -WorldHalfSize, WorldHalfSize);
+
+		// Set the clamped position back to the transform
+		transform.SetPosition(position);
+
+		gameData.brawlerGrid.Insert(entity, position);
+	}
+
+	// Pickups and steals only look at the brawlers around them
+	gameData.brawlerGrid.Build();
+
+	boundsClampScope.Stop();
+
+	if (gameData.gamesState == GameState::GameRunning)
+	{
+		// Update the collectible system (the scores it changes are sent with the other leaderboard changes at the end of the tick)
+		TickProfiler::Scope collectiblesScope(gameData.profiler, TickPhase::Collectibles);
+		collectibleSystem.Update(gameData);
+	}
+}
+
+entt::handle spawn_collectible(GameData& gameData, const CollectibleType& type)
+{
+	// random spawn position
+	std::uniform_real_distribution<float> disX(-900.f, 900.f);
+	std::uniform_real_distribution<float> disY(-900.f, 900.f);
+
+	float spawnX = disX(gameData.randomGenerator);
+	float spawnY = disY(gameData.randomGenerator);
+
+	// A collected carrot respawns here, clients which know it only get its new position
+	if (type != CollectibleType::GoldenCarrot)
+	{
+		entt::entity pooledCollectible = gameData.collectiblePool.Acquire({ spawnX, spawnY });
+		if (pooledCollectible != entt::null)
+			return entt::handle(gameData.registry, pooledCollectible);
+
+		gameData.collectiblePool.NotifyCreated();
+	}
+
+	entt::entity newCollectible = gameData.registry.create();
+
+	auto& transform = gameData.registry.emplace<Sel::Transform>(newCollectible);
+	if(type == CollectibleType::GoldenCarrot)
+		transform.SetPosition({ 0.f, 0.f });
+	else
+		transform.SetPosition({ spawnX, spawnY });
+	transform.SetRotation(0.f);
+	transform.SetScale({ 1.f, 1.f });
+
+	// The server synchronize position of the entity with velocity component. 
+	// Collectibles are moved in/out the game space instead of being instantiated/destroyed (the golden carrot when it's catch/released, carrots when they're collected/respawned)
+	// So I add it that velocity component even if it is not really moving so that in/out get sync on client 
+	// That might be not clean
+	auto& velocity = gameData.registry.emplace<Sel::VelocityComponent>(newCollectible);
+	velocity.linearVel = { 0.f, 0.f };
+
+	auto& network = gameData.registry.emplace<NetworkedComponent>(newCollectible);
+
+	auto& collectibleFlag = gameData.registry.emplace<CollectibleFlag>(newCollectible);
+	collectibleFlag.type = type;
+
+	if(type == CollectibleType::GoldenCarrot)
+		gameData.registry.emplace<GoldenCarrotFlag>(newCollectible);
+
+	// On cre un handle
+	entt::handle handle = entt::handle(gameData.registry, newCollectible);
+
+	// On l'ajoute  la liste d'entit
+	gameData.networkToEntity[network.networkId] = handle;
+
+	return handle;
+}
+
+void start_game(GameData& gameData)
+{
+	gameData.playingPlayers.clear();
+	gameData.leaderBoard.Clear(); //< the whole leaderboard is sent at the end of the tick
+
+	for (auto& player : gameData.players)
+	{
+		if (player.name.empty() || !player.peer || !player.ownBrawlerNetworkId)
+			continue;
+
+		player.playerScore = 0;
+		player.isDead = false;
+
+		PlayerHandle handle = gameData.players.GetHandle(player.index);
+		gameData.playingPlayers.push_back(handle);
+		gameData.leaderBoard.Add(handle, player.playerScore, player.isDead);
+	}
+
+	float goldenCarrotSpawnTime = static_cast<int>(gameData.playingPlayers.size() * 0.5f) * gameData.killInterval + 4.0f; // 4 sec aprs que la moiti des joueurs soient morts
+	//float goldenCarrotSpawnTime = 5.f;
+
+	gameData.goldenCarrot.spawnTick = gameData.scheduler.GetTick() + gameData.scheduler.ToTicks(goldenCarrotSpawnTime);
+
+	gameData.nextKillTick = gameData.scheduler.GetTick() + gameData.scheduler.ToTicks(gameData.killInterval);
+}
+
+void end_game(GameData& gameData)
+{
+	// park all carrots remaining for the next game, the golden carrot is spawned again
+	auto collectiblesView = gameData.registry.view<CollectibleFlag>(entt::exclude<InactiveFlag>);
+	for (auto collectible : collectiblesView)
+	{
+		if (gameData.registry.all_of<GoldenCarrotFlag>(collectible))
+			gameData.registry.destroy(collectible);
+		else
+			gameData.collectiblePool.Release(collectible);
+	}
+
+	// stop movement in case of need (i.e. brawler has been killed but last input received indicate it has to move)
+	auto view = gameData.registry.view<Sel::VelocityComponent>();
+	for (auto&& [entity, velocity] : view.each())
+	{
+		velocity.linearVel = Sel::Vector2f(0.f, 0.f);
+	}
+
+	// reset golden carrot
+	gameData.goldenCarrot.isSpawned = false;
+	gameData.goldenCarrot.owningBrawlerId.reset();
+
+	// Notifions tout le monde qu'il y a un gagnant
+	WinnerPacket packet;
+	packet.brawlerNetworkId = gameData.lastWinner.index;
+
+	UpdateGameStatePacket gameStatePacket;
+	gameStatePacket.newGameState = static_cast<std::uint8_t>(gameData.gamesState);
+
+	// Same order for every peer: the winner, then the new game state
+	broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::Playing);
+	broadcast_packet(gameData, gameStatePacket, ENET_PACKET_FLAG_RELIABLE, Recipients::Playing);
+
+}
+
+// Player ids and ranks are 16 bits in LeaderboardDeltaPacket
+static_assert(Room::MaxPlayerCount <= std::numeric_limits<std::uint16_t>::max());
+
+void flush_leaderboard(GameData& gameData)
+{
+	Leaderboard& leaderboard = gameData.leaderBoard;
+	if (!leaderboard.HasChanges())
+		return;
+
+	// A new game sends the whole leaderboard, then only what changed during the tick
+	if (leaderboard.NeedsFullUpdate())
+	{
+		broadcast_packet(gameData, build_leaderboard_packet(gameData), Recipients::Named);
+		leaderboard.ResetChanges();
+		return;
+	}
+
+	LeaderboardDeltaPacket packet;
+	for (PlayerHandle handle : leaderboard.GetRemovedPlayers())
+		packet.removedPlayers.push_back(static_cast<std::uint16_t>(handle.index));
+
+	const auto& entries = leaderboard.GetEntries();
+	for (std::size_t rank = 0; rank < entries.size(); ++rank)
+	{
+		const Leaderboard::Entry& entry = entries[rank];
+		if (entry.changes == 0)
+			continue;
+
+		auto& data = packet.entries.emplace_back();
+		data.playerId = static_cast<std::uint16_t>(entry.player.index);
+		data.rank = static_cast<std::uint16_t>(rank);
+
+		if (entry.isDead)
+			data.flags |= LeaderboardDeltaPacket::IsDead;
+
+		if (entry.changes & (Leaderboard::Added | Leaderboard::ScoreChanged))
+		{
+			data.flags |= LeaderboardDeltaPacket::Score;
+			data.playerScore = entry.score;
+		}
+
+		if (entry.changes & (Leaderboard::Added | Leaderboard::NameChanged))
+		{
+			data.flags |= LeaderboardDeltaPacket::Name;
+			data.playerName = gameData.players.Get(entry.player)->name;
+		}
+	}
+
+	broadcast_packet(gameData, packet, ENET_PACKET_FLAG_RELIABLE, Recipients::Named);
+	leaderboard.ResetChanges();
+}
+
+ENetPacket* build_leaderboard_packet(GameData& gameData)
+{
+	UpdateLeaderboardPacket packet;
+
+	for (const Leaderboard::Entry& entry : gameData.leaderBoard.GetEntries())
+	{
+		auto& data = packet.leaderboard.emplace_back();
+		data.playerId = entry.player.index;
+		data.playerName = gameData.players.Get(entry.player)->name;
+		data.playerScore = entry.score;
+		data.isDead = entry.isDead;
+	}
+
+	return build_packet(packet, ENET_PACKET_FLAG_RELIABLE);
+}
+
+void update_leaderboard(GameData& gameData, const Player& player)
+{
+	gameData.leaderBoard.Update(gameData.players.GetHandle(player.index), player.playerScore, player.isDead);
+}
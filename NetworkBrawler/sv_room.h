@@ -0,0 +1,106 @@
+#pragma once
+
+#include "sh_messagedispatcher.h"
+#include "sv_CollectibleSystem.h"
+#include "sv_gamedata.h"
+#include "sv_networksystem.h"
+#include "sv_replay.h"
+#include <Sel/VelocitySystem.hpp>
+#include <enet6/enet.h>
+#include <entt/entt.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One match: its own registry, systems, timers and players.
+// Rooms don't share anything, so the server updates them in parallel (see Update), while everything touching ENet stays on the network thread.
+// Everything but Update is called by the simulation thread while no room is being updated.
+class Room
+{
+public:
+	// Players joining once every room is full open a new room. A room is full at SetMaxPlayerCount players, MaxPlayerCount by default:
+	// a single match can then hold every player the host accepts
+	static constexpr std::size_t MaxPlayerCount = MaxPlayers;
+
+	// seed is the seed of the room's random generator (a replay uses the recorded one)
+	Room(std::size_t index, std::uint32_t seed);
+	Room(const Room&) = delete;
+	Room(Room&&) = delete;
+	~Room() = default;
+
+	// Packets the room queued since the last ClearOutbox, to hand to the network thread
+	void ClearOutbox();
+	const std::vector<OutgoingPacket>& GetOutbox() const;
+
+	void DumpCounters(std::ostream& out) const;
+	// Input buffer depth and drops of every player since the last call (see InputBuffer)
+	void DumpInputs(std::ostream& out);
+	// Tick phase timings since the last call (see TickProfiler)
+	void DumpProfile(std::ostream& out);
+	// State replication stats of every player since the last call (see ReplicationStats)
+	void DumpReplication(std::ostream& out);
+
+	std::size_t GetIndex() const;
+	std::size_t GetPlayerCount() const;
+	// Milliseconds until the next tick of the room (uint32 max when nobody's in the room, nothing runs then)
+	std::uint32_t GetWaitTime() const;
+
+	// Connections and disconnections are handled right away
+	void HandleConnect(ENetPeer* peer);
+	void HandleDisconnect(ENetPeer* peer);
+
+	// Are there messages to handle or ticks to run
+	bool HasWork() const;
+
+	bool IsFull() const;
+
+	// The message is handled (and the packet destroyed) during the next update
+	void PushMessage(ENetPeer* peer, ENetPacket* packet);
+
+	// Applies a recorded record instead of what the network and the clock would do, peer stands for the player of record.slot
+	// Throws if the room doesn't follow the recording anymore
+	void Replay(const ReplayRecord& record, ENetPeer* peer);
+
+	// Players the room accepts before being full (at most MaxPlayerCount)
+	void SetMaxPlayerCount(std::size_t maxPlayerCount);
+
+	// Bytes of state updates each player may receive per snapshot (see NetworkSystem)
+	void SetStateBudget(std::size_t budget);
+
+	// Everything which drives the room from now on is written to the file (see ReplayRecorder)
+	void StartRecording(const std::string& filePath);
+
+	// Any thread: handles the received messages then runs the due ticks
+	void Update();
+
+	Room& operator=(const Room&) = delete;
+	Room& operator=(Room&&) = delete;
+
+private:
+	void HandleMessages();
+	void RunTick();
+	// Runs tickCount ticks then the game start countdown
+	void RunTicks(std::uint32_t tickCount);
+
+	struct PendingMessage
+	{
+		PlayerHandle player;
+		ENetPacket* packet;
+	};
+
+	entt::registry m_registry;
+	GoldenCarrot m_goldenCarrot;
+	GameData m_gameData;
+	Sel::VelocitySystem m_velocitySystem;
+	NetworkSystem m_networkSystem;
+	CollectibleSystem m_collectibleSystem;
+	MessageDispatcher<Player&, GameData&, NetworkSystem&> m_messageDispatcher;
+	std::vector<PendingMessage> m_pendingMessages;
+	std::unique_ptr<ReplayRecorder> m_recorder; //< null when the room isn't recorded
+	std::size_t m_index;
+	std::size_t m_maxPlayerCount;
+	std::uint32_t m_seed;
+};
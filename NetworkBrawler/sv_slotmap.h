@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Identifies an element of a SlotMap: the generation tells apart the successive elements stored in the same slot, a stale handle doesn't resolve anymore
+struct SlotHandle
+{
+	static constexpr std::uint32_t InvalidIndex = 0xFFFFFFFF;
+
+	std::uint32_t index = InvalidIndex;
+	std::uint32_t generation = 0; //< generations start at 1, a valid handle is never all zeros
+
+	bool IsValid() const { return index != InvalidIndex; }
+
+	// Handles fit in a user data pointer (ENetPeer::data), a null pointer gives back an invalid handle
+	void* ToUserData() const
+	{
+		static_assert(sizeof(void*) >= sizeof(std::uint64_t), "handles need 64-bit pointers");
+
+		if (!IsValid())
+			return nullptr;
+
+		return reinterpret_cast<void*>(static_cast<std::uintptr_t>((static_cast<std::uint64_t>(generation) << 32) | index));
+	}
+
+	static SlotHandle FromUserData(const void* userData)
+	{
+		if (!userData)
+			return SlotHandle{};
+
+		std::uint64_t value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(userData));
+
+		SlotHandle handle;
+		handle.index = static_cast<std::uint32_t>(value & 0xFFFFFFFF);
+		handle.generation = static_cast<std::uint32_t>(value >> 32);
+
+		return handle;
+	}
+
+	bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const SlotHandle& other) const { return !operator==(other); }
+};
+
+// Stores elements in slots which are reused once freed, lookups by handle are O(1) and check the generation.
+// Inserting can reallocate the slots: keep handles, not pointers or references, across insertions.
+// Iteration only visits the live elements, in slot order.
+template<typename T>
+class SlotMap
+{
+	struct Slot
+	{
+		std::optional<T> value;
+		std::uint32_t generation = 1;
+	};
+
+	template<bool IsConst>
+	class Iterator
+	{
+		using SlotPtr = std::conditional_t<IsConst, const Slot*, Slot*>;
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = std::conditional_t<IsConst, const T*, T*>;
+		using reference = std::conditional_t<IsConst, const T&, T&>;
+
+		Iterator() = default;
+		Iterator(SlotPtr slot, SlotPtr end) : m_slot(slot), m_end(end) { SkipFreeSlots(); }
+
+		reference operator*() const { return *m_slot->value; }
+		pointer operator->() const { return &*m_slot->value; }
+
+		Iterator& operator++() { ++m_slot; SkipFreeSlots(); return *this; }
+		Iterator operator++(int) { Iterator it = *this; ++(*this); return it; }
+
+		bool operator==(const Iterator& other) const { return m_slot == other.m_slot; }
+		bool operator!=(const Iterator& other) const { return m_slot != other.m_slot; }
+
+	private:
+		void SkipFreeSlots()
+		{
+			while (m_slot != m_end && !m_slot->value)
+				++m_slot;
+		}
+
+		SlotPtr m_slot = nullptr;
+		SlotPtr m_end = nullptr;
+	};
+
+public:
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	SlotMap() = default;
+	SlotMap(const SlotMap&) = delete;
+	SlotMap(SlotMap&&) = default;
+	~SlotMap() = default;
+
+	iterator begin() { return iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+	const_iterator begin() const { return const_iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+	iterator end() { return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+	const_iterator end() const { return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+
+	T* Get(SlotHandle handle)
+	{
+		if (handle.index >= m_slots.size())
+			return nullptr;
+
+		Slot& slot = m_slots[handle.index];
+		if (slot.generation != handle.generation || !slot.value)
+			return nullptr;
+
+		return &*slot.value;
+	}
+
+	const T* Get(SlotHandle handle) const
+	{
+		return const_cast<SlotMap*>(this)->Get(handle);
+	}
+
+	// Handle of the element stored at index (invalid if that slot is free)
+	SlotHandle GetHandle(std::uint32_t index) const
+	{
+		if (index >= m_slots.size() || !m_slots[index].value)
+			return SlotHandle{};
+
+		return SlotHandle{ index, m_slots[index].generation };
+	}
+
+	std::size_t GetSize() const { return m_size; }
+
+	template<typename... Args>
+	SlotHandle Insert(Args&&... args)
+	{
+		std::uint32_t index;
+		if (!m_freeSlots.empty())
+		{
+			index = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			index = static_cast<std::uint32_t>(m_slots.size());
+			assert(index != SlotHandle::InvalidIndex);
+			m_slots.emplace_back();
+		}
+
+		Slot& slot = m_slots[index];
+		slot.value.emplace(std::forward<Args>(args)...);
+		m_size++;
+
+		return SlotHandle{ index, slot.generation };
+	}
+
+	bool IsEmpty() const { return m_size == 0; }
+
+	bool Remove(SlotHandle handle)
+	{
+		if (!Get(handle))
+			return false;
+
+		Slot& slot = m_slots[handle.index];
+		slot.value.reset();
+		slot.generation++;
+		if (slot.generation == 0)
+			slot.generation = 1; //< keeps valid handles non-null once stored as user data
+
+		m_freeSlots.push_back(handle.index);
+		m_size--;
+
+		return true;
+	}
+
+	void Reserve(std::size_t capacity)
+	{
+		m_slots.reserve(capacity);
+		m_freeSlots.reserve(capacity);
+	}
+
+	SlotMap& operator=(const SlotMap&) = delete;
+	SlotMap& operator=(SlotMap&&) = default;
+
+private:
+	std::vector<Slot> m_slots;
+	std::vector<std::uint32_t> m_freeSlots;
+	std::size_t m_size = 0;
+};
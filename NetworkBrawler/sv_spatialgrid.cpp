@@ -0,0 +1,73 @@
+#include "sv_spatialgrid.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(const Sel::Vector2f& worldMin, const Sel::Vector2f& worldMax, float cellSize) :
+	m_worldMin(worldMin),
+	m_worldMax(worldMax),
+	m_invCellSize(1.f / cellSize)
+{
+	assert(cellSize > 0.f && worldMax.x > worldMin.x && worldMax.y > worldMin.y);
+
+	m_cellCountX = static_cast<std::size_t>(std::ceil((worldMax.x - worldMin.x) * m_invCellSize));
+	m_cellCountY = static_cast<std::size_t>(std::ceil((worldMax.y - worldMin.y) * m_invCellSize));
+	m_cellStarts.resize(m_cellCountX * m_cellCountY + 1, 0);
+}
+
+void SpatialGrid::Build()
+{
+	std::fill(m_cellStarts.begin(), m_cellStarts.end(), 0);
+
+	// Count the items of each cell (shifted by one), the prefix sum then gives where each cell starts
+	for (const Item& item : m_pendingItems)
+		m_cellStarts[GetCellIndex(item.position) + 1]++;
+
+	for (std::size_t i = 1; i < m_cellStarts.size(); ++i)
+		m_cellStarts[i] += m_cellStarts[i - 1];
+
+	// Items keep their insertion order inside a cell
+	m_items.resize(m_pendingItems.size());
+
+	std::vector<std::uint32_t>& nextSlots = m_cellStarts;
+	for (const Item& item : m_pendingItems)
+	{
+		std::size_t cellIndex = GetCellIndex(item.position);
+		m_items[nextSlots[cellIndex]++] = item;
+	}
+
+	// Filling moved every start to the start of the next cell
+	std::copy_backward(m_cellStarts.begin(), m_cellStarts.end() - 1, m_cellStarts.end());
+	m_cellStarts[0] = 0;
+
+	m_pendingItems.clear();
+}
+
+void SpatialGrid::Clear()
+{
+	m_pendingItems.clear();
+	m_items.clear();
+	std::fill(m_cellStarts.begin(), m_cellStarts.end(), 0);
+}
+
+void SpatialGrid::Insert(entt::entity entity, const Sel::Vector2f& position)
+{
+	if (position.x < m_worldMin.x || position.x > m_worldMax.x || position.y < m_worldMin.y || position.y > m_worldMax.y)
+		return;
+
+	m_pendingItems.push_back({ entity, position });
+}
+
+std::size_t SpatialGrid::GetCellCoordinate(float value, float min, std::size_t cellCount) const
+{
+	float cell = std::floor((value - min) * m_invCellSize);
+	if (cell <= 0.f)
+		return 0;
+
+	return std::min(static_cast<std::size_t>(cell), cellCount - 1);
+}
+
+std::size_t SpatialGrid::GetCellIndex(const Sel::Vector2f& position) const
+{
+	return GetCellCoordinate(position.y, m_worldMin.y, m_cellCountY) * m_cellCountX + GetCellCoordinate(position.x, m_worldMin.x, m_cellCountX);
+}
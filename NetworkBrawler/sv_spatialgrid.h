@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Sel/Vector2.hpp>
+#include <entt/entt.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the bounded world, answering "which entities are within this radius" by only looking at the cells the circle overlaps.
+// It's rebuilt from scratch for things which move every tick: Insert everything, then Build sorts the items by cell (counting sort, O(n)).
+// Items outside the world (such as dead brawlers sent far away) are ignored.
+class SpatialGrid
+{
+public:
+	struct Item
+	{
+		entt::entity entity;
+		Sel::Vector2f position;
+	};
+
+	// A query radius up to cellSize only looks at 3x3 cells
+	SpatialGrid(const Sel::Vector2f& worldMin, const Sel::Vector2f& worldMax, float cellSize);
+	SpatialGrid(const SpatialGrid&) = delete;
+	SpatialGrid(SpatialGrid&&) = delete;
+	~SpatialGrid() = default;
+
+	void Build();
+
+	void Clear();
+
+	// Calls callback(const Item&) for every item within radius of center (only the items of the last Build)
+	template<typename F> void ForEachInRadius(const Sel::Vector2f& center, float radius, F&& callback) const;
+
+	void Insert(entt::entity entity, const Sel::Vector2f& position);
+
+	SpatialGrid& operator=(const SpatialGrid&) = delete;
+	SpatialGrid& operator=(SpatialGrid&&) = delete;
+
+private:
+	std::size_t GetCellCoordinate(float value, float min, std::size_t cellCount) const;
+	std::size_t GetCellIndex(const Sel::Vector2f& position) const;
+
+	std::vector<Item> m_pendingItems; //< inserted since the last Build
+	std::vector<Item> m_items; //< sorted by cell
+	std::vector<std::uint32_t> m_cellStarts; //< items of cell i are [m_cellStarts[i], m_cellStarts[i + 1])
+	Sel::Vector2f m_worldMin;
+	Sel::Vector2f m_worldMax;
+	std::size_t m_cellCountX;
+	std::size_t m_cellCountY;
+	float m_invCellSize;
+};
+
+template<typename F>
+void SpatialGrid::ForEachInRadius(const Sel::Vector2f& center, float radius, F&& callback) const
+{
+	if (m_items.empty())
+		return;
+
+	std::size_t minX = GetCellCoordinate(center.x - radius, m_worldMin.x, m_cellCountX);
+	std::size_t maxX = GetCellCoordinate(center.x + radius, m_worldMin.x, m_cellCountX);
+	std::size_t minY = GetCellCoordinate(center.y - radius, m_worldMin.y, m_cellCountY);
+	std::size_t maxY = GetCellCoordinate(center.y + radius, m_worldMin.y, m_cellCountY);
+
+	float radiusSqr = radius * radius;
+	for (std::size_t y = minY; y <= maxY; ++y)
+	{
+		for (std::size_t x = minX; x <= maxX; ++x)
+		{
+			std::size_t cellIndex = y * m_cellCountX + x;
+			for (std::uint32_t i = m_cellStarts[cellIndex]; i < m_cellStarts[cellIndex + 1]; ++i)
+			{
+				const Item& item = m_items[i];
+				if ((item.position - center).SquaredMagnitude() <= radiusSqr)
+					callback(item);
+			}
+		}
+	}
+}
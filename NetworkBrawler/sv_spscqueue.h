@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread (the network thread and the simulation thread).
+// Each side only writes its own index, the other side reads it with acquire semantics to see the values written before it was published.
+template<typename T>
+class SpscQueue
+{
+public:
+	// capacity must be a power of two
+	explicit SpscQueue(std::size_t capacity) :
+		m_values(std::make_unique<T[]>(capacity)),
+		m_mask(capacity - 1),
+		m_readIndex(0),
+		m_writeIndex(0)
+	{
+		assert(capacity > 0 && (capacity & m_mask) == 0);
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue(SpscQueue&&) = delete;
+	~SpscQueue() = default;
+
+	std::size_t GetCapacity() const
+	{
+		return m_mask + 1;
+	}
+
+	// Consumer only: returns false if the queue is empty
+	bool TryPop(T& value)
+	{
+		std::size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+		if (readIndex == m_writeIndex.load(std::memory_order_acquire))
+			return false;
+
+		value = std::move(m_values[readIndex & m_mask]);
+		m_readIndex.store(readIndex + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer only: returns false if the queue is full (the value is left untouched)
+	bool TryPush(T&& value)
+	{
+		std::size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_readIndex.load(std::memory_order_acquire) > m_mask)
+			return false;
+
+		m_values[writeIndex & m_mask] = std::move(value);
+		m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+		return true;
+	}
+
+	SpscQueue& operator=(const SpscQueue&) = delete;
+	SpscQueue& operator=(SpscQueue&&) = delete;
+
+private:
+	// Both indices only grow (wrapping around is fine as the capacity is a power of two), they live on their own cache line so the two threads don't fight over it
+	std::unique_ptr<T[]> m_values;
+	std::size_t m_mask;
+	alignas(64) std::atomic<std::size_t> m_readIndex;
+	alignas(64) std::atomic<std::size_t> m_writeIndex;
+};
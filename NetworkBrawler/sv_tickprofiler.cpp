@@ -0,0 +1,128 @@
+#include "sv_tickprofiler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <vector>
+
+const char* GetTickPhaseName(TickPhase phase)
+{
+	switch (phase)
+	{
+		case TickPhase::Inputs:       return "inputs";
+		case TickPhase::Velocity:     return "velocity";
+		case TickPhase::Network:      return "network";
+		case TickPhase::BoundsClamp:  return "bounds clamp";
+		case TickPhase::Collectibles: return "collectibles";
+		case TickPhase::WinCheck:     return "win check";
+		case TickPhase::GoldenCarrot: return "golden carrot";
+		case TickPhase::Spawn:        return "spawn";
+		case TickPhase::Kill:         return "kill";
+		case TickPhase::Leaderboard:  return "leaderboard";
+		case TickPhase::StealRewind:  return "steal rewind";
+		case TickPhase::Tick:         return "whole tick";
+	}
+
+	return "<unknown>";
+}
+
+TickProfiler::Scope::Scope(TickProfiler& profiler, TickPhase phase) :
+	m_profiler(&profiler),
+	m_start(std::chrono::steady_clock::now()),
+	m_phase(phase)
+{
+}
+
+TickProfiler::Scope::~Scope()
+{
+	Stop();
+}
+
+void TickProfiler::Scope::Stop()
+{
+	if (!m_profiler)
+		return;
+
+	m_profiler->Record(m_phase, std::chrono::steady_clock::now() - m_start);
+	m_profiler = nullptr;
+}
+
+TickProfiler::TickProfiler(float tickBudget) :
+	m_tickBudget(static_cast<std::int64_t>(std::llround(tickBudget * 1'000'000'000.0))),
+	m_worstTick(std::chrono::nanoseconds::zero()),
+	m_dumpedOverrunCount(0),
+	m_overrunCount(0)
+{
+}
+
+void TickProfiler::Dump(std::ostream& out)
+{
+	auto toMicroseconds = [](std::uint32_t ns) { return ns / 1000.0; };
+
+	std::uint64_t newOverruns = m_overrunCount - m_dumpedOverrunCount;
+	m_dumpedOverrunCount = m_overrunCount;
+
+	out << std::fixed << std::setprecision(1)
+	    << "overruns (ticks over " << std::chrono::duration<double, std::milli>(m_tickBudget).count() << " ms): " << newOverruns << " since last dump, " << m_overrunCount << " total"
+	    << ", worst tick since last dump " << std::chrono::duration<double, std::milli>(m_worstTick).count() << " ms" << '\n';
+
+	out << std::left << std::setw(16) << "phase"
+	    << std::right << std::setw(10) << "samples"
+	    << std::setw(10) << "p50 us"
+	    << std::setw(10) << "p99 us"
+	    << std::setw(10) << "max us" << '\n';
+
+	std::vector<std::uint32_t> durations;
+	for (std::size_t i = 0; i < TickPhaseCount; ++i)
+	{
+		const Samples& samples = m_phases[i];
+		if (samples.count == 0)
+			continue;
+
+		std::size_t sampleCount = static_cast<std::size_t>(std::min<std::uint64_t>(samples.count, WindowSize));
+		durations.assign(samples.durations.begin(), samples.durations.begin() + sampleCount);
+
+		// Only the three ranks we print are needed, a full sort isn't
+		auto rank = [&](double percent)
+		{
+			auto it = durations.begin() + static_cast<std::size_t>(percent / 100.0 * (sampleCount - 1) + 0.5);
+			std::nth_element(durations.begin(), it, durations.end());
+			return *it;
+		};
+
+		std::uint32_t p50 = rank(50.0);
+		std::uint32_t p99 = rank(99.0);
+		std::uint32_t max = *std::max_element(durations.begin(), durations.end());
+
+		out << std::left << std::setw(16) << GetTickPhaseName(static_cast<TickPhase>(i))
+		    << std::right << std::setw(10) << sampleCount
+		    << std::setw(10) << toMicroseconds(p50)
+		    << std::setw(10) << toMicroseconds(p99)
+		    << std::setw(10) << toMicroseconds(max) << '\n';
+	}
+
+	out << std::flush;
+	m_worstTick = std::chrono::nanoseconds::zero();
+}
+
+std::uint64_t TickProfiler::GetOverrunCount() const
+{
+	return m_overrunCount;
+}
+
+void TickProfiler::Record(TickPhase phase, std::chrono::nanoseconds duration)
+{
+	assert(static_cast<std::size_t>(phase) < TickPhaseCount);
+
+	Samples& samples = m_phases[static_cast<std::size_t>(phase)];
+	samples.durations[samples.count % WindowSize] = static_cast<std::uint32_t>(std::min<std::int64_t>(duration.count(), std::numeric_limits<std::uint32_t>::max()));
+	samples.count++;
+
+	if (phase == TickPhase::Tick)
+	{
+		m_worstTick = std::max(m_worstTick, duration);
+		if (duration > m_tickBudget)
+			m_overrunCount++;
+	}
+}
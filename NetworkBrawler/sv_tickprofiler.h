@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Phases of a server tick, in the order they run
+enum class TickPhase : std::uint8_t
+{
+	Inputs,       //< one buffered input applied per player
+	Velocity,     //< VelocitySystem::Update
+	Network,      //< NetworkSystem::Update (state packets)
+	BoundsClamp,  //< brawlers kept inside the world
+	Collectibles, //< CollectibleSystem::Update
+	WinCheck,     //< last brawler standing (and end_game)
+	GoldenCarrot, //< golden carrot spawn and score pulses
+	Spawn,        //< collectible spawns
+	Kill,         //< periodic kill of the last player
+	Leaderboard,  //< flush_leaderboard (changes of the tick)
+	StealRewind,  //< a lag-compensated steal request (handled between ticks, one sample per request)
+
+	Tick          //< the whole tick
+};
+
+constexpr std::size_t TickPhaseCount = static_cast<std::size_t>(TickPhase::Tick) + 1;
+
+const char* GetTickPhaseName(TickPhase phase);
+
+// Times the phases of the ticks of a room. Each phase keeps its durations over the last WindowSize times it ran,
+// which gives rolling p50/p99/max, and ticks lasting longer than the tick budget are counted as overruns.
+// Recording a duration is a store in a ring buffer, percentiles are only computed by Dump.
+class TickProfiler
+{
+public:
+	// Times a phase until its destruction (or until Stop)
+	class Scope
+	{
+	public:
+		Scope(TickProfiler& profiler, TickPhase phase);
+		Scope(const Scope&) = delete;
+		Scope(Scope&&) = delete;
+		~Scope();
+
+		void Stop();
+
+		Scope& operator=(const Scope&) = delete;
+		Scope& operator=(Scope&&) = delete;
+
+	private:
+		TickProfiler* m_profiler; //< null once stopped
+		std::chrono::steady_clock::time_point m_start;
+		TickPhase m_phase;
+	};
+
+	// Samples kept per phase (~34s of ticks at 30Hz)
+	static constexpr std::size_t WindowSize = 1024;
+
+	explicit TickProfiler(float tickBudget);
+	TickProfiler(const TickProfiler&) = delete;
+	TickProfiler(TickProfiler&&) = delete;
+	~TickProfiler() = default;
+
+	// Writes p50/p99/max of every phase which ran during the window, and the overruns since the last dump
+	void Dump(std::ostream& out);
+
+	std::uint64_t GetOverrunCount() const;
+
+	void Record(TickPhase phase, std::chrono::nanoseconds duration);
+
+	TickProfiler& operator=(const TickProfiler&) = delete;
+	TickProfiler& operator=(TickProfiler&&) = delete;
+
+private:
+	struct Samples
+	{
+		std::array<std::uint32_t, WindowSize> durations; //< ns, saturated
+		std::uint64_t count = 0; //< samples ever recorded, the next one goes to count % WindowSize
+	};
+
+	std::array<Samples, TickPhaseCount> m_phases;
+	std::chrono::nanoseconds m_tickBudget;
+	std::chrono::nanoseconds m_worstTick;
+	std::uint64_t m_dumpedOverrunCount;
+	std::uint64_t m_overrunCount;
+};
@@ -0,0 +1,93 @@
+#include "sv_tickscheduler.h"
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+TickScheduler::TickScheduler(float tickDuration, std::uint32_t maxCatchUpTicks) :
+	m_startTime(Clock::now()),
+	m_tickDuration(static_cast<std::int64_t>(std::llround(tickDuration * 1'000'000'000.0))),
+	m_droppedTicks(0),
+	m_tick(0),
+	m_maxCatchUpTicks(maxCatchUpTicks)
+{
+	assert(m_tickDuration.count() > 0);
+	assert(m_maxCatchUpTicks > 0);
+}
+
+std::uint32_t TickScheduler::CollectDueTicks()
+{
+	std::uint64_t dueTickCount = GetDueTickCount(Clock::now());
+	if (dueTickCount <= m_tick)
+		return 0;
+
+	std::uint64_t lateTicks = dueTickCount - m_tick;
+	if (lateTicks > m_maxCatchUpTicks)
+	{
+		// Running every late tick would make us even later (spiral of death), only run the last ones
+		std::uint64_t droppedTicks = lateTicks - m_maxCatchUpTicks;
+		m_droppedTicks += droppedTicks;
+		m_tick += droppedTicks;
+
+		lateTicks = m_maxCatchUpTicks;
+	}
+
+	return static_cast<std::uint32_t>(lateTicks);
+}
+
+void TickScheduler::EndTick()
+{
+	m_tick++;
+}
+
+std::uint64_t TickScheduler::GetDroppedTicks() const
+{
+	return m_droppedTicks;
+}
+
+std::uint64_t TickScheduler::GetTick() const
+{
+	return m_tick;
+}
+
+std::uint32_t TickScheduler::GetWaitTime() const
+{
+	Clock::time_point nextTickTime = m_startTime + m_tickDuration * static_cast<std::int64_t>(m_tick);
+	Clock::time_point now = Clock::now();
+	if (nextTickTime <= now)
+		return 0;
+
+	// Rounded up, waking up early would only make us loop until the tick is due
+	auto waitTime = std::chrono::ceil<std::chrono::milliseconds>(nextTickTime - now);
+	if (waitTime.count() > std::numeric_limits<std::uint32_t>::max())
+		return std::numeric_limits<std::uint32_t>::max();
+
+	return static_cast<std::uint32_t>(waitTime.count());
+}
+
+void TickScheduler::SetTick(std::uint64_t tick)
+{
+	m_tick = tick;
+}
+
+void TickScheduler::SkipDueTicks()
+{
+	std::uint64_t dueTickCount = GetDueTickCount(Clock::now());
+	if (dueTickCount > m_tick)
+		m_tick = dueTickCount;
+}
+
+std::uint64_t TickScheduler::ToTicks(float seconds) const
+{
+	if (seconds <= 0.f)
+		return 0;
+
+	// The tolerance absorbs the rounding of the tick duration to whole nanoseconds (4s would be 120.0000012 ticks of 1/30s)
+	double tickCount = seconds * 1'000'000'000.0 / m_tickDuration.count();
+	return static_cast<std::uint64_t>(std::ceil(tickCount - 1e-4));
+}
+
+std::uint64_t TickScheduler::GetDueTickCount(Clock::time_point now) const
+{
+	// Tick N is due at m_startTime + N * m_tickDuration, so ticks [0, elapsed / duration] are due
+	return static_cast<std::uint64_t>((now - m_startTime) / m_tickDuration) + 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Fixed timestep clock of the server: time is counted in ticks, as a 64-bit integer which doesn't lose precision however long the server runs.
+// Tick N is due at start + N * tickDuration, the main loop blocks until the next one is due then runs every tick which is due.
+// Game timers are deadlines expressed in ticks (see ToTicks).
+class TickScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// If the server falls further behind than this, the late ticks are dropped instead of being run back to back
+	static constexpr std::uint32_t DefaultMaxCatchUpTicks = 5;
+
+	TickScheduler(float tickDuration, std::uint32_t maxCatchUpTicks = DefaultMaxCatchUpTicks);
+	TickScheduler(const TickScheduler&) = delete;
+	TickScheduler(TickScheduler&&) = delete;
+	~TickScheduler() = default;
+
+	// Number of ticks to run now (at most maxCatchUpTicks), EndTick must be called after each of them
+	std::uint32_t CollectDueTicks();
+	void EndTick();
+
+	std::uint64_t GetDroppedTicks() const;
+	// Tick being run (or the next one to run outside of a tick)
+	std::uint64_t GetTick() const;
+	// Milliseconds until the next tick is due (rounded up, 0 if it's already due)
+	std::uint32_t GetWaitTime() const;
+
+	// Moves to a tick without running anything (replays follow the recorded ticks instead of the clock)
+	void SetTick(std::uint64_t tick);
+
+	// Forgets about the ticks which are due without running them (when the server has nothing to simulate)
+	void SkipDueTicks();
+
+	// Number of ticks covering a duration in seconds (rounded up)
+	std::uint64_t ToTicks(float seconds) const;
+
+	TickScheduler& operator=(const TickScheduler&) = delete;
+	TickScheduler& operator=(TickScheduler&&) = delete;
+
+private:
+	std::uint64_t GetDueTickCount(Clock::time_point now) const;
+
+	Clock::time_point m_startTime;
+	std::chrono::nanoseconds m_tickDuration;
+	std::uint64_t m_droppedTicks;
+	std::uint64_t m_tick;
+	std::uint32_t m_maxCatchUpTicks;
+};
@@ -0,0 +1,108 @@
+#include "sv_workerpool.h"
+#include <cassert>
+#include <utility>
+
+WorkerPool::WorkerPool(std::size_t workerCount) :
+	m_job(nullptr),
+	m_jobCount(0),
+	m_nextJob(0),
+	m_remainingJobs(0),
+	m_batchId(0),
+	m_isStopping(false)
+{
+	m_workers.reserve(workerCount);
+	for (std::size_t i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(&WorkerPool::WorkerMain, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_batchStarted.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+std::size_t WorkerPool::GetWorkerCount() const
+{
+	return m_workers.size();
+}
+
+void WorkerPool::ParallelFor(std::size_t jobCount, const std::function<void(std::size_t)>& job)
+{
+	// Waking up the workers isn't worth it for a single job
+	if (jobCount <= 1 || m_workers.empty())
+	{
+		for (std::size_t i = 0; i < jobCount; ++i)
+			job(i);
+
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	assert(!m_job); //< no nested batch
+
+	m_job = &job;
+	m_jobCount = jobCount;
+	m_nextJob = 0;
+	m_remainingJobs = jobCount;
+	m_batchId++;
+	m_batchStarted.notify_all();
+
+	RunJobs(lock);
+
+	m_batchDone.wait(lock, [&] { return m_remainingJobs == 0; });
+	m_job = nullptr;
+
+	if (m_exception)
+		std::rethrow_exception(std::exchange(m_exception, nullptr));
+}
+
+void WorkerPool::RunJobs(std::unique_lock<std::mutex>& lock)
+{
+	// Jobs are coarse (a whole room update), taking them under the lock costs nothing in comparison
+	while (m_job && m_nextJob < m_jobCount)
+	{
+		const std::function<void(std::size_t)>& job = *m_job;
+		std::size_t jobIndex = m_nextJob++;
+
+		// The job is counted as done even if it throws, or ParallelFor would wait for it forever
+		std::exception_ptr exception;
+		lock.unlock();
+		try
+		{
+			job(jobIndex);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+		lock.lock();
+
+		if (exception && !m_exception)
+			m_exception = std::move(exception);
+
+		if (--m_remainingJobs == 0)
+			m_batchDone.notify_all();
+	}
+}
+
+void WorkerPool::WorkerMain()
+{
+	std::uint64_t lastBatchId = 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_batchStarted.wait(lock, [&] { return m_isStopping || m_batchId != lastBatchId; });
+		if (m_isStopping)
+			return;
+
+		lastBatchId = m_batchId;
+		RunJobs(lock);
+	}
+}
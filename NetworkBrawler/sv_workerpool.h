@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running batches of independent jobs (the server updates its rooms with it).
+// The calling thread takes part in the batch and ParallelFor only returns once every job is done.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(std::size_t workerCount);
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool(WorkerPool&&) = delete;
+	~WorkerPool();
+
+	std::size_t GetWorkerCount() const;
+
+	// Calls job(i) for every i in [0, jobCount), in any order and on any thread.
+	// A job which throws doesn't stop the others, the first exception is rethrown once they're all done
+	void ParallelFor(std::size_t jobCount, const std::function<void(std::size_t)>& job);
+
+	WorkerPool& operator=(const WorkerPool&) = delete;
+	WorkerPool& operator=(WorkerPool&&) = delete;
+
+private:
+	void RunJobs(std::unique_lock<std::mutex>& lock);
+	void WorkerMain();
+
+	std::condition_variable m_batchDone;
+	std::condition_variable m_batchStarted;
+	std::exception_ptr m_exception; //< first exception thrown by a job of the current batch
+	std::mutex m_mutex;
+	const std::function<void(std::size_t)>* m_job;
+	std::size_t m_jobCount;
+	std::size_t m_nextJob;
+	std::size_t m_remainingJobs;
+	std::uint64_t m_batchId;
+	std::vector<std::thread> m_workers;
+	bool m_isStopping;
+};
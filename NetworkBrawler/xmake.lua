@@ -27,6 +27,7 @@ set_allowedarchs("windows|x64", "mingw|x86_64", "linux|x86_64", "macosx|x86_64")
 set_defaultmode("debug")
 
 add_requires("enet6", { configs = { debug = is_mode("debug") }})
+add_requires("lz4")
 
 -- On rajoute le moteur en dépendance
 add_requires("selengine", { configs = { debug = is_mode("debug") }})
@@ -56,7 +57,7 @@ if is_mode("debug") then
 	add_defines("DEBUG_GHOSTS")
 end
 
-add_packages("enet6", "selengine")
+add_packages("enet6", "lz4", "selengine")
 
 target("BrawlerClient")
 	set_kind("binary")
@@ -69,3 +70,20 @@ target("BrawlerServer")
 
 	add_headerfiles("sv_**.hpp", "sh_**.hpp", "sv_**.h", "sh_**.h")
 	add_files("sv_**.cpp", "sh_**.cpp")
+
+	-- Rooms are updated on a worker pool
+	if is_plat("linux") then
+		add_syslinks("pthread")
+	end
+
+target("BrawlerBot")
+	set_kind("binary")
+
+	add_headerfiles("bot_**.h", "sh_**.hpp", "sh_**.h")
+	add_files("bot_**.cpp", "sh_protocol.cpp", "sh_packetpool.cpp")
+
+target("BrawlerBench")
+	set_kind("binary")
+
+	add_headerfiles("sh_**.hpp", "sh_**.h")
+	add_files("bench_**.cpp", "sh_protocol.cpp", "sh_packetpool.cpp")